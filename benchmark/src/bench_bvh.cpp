@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#include "benchmarks.h"
+#include "bvh.h"
+
+static constexpr int kBvhViews = 8;
+static constexpr int kBvhRays = 256;
+
+// Build and refit time of the BVH, then its frustum and ray queries against linear scans over all boxes.
+// The queries run on the refitted tree, so a stale node would show up as a mismatch.
+bool benchmarkBvh()
+{
+	const uint32_t kBoxCounts[] = { 10000, 100000, 1000000 };
+	bool passed = true;
+
+	std::mt19937 rng(8765);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> extent(0.1f, 2.0f);
+	std::uniform_real_distribution<float> jitter(-1.0f, 1.0f);
+	const glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 150.0f);
+
+	for (uint32_t numBoxes : kBoxCounts)
+	{
+		std::vector<BoundingBox> boxes(numBoxes);
+		for (BoundingBox& box : boxes)
+		{
+			const glm::vec3 center(position(rng), position(rng), position(rng));
+			const glm::vec3 halfSize(extent(rng), extent(rng), extent(rng));
+			box = BoundingBox(center - halfSize, center + halfSize);
+		}
+
+		Bvh bvh;
+		const double buildMs = measureMs([&]() { bvh.build(boxes.data(), numBoxes); });
+
+		// Every object moves a little, as animated ones would
+		for (BoundingBox& box : boxes)
+		{
+			const glm::vec3 offset(jitter(rng), jitter(rng), jitter(rng));
+			box = BoundingBox(box.min_ + offset, box.max_ + offset);
+		}
+		const double refitMs = measureMs([&]() { bvh.refit(boxes.data()); });
+
+		double bvhCullMs = 0.0;
+		double linearCullMs = 0.0;
+		size_t numVisible = 0;
+		size_t numMismatches = 0;
+		std::vector<uint32_t> visible;
+		std::vector<uint32_t> reference;
+		for (int v = 0; v != kBvhViews; v++)
+		{
+			const float angle = 6.2831853f * float(v) / float(kBvhViews);
+			const glm::vec3 eye(120.0f * std::cos(angle), 20.0f * std::sin(2.0f * angle), 120.0f * std::sin(angle));
+			const glm::mat4 viewProj = proj * glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+			bvhCullMs += measureMs([&]() { bvh.cullFrustum(viewProj, visible); });
+			linearCullMs += measureMs([&]()
+				{
+					glm::vec4 planes[6];
+					glm::vec4 corners[8];
+					getFrustumPlanes(viewProj, planes);
+					getFrustumCorners(viewProj, corners);
+
+					reference.clear();
+					for (uint32_t i = 0; i != numBoxes; i++)
+					{
+						if (isBoxInFrustum(planes, corners, boxes[i]))
+							reference.push_back(i);
+					}
+				});
+
+			std::sort(visible.begin(), visible.end());
+			numMismatches += visible != reference;
+			numVisible += reference.size();
+		}
+
+		// Rays from outside of the scene through random points in it, like picking from a camera
+		std::vector<glm::vec3> origins(kBvhRays);
+		std::vector<glm::vec3> dirs(kBvhRays);
+		for (int r = 0; r != kBvhRays; r++)
+		{
+			const float angle = 6.2831853f * float(r) / float(kBvhRays);
+			origins[r] = glm::vec3(150.0f * std::cos(angle), position(rng), 150.0f * std::sin(angle));
+			dirs[r] = glm::normalize(glm::vec3(position(rng), position(rng), position(rng)) - origins[r]);
+		}
+
+		std::vector<BvhRayHit> hits(kBvhRays);
+		std::vector<BvhRayHit> referenceHits(kBvhRays);
+		const double bvhRayMs = measureMs([&]()
+			{
+				for (int r = 0; r != kBvhRays; r++)
+					hits[r] = bvh.raycast(origins[r], dirs[r]);
+			});
+		const double linearRayMs = measureMs([&]()
+			{
+				for (int r = 0; r != kBvhRays; r++)
+				{
+					const glm::vec3 invDir = 1.0f / dirs[r];
+					BvhRayHit& hit = referenceHits[r];
+					hit = BvhRayHit();
+					for (uint32_t i = 0; i != numBoxes; i++)
+					{
+						const float t = intersectRayBox(origins[r], invDir, boxes[i], hit.t);
+						if (t < hit.t)
+						{
+							hit.t = t;
+							hit.item = i;
+						}
+					}
+				}
+			});
+
+		size_t numHits = 0;
+		for (int r = 0; r != kBvhRays; r++)
+		{
+			// Boxes entered at the same distance are equally good hits
+			numMismatches += hits[r].t != referenceHits[r].t;
+			numHits += referenceHits[r].item != ~0u;
+		}
+
+		printf("%u boxes, %zu nodes: build %.2f ms, refit %.2f ms\n", numBoxes, bvh.getNodes().size(), buildMs, refitMs);
+		printf("  frustum, %.1f%% visible: BVH %.3f ms, linear %.3f ms\n", 100.0 * double(numVisible) / double(size_t(numBoxes) * kBvhViews),
+			bvhCullMs / kBvhViews, linearCullMs / kBvhViews);
+		printf("  rays, %d of %d hit: BVH %.2f Mrays/s, linear %.4f Mrays/s\n", int(numHits), kBvhRays, kBvhRays / bvhRayMs / 1000.0,
+			kBvhRays / linearRayMs / 1000.0);
+		printf("  %zu mismatches %s\n", numMismatches, numMismatches ? "FAILED" : "ok");
+		passed &= !numMismatches;
+	}
+
+	// Rays parallel to a face of the box that start on its plane, with either sign of zero in the direction. They
+	// run along the face and enter the box at 1, unless they start off the box.
+	const BoundingBox unitBox(glm::vec3(0.0f), glm::vec3(1.0f));
+	size_t numEdgeMismatches = 0;
+	for (float x : { 0.0f, 1.0f, 1.5f })
+	{
+		for (float dirX : { 0.0f, -0.0f })
+		{
+			const float expected = x <= 1.0f ? 1.0f : std::numeric_limits<float>::infinity();
+			const float t = intersectRayBox(glm::vec3(x, 0.5f, -1.0f), 1.0f / glm::vec3(dirX, 0.0f, 1.0f), unitBox, 10.0f);
+			numEdgeMismatches += t != expected;
+		}
+	}
+	printf("Rays along box faces: %zu mismatches %s\n", numEdgeMismatches, numEdgeMismatches ? "FAILED" : "ok");
+	passed &= !numEdgeMismatches;
+	return passed;
+}
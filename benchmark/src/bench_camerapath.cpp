@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+#include "benchmarks.h"
+#include "camera_path.h"
+#include "frame_benchmark.h"
+
+static constexpr int kPathKeys = 600;
+
+static float getDistance(const glm::vec3& a, const glm::vec3& b)
+{
+	return glm::length(a - b);
+}
+
+// The spline through recorded keys, continuity of a looped path, a save and load round trip, the cost of evaluating a
+// path every frame and the frame time summary of benchmark runs against sorting
+bool benchmarkCameraPath()
+{
+	std::mt19937 rng(2468);
+	std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+
+	CameraPath recorded;
+	for (int i = 0; i != kPathKeys; i++)
+		recorded.addKey({ .time = (float)i * kCameraRecordInterval, .position = glm::vec3(coord(rng), coord(rng), coord(rng)), .target = glm::vec3(coord(rng), coord(rng), coord(rng)) });
+
+	float maxKeyError = 0.0f;
+	for (const CameraKey& key : recorded.getKeys())
+	{
+		glm::vec3 position, target;
+		recorded.evaluate(key.time, position, target);
+		maxKeyError = std::max({ maxKeyError, getDistance(position, key.position), getDistance(target, key.target) });
+	}
+	const bool keysOk = maxKeyError < 1e-4f;
+	printf("Path through %d keys: max error %g %s\n", kPathKeys, maxKeyError, keysOk ? "ok" : "FAILED");
+
+	const CameraPath orbit = CameraPath::makeOrbit(glm::vec3(0.0f, 0.1f, 0.0f), 0.35f, 0.15f, 8.0f);
+	glm::vec3 start, end, target;
+	orbit.evaluate(0.0f, start, target);
+	orbit.evaluate(orbit.getDuration() - 1e-4f, end, target);
+	float minRadius = 1.0f;
+	float maxRadius = 0.0f;
+	for (int frame = 0; frame != 480; frame++)
+	{
+		glm::vec3 position;
+		orbit.evaluate((float)frame * kFixedFrameSeconds, position, target);
+		const float radius = std::sqrt(position.x * position.x + position.z * position.z);
+		minRadius = std::min(minRadius, radius);
+		maxRadius = std::max(maxRadius, radius);
+	}
+	const bool orbitOk = getDistance(start, end) < 1e-3f && minRadius > 0.34f && maxRadius < 0.36f;
+	printf("Looped orbit: gap %g, radius %.4f to %.4f %s\n", getDistance(start, end), minRadius, maxRadius, orbitOk ? "ok" : "FAILED");
+
+	const std::filesystem::path file = std::filesystem::temp_directory_path() / "bench_camera_path.txt";
+	CameraPath loaded;
+	const bool saved = recorded.save(file);
+	const bool roundTripOk = saved && loaded.load(file) && loaded.getKeys().size() == recorded.getKeys().size() &&
+		std::equal(loaded.getKeys().begin(), loaded.getKeys().end(), recorded.getKeys().begin(), [](const CameraKey& a, const CameraKey& b)
+			{ return a.time == b.time && a.position == b.position && a.target == b.target; });
+	printf("Save and load of %d keys: %s\n", kPathKeys, roundTripOk ? "ok" : "FAILED");
+	std::filesystem::remove(file);
+
+	glm::vec3 checksum(0.0f);
+	const double evaluateMs = measureMs([&]()
+		{
+			for (int frame = 0; frame != 100000; frame++)
+			{
+				glm::vec3 position;
+				recorded.evaluate((float)frame * kFixedFrameSeconds * 0.5f, position, target);
+				checksum += position;
+			}
+		});
+	printf("100000 path evaluations: %.2f ms (checksum %.1f)\n", evaluateMs, checksum.x + checksum.y + checksum.z);
+
+	std::uniform_real_distribution<float> frameMs(1.0f, 30.0f);
+	size_t numMismatches = 0;
+	for (int numFrames : { 1, 2, 99, 100, 240, 1001 })
+	{
+		std::vector<float> values(numFrames);
+		for (float& v : values)
+			v = frameMs(rng);
+		const FrameTimeSummary summary = summarizeFrameTimes(values);
+
+		std::sort(values.begin(), values.end());
+		auto rank = [&](int percent) { return values[std::max((numFrames * percent + 99) / 100, 1) - 1]; };
+		numMismatches += summary.p50 != rank(50);
+		numMismatches += summary.p95 != rank(95);
+		numMismatches += summary.p99 != rank(99);
+		numMismatches += summary.max != values.back();
+	}
+	printf("Frame time summaries of 6 runs: %zu mismatches %s\n", numMismatches, numMismatches ? "FAILED" : "ok");
+	return keysOk && orbitOk && roundTripOk && !numMismatches;
+}
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#include "benchmarks.h"
+#include "light_clusters.h"
+
+static constexpr float kClusterNear = 0.1f;
+static constexpr float kClusterFar = 1000.0f;
+static constexpr int kClusterSamples = 100000;
+
+// Light area of the app around the largest stress test grid
+static const glm::vec3 kAreaMin(-19.0f, -0.1f, -38.0f);
+static const glm::vec3 kAreaSize(38.0f, 0.35f, 38.3f);
+
+/// Lights spread over the area with the radius the app gives them
+static std::vector<PointLight> makeLights(uint32_t numLights, std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	std::vector<PointLight> lights(numLights);
+	const float radius = std::cbrt(kAreaSize.x * kAreaSize.y * kAreaSize.z / (float)numLights) * 1.5f;
+	for (PointLight& light : lights)
+	{
+		light.position = kAreaMin + glm::vec3(unit(rng), unit(rng), unit(rng)) * kAreaSize;
+		light.radius = radius;
+	}
+	return lights;
+}
+
+/// World space point inside the frustum at a random depth up to maxDepth
+static glm::vec3 getRandomFrustumPoint(const glm::mat4& view, const glm::mat4& proj, float maxDepth, std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> ndc(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> logDepth(std::log(kClusterNear), std::log(maxDepth));
+	const glm::vec4 p = glm::inverse(proj) * glm::vec4(ndc(rng), ndc(rng), 1.0f, 1.0f);
+	const glm::vec3 viewPosition = glm::vec3(p) / -p.z * std::exp(logDepth(rng));
+	return glm::vec3(glm::inverse(view) * glm::vec4(viewPosition, 1.0f));
+}
+
+// Light assignment against brute force: every light that reaches a point has to be in the cluster of the point, and
+// the point has to be inside the box of its cluster. Then the cost of the CPU reference from 1 to 4096 lights and how
+// many lights a fragment loops over compared to all of them.
+bool benchmarkLightClusters()
+{
+	std::mt19937 rng(97531);
+	const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 1.5f, 2.0f), glm::vec3(0.0f, 0.0f, -12.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	const glm::mat4 proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, kClusterNear, kClusterFar);
+	const glm::mat4 viewProj = proj * view;
+	const glm::mat4 invProj = glm::inverse(proj);
+
+	// Enough lights that some reach every point, few enough that no cluster fills up
+	const std::vector<PointLight> testLights = makeLights(512, rng);
+	std::vector<uint32_t> clusters;
+	const uint32_t numDropped = buildLightClusters(testLights.data(), (uint32_t)testLights.size(), view, proj, kClusterNear, kClusterFar, clusters);
+
+	size_t numMissing = 0;
+	size_t numOutside = 0;
+	size_t numReached = 0;
+	for (int i = 0; i != kClusterSamples; i++)
+	{
+		const glm::vec3 point = getRandomFrustumPoint(view, proj, 60.0f, rng);
+		const uint32_t cluster = getClusterIndex(point, viewProj, kClusterNear, kClusterFar);
+		const uint32_t* slot = &clusters[size_t(cluster) * kClusterSlotSize];
+
+		const BoundingBox box = getClusterBox(cluster % kClusterGridX, (cluster / kClusterGridX) % kClusterGridY, cluster / (kClusterGridX * kClusterGridY),
+			invProj, kClusterNear, kClusterFar);
+		const glm::vec3 viewPoint = glm::vec3(view * glm::vec4(point, 1.0f));
+		bool inside = true;
+		for (int k = 0; k != 3; k++)
+		{
+			const float tolerance = 1e-4f * std::max(std::abs(box.min_[k]), std::abs(box.max_[k])) + 1e-6f;
+			inside &= viewPoint[k] >= box.min_[k] - tolerance && viewPoint[k] <= box.max_[k] + tolerance;
+		}
+		numOutside += !inside;
+
+		for (uint32_t l = 0; l != testLights.size(); l++)
+		{
+			if (glm::length(testLights[l].position - point) > testLights[l].radius)
+				continue;
+			numReached++;
+			numMissing += std::find(slot + 1, slot + 1 + slot[0], l) == slot + 1 + slot[0];
+		}
+	}
+	const bool ok = !numMissing && !numOutside && !numDropped;
+	printf("%d points, %zu lights reaching them: %zu missing from the cluster, %zu outside of the cluster box, %u dropped %s\n", kClusterSamples, numReached,
+		numMissing, numOutside, numDropped, ok ? "ok" : "FAILED");
+
+	// Cost of the reference, and lights per fragment over the points of the area the camera sees
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<glm::vec3> areaPoints;
+	while (areaPoints.size() != (size_t)kClusterSamples / 10)
+	{
+		const glm::vec3 point = kAreaMin + glm::vec3(unit(rng), unit(rng), unit(rng)) * kAreaSize;
+		const glm::vec4 clip = viewProj * glm::vec4(point, 1.0f);
+		if (clip.w > kClusterNear && std::abs(clip.x) <= clip.w && std::abs(clip.y) <= clip.w)
+			areaPoints.push_back(point);
+	}
+
+	for (uint32_t numLights = 1; numLights <= kMaxPointLights; numLights *= 4)
+	{
+		const std::vector<PointLight> lights = makeLights(numLights, rng);
+		uint32_t dropped = 0;
+		const double ms = measureMs([&]() { dropped = buildLightClusters(lights.data(), numLights, view, proj, kClusterNear, kClusterFar, clusters); });
+
+		uint32_t maxCount = 0;
+		for (uint32_t c = 0; c != kNumClusters; c++)
+			maxCount = std::max(maxCount, clusters[size_t(c) * kClusterSlotSize]);
+		double perFragment = 0.0;
+		for (const glm::vec3& point : areaPoints)
+			perFragment += clusters[size_t(getClusterIndex(point, viewProj, kClusterNear, kClusterFar)) * kClusterSlotSize];
+		perFragment /= (double)areaPoints.size();
+
+		printf("%5u lights: CPU binning %7.2f ms, %6.1f lights per fragment instead of %u, at most %u per cluster, %u dropped\n", numLights, ms, perFragment,
+			numLights, maxCount, dropped);
+	}
+	return ok;
+}
@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "benchmarks.h"
+#include "bitmap.h"
+#include "utils_cubemap.h"
+
+// Largest difference between the two paths on random texels in [0, 1]. The atan2() approximation moves samples by a
+// small fraction of a texel, a face that is mapped wrong differs by about 0.5 on average.
+static constexpr float kCubemapMaxError = 0.01f;
+
+// Equirectangular RGBA float input -> 6 cube faces, old vertical cross path against the direct converter
+bool benchmarkCubemap()
+{
+	const int kWidths[] = { 2048, 4096, 8192 };
+	bool passed = true;
+
+	printf("Threads: %u, SIMD level %s\n", getThreadPool().getNumThreads(), simd::getLevelName(simd::getLevel()));
+
+	for (const int w : kWidths)
+	{
+		const int h = w / 2;
+
+		Bitmap in(w, h, 4, eBitmapFormat_Float);
+		float* data = reinterpret_cast<float*>(in.data_.data());
+		for (size_t i = 0; i != size_t(w) * h * 4; i++)
+			data[i] = random01();
+
+		Bitmap crossFaces;
+		Bitmap directFaces;
+
+		const double crossMs = measureMs([&]() {
+			crossFaces = cubemap::convertVerticalCrossToCubeMapFaces(cubemap::convertEquirectangularMapToVerticalCross(in));
+			});
+		const double directMs = measureMs([&]() {
+			directFaces = cubemap::convertEquirectangularMapToCubeMapFaces(in);
+			});
+
+		// Both paths have to agree apart from the atan2() approximation
+		float maxError = 0.0f;
+		const float* a = reinterpret_cast<const float*>(crossFaces.data_.data());
+		const float* b = reinterpret_cast<const float*>(directFaces.data_.data());
+		const size_t numFloats = std::min(crossFaces.data_.size(), directFaces.data_.size()) / sizeof(float);
+		for (size_t i = 0; i != numFloats; i++)
+			maxError = std::max(maxError, std::abs(a[i] - b[i]));
+
+		const bool matches = crossFaces.data_.size() == directFaces.data_.size() && maxError <= kCubemapMaxError;
+		printf("%ix%i: vertical cross %8.1f ms, direct %8.1f ms, speedup %5.2fx, max error %g %s\n",
+			w, h, crossMs, directMs, crossMs / directMs, maxError, matches ? "ok" : "FAILED");
+		passed &= matches;
+	}
+	return passed;
+}
@@ -0,0 +1,85 @@
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#include "benchmarks.h"
+#include "instance_culling.h"
+
+static constexpr uint32_t kCullInstances = 16384;
+static constexpr int kCullViews = 16;
+
+/// A culled instance must not have a corner of its oriented box inside all six frustum planes
+static bool isFalseCull(const Instance& instance, const BoundingBox& bounds, const glm::vec4* frustumPlanes)
+{
+	for (int c = 0; c != 8; c++)
+	{
+		const glm::vec3 corner((c & 1) ? bounds.max_.x : bounds.min_.x, (c & 2) ? bounds.max_.y : bounds.min_.y, (c & 4) ? bounds.max_.z : bounds.min_.z);
+		const glm::vec4 p = instance.model * glm::vec4(corner, 1.0f);
+
+		bool inside = true;
+		for (int i = 0; i != 6; i++)
+			inside &= glm::dot(frustumPlanes[i], p) > 0.0f;
+		if (inside)
+			return true;
+	}
+	return false;
+}
+
+// CPU reference of the GPU instance culling, randomly placed, rotated and scaled instances seen by a ring of cameras
+bool benchmarkInstanceCulling()
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-20.0f, 20.0f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	std::vector<Instance> instances(kCullInstances);
+	for (Instance& instance : instances)
+	{
+		const glm::vec3 axis = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + glm::vec3(0.01f));
+		instance.model = glm::translate(glm::mat4(1.0f), glm::vec3(position(rng), position(rng), position(rng)));
+		instance.model = glm::rotate(instance.model, unit(rng) * 6.2831853f, axis);
+		instance.model = glm::scale(instance.model, glm::vec3(0.5f + unit(rng)));
+	}
+
+	const BoundingBox bounds(glm::vec3(-0.5f, 0.0f, -0.3f), glm::vec3(0.5f, 1.0f, 0.3f));
+	const glm::mat4 proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 30.0f);
+
+	std::vector<Instance> visible(kCullInstances);
+	std::vector<uint32_t> visibility(kCullInstances);
+	size_t numVisible = 0;
+	size_t numFalseCulls = 0;
+	size_t numMismatches = 0;
+	double ms = 0.0;
+	for (int v = 0; v != kCullViews; v++)
+	{
+		const float angle = 6.2831853f * float(v) / float(kCullViews);
+		const glm::vec3 eye(25.0f * std::cos(angle), 5.0f * std::sin(3.0f * angle), 25.0f * std::sin(angle));
+		const glm::mat4 viewProj = proj * glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+		uint32_t count = 0;
+		ms += measureMs([&]() { count = cullInstances(instances.data(), kCullInstances, bounds, viewProj, visible.data(), visibility.data()); });
+		numVisible += count;
+
+		glm::vec4 frustumPlanes[6];
+		getFrustumPlanes(viewProj, frustumPlanes);
+
+		// The compacted instances are the flagged ones in order
+		uint32_t next = 0;
+		for (uint32_t i = 0; i != kCullInstances; i++)
+		{
+			if (visibility[i])
+				numMismatches += next >= count || memcmp(&visible[next++], &instances[i], sizeof(Instance)) != 0;
+			else
+				numFalseCulls += isFalseCull(instances[i], bounds, frustumPlanes);
+		}
+		numMismatches += next != count;
+	}
+
+	printf("%u instances, %d views: %.3f ms per view, %.1f%% visible, %zu visible instances culled, %zu compaction errors %s\n",
+		kCullInstances, kCullViews, ms / kCullViews, 100.0 * double(numVisible) / double(size_t(kCullInstances) * kCullViews),
+		numFalseCulls, numMismatches, numFalseCulls || numMismatches ? "FAILED" : "ok");
+	return !numFalseCulls && !numMismatches;
+}
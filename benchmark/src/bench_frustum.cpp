@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <bit>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#include "benchmarks.h"
+#include "frustum_culling.h"
+
+static constexpr int kFrustumViews = 8;
+
+/// Fastest of a few runs
+template <typename Func>
+static double bestMs(Func&& func)
+{
+	double best = measureMs(func);
+	for (int i = 0; i != 4; i++)
+		best = std::min(best, measureMs(func));
+	return best;
+}
+
+// Every instruction set and the thread pool against isBoxInFrustum() box by box, 10K, 100K and 1M random boxes
+bool benchmarkFrustumCulling()
+{
+	const size_t kBoxCounts[] = { 10000, 100000, 1000000 };
+	bool passed = true;
+
+	printf("Runtime SIMD level %s, %u threads\n", simd::getLevelName(simd::getLevel()), getThreadPool().getNumThreads());
+
+	std::mt19937 rng(4321);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> extent(0.1f, 4.0f);
+	const glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 150.0f);
+
+	for (size_t numBoxes : kBoxCounts)
+	{
+		BoundingBoxSoA boxes;
+		boxes.resize(numBoxes);
+		for (size_t i = 0; i != numBoxes; i++)
+		{
+			const glm::vec3 center(position(rng), position(rng), position(rng));
+			const glm::vec3 halfSize(extent(rng), extent(rng), extent(rng));
+			boxes.set(i, BoundingBox(center - halfSize, center + halfSize));
+		}
+
+		std::vector<uint64_t> reference(getBoxCullMaskWords(numBoxes));
+		std::vector<uint64_t> mask(reference.size());
+		std::vector<uint32_t> indices;
+
+		double ms[simd::Level_AVX512 + 2] = {};
+		size_t numVisible = 0;
+		size_t numMismatches = 0;
+		for (int v = 0; v != kFrustumViews; v++)
+		{
+			const float angle = 6.2831853f * float(v) / float(kFrustumViews);
+			const glm::vec3 eye(120.0f * std::cos(angle), 20.0f * std::sin(2.0f * angle), 120.0f * std::sin(angle));
+			const BoxCullFrustum frustum = getBoxCullFrustum(proj * glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+
+			ms[simd::Level_Scalar] += bestMs([&]() { cullBoxes(frustum, boxes, reference.data(), simd::Level_Scalar); });
+			numVisible += compactVisibleBoxes(reference.data(), numBoxes, indices);
+
+			for (int level = simd::Level_SSE2; level <= simd::getLevel(); level++)
+			{
+				ms[level] += bestMs([&]() { cullBoxes(frustum, boxes, mask.data(), (simd::Level)level); });
+				numMismatches += mask != reference;
+			}
+
+			ms[simd::Level_AVX512 + 1] += bestMs([&]() { cullBoxesParallel(frustum, boxes, mask.data()); });
+			numMismatches += mask != reference;
+		}
+
+		printf("%zu boxes, %.1f%% visible:", numBoxes, 100.0 * double(numVisible) / double(numBoxes * kFrustumViews));
+		for (int level = simd::Level_Scalar; level <= simd::getLevel(); level++)
+			printf(" %s %.3f ms,", simd::getLevelName((simd::Level)level), ms[level] / kFrustumViews);
+		printf(" threads %.3f ms, %zu masks differ %s\n", ms[simd::Level_AVX512 + 1] / kFrustumViews, numMismatches, numMismatches ? "FAILED" : "ok");
+		passed &= !numMismatches;
+	}
+	return passed;
+}
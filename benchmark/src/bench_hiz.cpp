@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#include "benchmarks.h"
+#include "depth_pyramid.h"
+
+static constexpr int kHiZOccluders = 64;
+static constexpr int kHiZBoxes = 20000;
+
+/// Depth the projection writes at a distance in front of the camera
+static float getDepthAtDistance(const glm::mat4& proj, float distance)
+{
+	const glm::vec4 clip = proj * glm::vec4(0.0f, 0.0f, -distance, 1.0f);
+	return clip.z / clip.w;
+}
+
+/// Brute force occlusion over every depth pixel whose center is inside the rectangle of the box
+static bool isBoxOccludedPerPixel(const BoundingBox& box, const glm::mat4& viewProj, const std::vector<float>& depth, uint32_t width, uint32_t height)
+{
+	DepthRect rect;
+	if (!getBoxDepthRect(box, viewProj, glm::vec2(1.0f), rect))
+		return false;
+
+	for (uint32_t y = 0; y != height; y++)
+	{
+		const float v = (float(y) + 0.5f) / float(height);
+		if (v < rect.uvMin.y || v > rect.uvMax.y)
+			continue;
+		for (uint32_t x = 0; x != width; x++)
+		{
+			const float u = (float(x) + 0.5f) / float(width);
+			if (u >= rect.uvMin.x && u <= rect.uvMax.x && depth[y * width + x] >= rect.nearestDepth)
+				return false;
+		}
+	}
+	return true;
+}
+
+// CPU reference of the depth pyramid and of the box test against it. Every pyramid texel has to be at least as far as
+// each depth pixel it covers, and a box the pyramid calls occluded has to be behind every pixel of its rectangle.
+bool benchmarkHiZ()
+{
+	const glm::uvec2 kPyramidSizes[] = { { 1, 1 }, { 37, 5 }, { 640, 480 }, { 1000, 563 } };
+
+	std::mt19937 rng(2468);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	size_t numMismatches = 0;
+	for (const glm::uvec2& size : kPyramidSizes)
+	{
+		std::vector<float> depth(size_t(size.x) * size.y);
+		for (float& d : depth)
+			d = unit(rng);
+
+		std::vector<DepthPyramidLevel> levels;
+		buildDepthPyramid(depth.data(), size.x, size.y, levels);
+
+		const float farthest = *std::max_element(depth.begin(), depth.end());
+		numMismatches += levels.back().width != 1 || levels.back().height != 1 || levels.back().depth[0] != farthest;
+		for (const DepthPyramidLevel& level : levels)
+		{
+			for (uint32_t y = 0; y != size.y; y++)
+			{
+				for (uint32_t x = 0; x != size.x; x++)
+				{
+					const uint32_t lx = std::min(uint32_t((float(x) + 0.5f) / float(size.x) * float(level.width)), level.width - 1);
+					const uint32_t ly = std::min(uint32_t((float(y) + 0.5f) / float(size.y) * float(level.height)), level.height - 1);
+					numMismatches += level.get(lx, ly) < depth[y * size.x + x];
+				}
+			}
+		}
+	}
+	printf("Pyramids of %d depth buffer sizes: %zu texels nearer than a pixel they cover %s\n", (int)std::size(kPyramidSizes), numMismatches,
+		numMismatches ? "FAILED" : "ok");
+
+	// Walls of random size and distance in front of a field of boxes
+	const uint32_t width = 1920;
+	const uint32_t height = 1080;
+	const glm::mat4 proj = glm::perspective(glm::radians(60.0f), float(width) / float(height), 0.1f, 200.0f);
+	const glm::mat4 viewProj = proj * glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	std::vector<float> depth(size_t(width) * height, 1.0f);
+	for (int i = 0; i != kHiZOccluders; i++)
+	{
+		const uint32_t x0 = uint32_t(unit(rng) * width);
+		const uint32_t y0 = uint32_t(unit(rng) * height);
+		const uint32_t x1 = std::min(width, x0 + 50 + uint32_t(unit(rng) * 500));
+		const uint32_t y1 = std::min(height, y0 + 50 + uint32_t(unit(rng) * 400));
+		const float wallDepth = getDepthAtDistance(proj, 2.0f + 10.0f * unit(rng));
+		for (uint32_t y = y0; y != y1; y++)
+			for (uint32_t x = x0; x != x1; x++)
+				depth[y * width + x] = std::min(depth[y * width + x], wallDepth);
+	}
+
+	std::vector<DepthPyramidLevel> levels;
+	const double buildMs = measureMs([&]() { buildDepthPyramid(depth.data(), width, height, levels); });
+
+	std::vector<BoundingBox> boxes(kHiZBoxes);
+	for (BoundingBox& box : boxes)
+	{
+		const float distance = 5.0f + 60.0f * unit(rng);
+		const glm::vec3 center((unit(rng) - 0.5f) * distance, (unit(rng) - 0.5f) * 0.6f * distance, -distance);
+		const glm::vec3 halfSize = glm::vec3(0.2f + 1.5f * unit(rng), 0.2f + 1.5f * unit(rng), 0.2f + 1.5f * unit(rng));
+		box = BoundingBox(center - halfSize, center + halfSize);
+	}
+
+	std::vector<uint8_t> occluded(kHiZBoxes);
+	std::vector<uint8_t> reference(kHiZBoxes);
+	const double hizMs = measureMs([&]()
+		{
+			for (int i = 0; i != kHiZBoxes; i++)
+				occluded[i] = isBoxOccluded(boxes[i], viewProj, glm::vec2(1.0f), levels);
+		});
+	const double pixelMs = measureMs([&]()
+		{
+			for (int i = 0; i != kHiZBoxes; i++)
+				reference[i] = isBoxOccludedPerPixel(boxes[i], viewProj, depth, width, height);
+		});
+
+	size_t numOccluded = 0;
+	size_t numReference = 0;
+	size_t numFalseOcclusions = 0;
+	for (int i = 0; i != kHiZBoxes; i++)
+	{
+		numOccluded += occluded[i];
+		numReference += reference[i];
+		numFalseOcclusions += occluded[i] && !reference[i];
+	}
+
+	printf("%ux%u depth, pyramid build %.2f ms, %d boxes: HiZ %.3f ms, per pixel %.1f ms\n", width, height, buildMs, kHiZBoxes, hizMs, pixelMs);
+	printf("Occluded: HiZ %zu, per pixel %zu (%.1f%% found), %zu false occlusions %s\n", numOccluded, numReference,
+		numReference ? 100.0 * double(numOccluded) / double(numReference) : 100.0, numFalseOcclusions, numFalseOcclusions ? "FAILED" : "ok");
+	return !numMismatches && !numFalseOcclusions;
+}
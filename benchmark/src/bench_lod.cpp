@@ -0,0 +1,131 @@
+#include <filesystem>
+
+#include <lvk/LVK.h>
+
+#include "benchmarks.h"
+#include "model_loader.h"
+#include "sphere_data.h"
+
+// The LOD error is an RMS quadric estimate, the worst sampled deviation may exceed it by this factor
+static constexpr float kDeviationTolerance = 3.0f;
+static constexpr size_t kDeviationSamples = 500;
+
+static float pointTriangleDistance(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+	// Closest point by Voronoi region, Ericson "Real-Time Collision Detection" 5.1.5
+	const glm::vec3 ab = b - a;
+	const glm::vec3 ac = c - a;
+	const glm::vec3 ap = p - a;
+	const float d1 = glm::dot(ab, ap);
+	const float d2 = glm::dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f)
+		return glm::length(p - a);
+
+	const glm::vec3 bp = p - b;
+	const float d3 = glm::dot(ab, bp);
+	const float d4 = glm::dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3)
+		return glm::length(p - b);
+
+	const float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+		return glm::length(p - (a + ab * (d1 / (d1 - d3))));
+
+	const glm::vec3 cp = p - c;
+	const float d5 = glm::dot(ab, cp);
+	const float d6 = glm::dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6)
+		return glm::length(p - c);
+
+	const float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+		return glm::length(p - (a + ac * (d2 / (d2 - d6))));
+
+	const float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+		return glm::length(p - (b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)))));
+
+	const float denom = 1.0f / (va + vb + vc);
+	return glm::length(p - (a + ab * (vb * denom) + ac * (vc * denom)));
+}
+
+/// Largest distance from a subset of the original vertices to the triangles of a level
+static float sampleDeviation(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const MeshLod& lod)
+{
+	const size_t step = std::max<size_t>(1, vertices.size() / kDeviationSamples);
+
+	float deviation = 0.0f;
+	for (size_t v = 0; v < vertices.size(); v += step)
+	{
+		float closest = std::numeric_limits<float>::max();
+		for (uint32_t i = lod.firstIndex; i != lod.firstIndex + lod.indexCount; i += 3)
+		{
+			closest = std::min(closest, pointTriangleDistance(vertices[v].position,
+				vertices[indices[i + 0]].position, vertices[indices[i + 1]].position, vertices[indices[i + 2]].position));
+		}
+		deviation = std::max(deviation, closest);
+	}
+	return deviation;
+}
+
+static bool checkLodChain(const char* name, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const std::vector<SubMesh>& subMeshes)
+{
+	optimizeMesh(vertices, indices, subMeshes);
+
+	std::vector<MeshLod> lods;
+	const double ms = measureMs([&]() { buildMeshLods(vertices, indices, subMeshes, lods); });
+
+	printf("%s: %zu levels in %.1f ms\n", name, lods.size(), ms);
+
+	bool passed = true;
+
+	for (size_t i = 0; i != lods.size(); i++)
+	{
+		const MeshLod& lod = lods[i];
+		const uint32_t triangles = lod.indexCount / 3;
+		const uint32_t target = uint32_t(float(lods[0].indexCount / 3) * std::pow(kLodReduction, float(i)));
+		const float deviation = i ? sampleDeviation(vertices, indices, lod) : 0.0f;
+
+		// Every level has to shrink, keep a monotonic error and stay close to the surface
+		const bool countOk = i == 0 || (triangles != 0 && lod.indexCount <= lods[i - 1].indexCount * 3 / 4);
+		const bool errorOk = i == 0 ? lod.error == 0.0f : lod.error >= lods[i - 1].error;
+		const bool deviationOk = deviation <= kDeviationTolerance * lod.error + 1e-6f;
+
+		const bool levelOk = countOk && errorOk && deviationOk;
+		passed &= levelOk;
+
+		printf("  LOD %zu: %7u triangles (target %7u), error %.6f, sampled deviation %.6f %s\n",
+			i, triangles, target, lod.error, deviation, levelOk ? "ok" : "FAILED");
+	}
+	return passed;
+}
+
+// Triangle counts and error bounds of the LOD chains of the bundled meshes
+bool benchmarkLods()
+{
+	const char* kModels[] = { "bunny.obj", "teapot.obj" };
+	bool passed = true;
+
+	for (const char* model : kModels)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		std::vector<SubMesh> subMeshes;
+		loadModelData(std::filesystem::absolute(std::filesystem::path(RESOURCE_DIR"/models") / model), vertices, indices, subMeshes);
+		if (vertices.empty())
+		{
+			printf("%s: failed to load FAILED\n", model);
+			passed = false;
+			continue;
+		}
+
+		passed &= checkLodChain(model, vertices, indices, subMeshes);
+	}
+
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	generateUVSphere(0.15f, 32, 64, vertices, indices);
+	const std::vector<SubMesh> subMeshes = { { .indexCount = (uint32_t)indices.size(), .vertexCount = (uint32_t)vertices.size() } };
+	passed &= checkLodChain("UV sphere", vertices, indices, subMeshes);
+	return passed;
+}
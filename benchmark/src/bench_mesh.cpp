@@ -0,0 +1,49 @@
+#include <filesystem>
+
+#include <lvk/LVK.h>
+
+#include "benchmarks.h"
+#include "model_loader.h"
+
+// Cold Assimp import of the bundled OBJ files against a warm load of their mesh cache
+bool benchmarkMeshCache()
+{
+	const char* kModels[] = { "bunny.obj", "teapot.obj" };
+	bool passed = true;
+
+	for (const char* model : kModels)
+	{
+		const std::filesystem::path path = std::filesystem::absolute(std::filesystem::path(RESOURCE_DIR"/models") / model);
+
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		std::vector<SubMesh> subMeshes;
+		const double importMs = measureMs([&]() { loadModelData(path, vertices, indices, subMeshes); });
+
+		// Make sure the cache exists before timing the warm path
+		{
+			MappedFile mapping;
+			MeshCacheView view;
+			if (!loadMeshCache(path, mapping, view))
+			{
+				printf("%s: failed to build the mesh cache FAILED\n", model);
+				passed = false;
+				continue;
+			}
+		}
+
+		MappedFile mapping;
+		MeshCacheView view;
+		uint32_t checksum = 0;
+		const double cacheMs = measureMs([&]() {
+			loadMeshCache(path, mapping, view);
+			// Touch every index so the pages are actually read in
+			for (uint32_t i = 0; i != view.numIndices; i++)
+				checksum += view.indices[i];
+			});
+
+		printf("%-12s %7u verts %8u indices: Assimp import %8.2f ms, mesh cache %6.2f ms (%.1fx) [%u]\n",
+			model, view.numVertices, view.numIndices, importMs, cacheMs, importMs / cacheMs, checksum);
+	}
+	return passed;
+}
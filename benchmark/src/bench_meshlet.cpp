@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <array>
+#include <filesystem>
+
+#include <lvk/LVK.h>
+
+#include "benchmarks.h"
+#include "meshlet_builder.h"
+#include "model_loader.h"
+#include "sphere_data.h"
+
+static constexpr int kCullCameras = 64;
+
+static std::vector<std::array<uint32_t, 3>> sortedTriangles(const uint32_t* indices, size_t numIndices)
+{
+	std::vector<std::array<uint32_t, 3>> triangles;
+	for (size_t i = 0; i + 2 < numIndices; i += 3)
+		triangles.push_back({ indices[i], indices[i + 1], indices[i + 2] });
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+/// A triangle of a culled meshlet is only allowed to face away or to be outside of one frustum plane
+static bool isTriangleInvisible(const std::vector<Vertex>& vertices, const uint32_t* tri, const MeshletCullParams& params, float epsilon)
+{
+	const glm::vec3& a = vertices[tri[0]].position;
+	const glm::vec3& b = vertices[tri[1]].position;
+	const glm::vec3& c = vertices[tri[2]].position;
+
+	const glm::vec3 n = glm::cross(b - a, c - a);
+	const float length = glm::length(n);
+	if (length == 0.0f || glm::dot(n / length, params.cameraPosition - a) <= epsilon)
+		return true;
+
+	for (const glm::vec4& plane : params.frustumPlanes)
+	{
+		if (glm::dot(plane, glm::vec4(a, 1.0f)) < epsilon && glm::dot(plane, glm::vec4(b, 1.0f)) < epsilon && glm::dot(plane, glm::vec4(c, 1.0f)) < epsilon)
+			return true;
+	}
+	return false;
+}
+
+static bool checkMeshlets(const char* name, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const std::vector<SubMesh>& subMeshes)
+{
+	optimizeMesh(vertices, indices, subMeshes);
+	std::vector<MeshLod> lods;
+	buildMeshLods(vertices, indices, subMeshes, lods);
+
+	const std::vector<std::array<uint32_t, 3>> before = sortedTriangles(indices.data(), lods[0].indexCount);
+	const VertexCacheStats cacheBefore = analyzeVertexCache(indices.data(), lods[0].indexCount, vertices.size());
+
+	MeshletData meshlets;
+	const double ms = measureMs([&]() { buildMeshMeshlets(vertices, indices, subMeshes, meshlets); });
+
+	const VertexCacheStats cacheAfter = analyzeVertexCache(indices.data(), lods[0].indexCount, vertices.size());
+
+	// Limits, contiguous ranges over level 0 and the same set of triangles
+	bool buildOk = before == sortedTriangles(indices.data(), lods[0].indexCount);
+	uint32_t nextIndex = 0;
+	size_t totalVertices = 0;
+	size_t numCones = 0;
+	std::vector<uint32_t> unique;
+	for (size_t i = 0; i != meshlets.size(); i++)
+	{
+		const glm::uvec2& range = meshlets.ranges[i];
+		unique.assign(indices.begin() + range.x, indices.begin() + range.x + range.y);
+		std::sort(unique.begin(), unique.end());
+		unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+
+		buildOk &= range.x == nextIndex && range.y % 3 == 0 && range.y / 3 <= kMaxMeshletTriangles && unique.size() <= kMaxMeshletVertices;
+		nextIndex = range.x + range.y;
+		totalVertices += unique.size();
+		numCones += meshlets.cones[i].w < 1.0f;
+	}
+	buildOk &= nextIndex == lods[0].indexCount;
+
+	printf("%s: %zu meshlets in %.1f ms, %.1f triangles and %.1f vertices each, %.0f%% with a cone, ACMR %.3f -> %.3f %s\n",
+		name, meshlets.size(), ms, float(lods[0].indexCount / 3) / float(meshlets.size()), float(totalVertices) / float(meshlets.size()),
+		100.0f * float(numCones) / float(meshlets.size()), cacheBefore.acmr, cacheAfter.acmr, buildOk ? "ok" : "FAILED");
+
+	// Cameras around the mesh, looking past its center so the frustum cuts some of it away
+	const BoundingBox bounds = computeBounds(vertices.data(), vertices.size());
+	const glm::vec3 center = bounds.getCenter();
+	const float radius = 0.5f * glm::length(bounds.getSize());
+	const glm::mat4 proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.01f * radius, 100.0f * radius);
+
+	std::vector<DrawRange> draws;
+	size_t numVisible = 0;
+	size_t numFalseCulls = 0;
+	for (int i = 0; i != kCullCameras; i++)
+	{
+		const float theta = glm::radians(180.0f * (float(i) + 0.5f) / float(kCullCameras));
+		const float phi = glm::radians(137.5f * float(i));
+		const glm::vec3 dir(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+		const glm::vec3 eye = center + dir * radius * (1.5f + float(i % 4));
+		const glm::vec3 target = center + glm::vec3(dir.z, 0.0f, -dir.x) * radius * 0.5f * float(i % 3);
+
+		const MeshletCullParams params = getMeshletCullParams(glm::mat4(1.0f), glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f)), proj);
+		numVisible += cullMeshlets(meshlets, params, draws);
+
+		// Every meshlet that is not drawn has to be invisible triangle by triangle
+		size_t d = 0;
+		for (size_t m = 0; m != meshlets.size(); m++)
+		{
+			const glm::uvec2& range = meshlets.ranges[m];
+			while (d != draws.size() && draws[d].firstIndex + draws[d].indexCount <= range.x)
+				d++;
+			if (d != draws.size() && draws[d].firstIndex <= range.x)
+				continue;
+
+			for (uint32_t t = range.x; t != range.x + range.y; t += 3)
+				numFalseCulls += !isTriangleInvisible(vertices, indices.data() + t, params, 1e-5f * radius);
+		}
+	}
+
+	printf("  %d cameras: %.1f%% of the meshlets culled, %zu visible triangles culled %s\n",
+		kCullCameras, 100.0f - 100.0f * float(numVisible) / float(meshlets.size() * kCullCameras), numFalseCulls, numFalseCulls ? "FAILED" : "ok");
+	return buildOk && !numFalseCulls;
+}
+
+// Meshlet limits and cluster culling of the bundled meshes, culling is validated against per triangle tests
+bool benchmarkMeshlets()
+{
+	const char* kModels[] = { "bunny.obj", "teapot.obj" };
+	bool passed = true;
+
+	for (const char* model : kModels)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		std::vector<SubMesh> subMeshes;
+		loadModelData(std::filesystem::absolute(std::filesystem::path(RESOURCE_DIR"/models") / model), vertices, indices, subMeshes);
+		if (vertices.empty())
+		{
+			printf("%s: failed to load FAILED\n", model);
+			passed = false;
+			continue;
+		}
+
+		passed &= checkMeshlets(model, vertices, indices, subMeshes);
+	}
+
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	generateUVSphere(0.15f, 32, 64, vertices, indices);
+	const std::vector<SubMesh> subMeshes = { { .indexCount = (uint32_t)indices.size(), .vertexCount = (uint32_t)vertices.size() } };
+	passed &= checkMeshlets("UV sphere", vertices, indices, subMeshes);
+	return passed;
+}
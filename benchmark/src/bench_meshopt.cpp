@@ -0,0 +1,61 @@
+#include <filesystem>
+
+#include <lvk/LVK.h>
+
+#include "benchmarks.h"
+#include "model_loader.h"
+#include "sphere_data.h"
+
+static void reportMeshOptimization(const char* name, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const std::vector<SubMesh>& subMeshes)
+{
+	const VertexCacheStats before = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+	const double ms = measureMs([&]() { optimizeMesh(vertices, indices, subMeshes); });
+	const VertexCacheStats after = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+
+	printf("%-12s %7zu verts %8zu tris: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f in %7.2f ms\n",
+		name, vertices.size(), indices.size() / 3, before.acmr, after.acmr, before.atvr, after.atvr, ms);
+}
+
+// Post-transform cache statistics (FIFO of kVertexCacheSize) of the bundled meshes before and after optimizeMesh()
+bool benchmarkMeshOptimizer()
+{
+	const char* kModels[] = { "bunny.obj", "teapot.obj" };
+	bool passed = true;
+
+	for (const char* model : kModels)
+	{
+		const std::filesystem::path path = std::filesystem::absolute(std::filesystem::path(RESOURCE_DIR"/models") / model);
+
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		std::vector<SubMesh> subMeshes;
+		loadModelData(path, vertices, indices, subMeshes);
+		if (vertices.empty())
+		{
+			printf("%s: failed to load FAILED\n", model);
+			passed = false;
+			continue;
+		}
+
+		reportMeshOptimization(model, vertices, indices, subMeshes);
+	}
+
+	auto wholeMesh = [](const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+		{
+			return std::vector<SubMesh>{ { .indexCount = (uint32_t)indices.size(), .vertexCount = (uint32_t)vertices.size() } };
+		};
+
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		generateUVSphere(0.15f, 32, 64, vertices, indices);
+		reportMeshOptimization("UV sphere", vertices, indices, wholeMesh(vertices, indices));
+	}
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		generateIcoSphere(0.15f, 5, vertices, indices);
+		reportMeshOptimization("Ico sphere", vertices, indices, wholeMesh(vertices, indices));
+	}
+	return passed;
+}
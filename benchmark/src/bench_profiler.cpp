@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "benchmarks.h"
+#include "frame_profiler.h"
+
+static constexpr int kProfilerStats = 64;
+static constexpr int kTraceScopes = 20;
+
+/// Nearest rank percentile of the last kProfilerHistory values
+static float getReferencePercentile(const std::vector<float>& values, float p)
+{
+	const size_t n = std::min(values.size(), (size_t)kProfilerHistory);
+	std::vector<float> window(values.end() - n, values.end());
+	std::sort(window.begin(), window.end());
+	const size_t rank = std::max((size_t)std::ceil(p * (float)n), (size_t)1);
+	return window[rank - 1];
+}
+
+// Percentiles of the rolling window against sorting the last frames, the cost of the percentiles the profiler window
+// shows every frame, and a Chrome trace of a recording the size the UI writes
+bool benchmarkProfiler()
+{
+	std::mt19937 rng(1357);
+	std::uniform_real_distribution<float> frameMs(1.0f, 30.0f);
+
+	size_t numMismatches = 0;
+	for (int numFrames : { 1, 7, 100, 256, 257, 1000 })
+	{
+		ProfilerStat stat;
+		std::vector<float> values;
+		for (int i = 0; i != numFrames; i++)
+		{
+			values.push_back(frameMs(rng));
+			stat.add(values.back());
+		}
+
+		const ProfilerPercentiles percentiles = stat.getPercentiles();
+		numMismatches += percentiles.p50 != getReferencePercentile(values, 0.50f);
+		numMismatches += percentiles.p95 != getReferencePercentile(values, 0.95f);
+		numMismatches += percentiles.p99 != getReferencePercentile(values, 0.99f);
+	}
+	printf("Percentiles of 6 window fills: %zu mismatches %s\n", numMismatches, numMismatches ? "FAILED" : "ok");
+
+	std::vector<ProfilerStat> stats(kProfilerStats);
+	for (int i = 0; i != kProfilerStats; i++)
+	{
+		stats[i].name = "Scope " + std::to_string(i);
+		stats[i].gpu = i % 2;
+		for (uint32_t f = 0; f != kProfilerHistory; f++)
+			stats[i].add(frameMs(rng));
+	}
+	float checksum = 0.0f;
+	const double percentileMs = measureMs([&]()
+		{
+			for (const ProfilerStat& stat : stats)
+				checksum += stat.getPercentiles().p99;
+		});
+	printf("Percentiles of %d scopes: %.3f ms per frame (checksum %.1f)\n", kProfilerStats, percentileMs, checksum);
+
+	std::vector<ProfilerTraceEvent> events;
+	for (uint32_t frame = 0; frame != kProfilerTraceFrames; frame++)
+		for (int scope = 0; scope != kTraceScopes; scope++)
+			events.push_back({ (uint32_t)scope, frame * 16666.0 + scope * 100.0, 90.0 });
+
+	const std::filesystem::path file = std::filesystem::temp_directory_path() / "bench_profiler_trace.json";
+	bool written = false;
+	const double traceMs = measureMs([&]() { written = writeChromeTrace(file, stats, events); });
+
+	std::ifstream in(file);
+	std::stringstream text;
+	text << in.rdbuf();
+	const std::string json = text.str();
+	size_t numEvents = 0;
+	for (size_t pos = json.find("\"ph\":\"X\""); pos != std::string::npos; pos = json.find("\"ph\":\"X\"", pos + 1))
+		numEvents++;
+	const bool traceOk = written && json.rfind("{\"displayTimeUnit\"", 0) == 0 && json.find("]}") != std::string::npos && numEvents == events.size();
+	printf("Chrome trace of %u frames, %zu events: %.2f ms, %zu bytes %s\n", kProfilerTraceFrames, events.size(), traceMs, json.size(), traceOk ? "ok" : "FAILED");
+	std::filesystem::remove(file);
+	return !numMismatches && traceOk;
+}
@@ -0,0 +1,161 @@
+#include <filesystem>
+#include <map>
+#include <sstream>
+
+#include <glslang/Include/glslang_c_interface.h>
+#include <lvk/LVK.h>
+
+#include "benchmarks.h"
+#include "shader_processor.h"
+
+static constexpr int kShaderPasses = 100;
+
+/// Recursive find and replace include expansion the preprocessor took over from, kept as the baseline
+static std::string expandIncludesByReplace(const fs::path& file, std::map<fs::path, bool>& includeGuard)
+{
+	if (!includeGuard.emplace(fs::absolute(file), true).second)
+		return {};
+
+	std::ifstream in(file, std::ios::binary);
+	std::string code((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	size_t pos = 0;
+	while ((pos = code.find("#include", pos)) != std::string::npos)
+	{
+		const auto start = code.find('<', pos);
+		const auto end = code.find('>', start);
+		if (start == std::string::npos || end == std::string::npos)
+			break;
+		code.replace(pos, end - pos + 1, expandIncludesByReplace(file.parent_path() / code.substr(start + 1, end - start - 1), includeGuard));
+	}
+	return code;
+}
+
+/// Every shader stage file in resources/shaders, includes (.sp) and the SPIR-V cache directory are skipped
+static std::vector<fs::path> findShaders()
+{
+	std::vector<fs::path> shaders;
+	for (const fs::directory_entry& entry : fs::directory_iterator(fs::absolute(SHADER_DIR)))
+	{
+		if (entry.is_regular_file() && entry.path().extension() != ".sp")
+			shaders.push_back(entry.path());
+	}
+	std::sort(shaders.begin(), shaders.end());
+	return shaders;
+}
+
+/// No directive the preprocessor handles may be left at the start of a line
+static bool hasUnexpandedDirectives(const std::string& code)
+{
+	std::istringstream lines(code);
+	std::string line;
+	while (std::getline(lines, line))
+	{
+		const size_t first = line.find_first_not_of(" \t");
+		if (first != std::string::npos && (line.compare(first, 8, "#include") == 0 || line.compare(first, 12, "#pragma once") == 0))
+			return true;
+	}
+	return false;
+}
+
+// Preprocessing of every shader in resources/shaders: string replacing includes, a cold and a warm include cache
+bool benchmarkShaderPreprocessor()
+{
+	const std::vector<fs::path> shaders = findShaders();
+
+	size_t checksum = 0;
+	const double replaceMs = measureMs([&]() {
+		for (int pass = 0; pass != kShaderPasses; pass++)
+		{
+			for (const fs::path& shader : shaders)
+			{
+				std::map<fs::path, bool> includeGuard;
+				checksum += expandIncludesByReplace(shader, includeGuard).size();
+			}
+		}
+		});
+
+	const double coldMs = measureMs([&]() {
+		for (int pass = 0; pass != kShaderPasses; pass++)
+		{
+			ShaderPreprocessor preprocessor;
+			for (const fs::path& shader : shaders)
+				checksum += preprocessor.preprocess(shader).code.size();
+		}
+		});
+
+	ShaderPreprocessor preprocessor;
+	bool isValid = true;
+	for (const fs::path& shader : shaders)
+	{
+		const PreprocessedShader result = preprocessor.preprocess(shader, getShaderDefines());
+		isValid &= result.isValid && !hasUnexpandedDirectives(result.code);
+
+		printf("  %-18s %5zu bytes, %zu dependencies\n", shader.filename().string().c_str(), result.code.size(), result.dependencies.size());
+	}
+
+	const double warmMs = measureMs([&]() {
+		for (int pass = 0; pass != kShaderPasses; pass++)
+		{
+			for (const fs::path& shader : shaders)
+				checksum += preprocessor.preprocess(shader).code.size();
+		}
+		});
+
+	const double scale = 1000.0 / double(kShaderPasses * shaders.size());
+	printf("%zu shaders, per shader: string replace %.1f us, cold cache %.1f us, warm cache %.1f us [%zu] %s\n",
+		shaders.size(), replaceMs * scale, coldMs * scale, warmMs * scale, checksum, isValid ? "ok" : "FAILED");
+	return isValid;
+}
+
+// Per shader startup cost of preprocessing plus SPIR-V from glslang (cold cache) or from the cache (warm)
+bool benchmarkSpirvCache()
+{
+	const std::vector<fs::path> shaders = findShaders();
+
+	glslang_initialize_process();
+	// No device here, the default limits stand in for the ones LVK derives from it
+	const glslang_resource_t& resource = *glslang_default_resource();
+
+	double totalColdMs = 0.0;
+	double totalWarmMs = 0.0;
+	bool isValid = true;
+	for (const fs::path& shader : shaders)
+	{
+		const lvk::ShaderStage stage = shaderStageFromPath(shader);
+		const auto loadSpirv = [&](std::vector<uint8_t>& spirv, bool& cacheHit)
+			{
+				ShaderPreprocessor preprocessor;
+				const PreprocessedShader result = preprocessor.preprocess(shader, getShaderPreamble(stage) + getShaderDefines());
+				return result.isValid && getShaderSpirv(shader, result.code, stage, resource, spirv, cacheHit);
+			};
+
+		// Drop the cached binary so the first load compiles
+		{
+			ShaderPreprocessor preprocessor;
+			const PreprocessedShader result = preprocessor.preprocess(shader, getShaderPreamble(stage) + getShaderDefines());
+			std::error_code ec;
+			fs::remove(getSpirvCachePath(shader, getSpirvCacheKey(result.code, stage, resource)), ec);
+		}
+
+		std::vector<uint8_t> coldSpirv, warmSpirv;
+		bool coldHit = true, warmHit = false;
+		bool loaded = true;
+		const double coldMs = measureMs([&]() { loaded &= loadSpirv(coldSpirv, coldHit); });
+		const double warmMs = measureMs([&]() { loaded &= loadSpirv(warmSpirv, warmHit); });
+
+		const bool shaderOk = loaded && !coldHit && warmHit && coldSpirv == warmSpirv;
+		isValid &= shaderOk;
+		totalColdMs += coldMs;
+		totalWarmMs += warmMs;
+
+		printf("  %-18s %6zu bytes SPIR-V: cold %8.2f ms, warm %6.2f ms %s\n",
+			shader.filename().string().c_str(), coldSpirv.size(), coldMs, warmMs, shaderOk ? "ok" : "FAILED");
+	}
+
+	glslang_finalize_process();
+
+	printf("%zu shaders: cold %.1f ms, warm %.1f ms (%.1fx) %s\n",
+		shaders.size(), totalColdMs, totalWarmMs, totalColdMs / totalWarmMs, isValid ? "ok" : "FAILED");
+	return isValid;
+}
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#include "benchmarks.h"
+#include "shadow_maps.h"
+
+static constexpr float kShadowNear = 0.1f;
+static constexpr float kShadowFar = 1000.0f;
+static constexpr float kShadowTestDistance = 20.0f;
+static constexpr int kShadowCameras = 200;
+static constexpr int kShadowSamples = 1000;
+static constexpr int kShadowIterations = 100000;
+
+static glm::vec3 getRandomDirection(std::mt19937& rng)
+{
+	std::normal_distribution<float> normal;
+	return glm::normalize(glm::vec3(normal(rng), normal(rng), normal(rng)));
+}
+
+/// Light space texel coordinate of a world position in a cascade
+static glm::vec2 getCascadeTexel(const ShadowCascade& cascade, const glm::vec3& position)
+{
+	const glm::vec4 clip = cascade.proj * cascade.view * glm::vec4(position, 1.0f);
+	return (glm::vec2(clip) * 0.5f + 0.5f) * (float)kShadowCascadeSize;
+}
+
+// Every point of the slice of a cascade, and every caster up to kShadowCasterDistance towards the light from it, has
+// to land inside the cascade for random cameras and lights. Then stability: turning the camera keeps the texel size,
+// moving it moves the cascades by whole texels. Last the cost of fitting the cascades once a frame.
+bool benchmarkShadowCascades()
+{
+	std::mt19937 rng(86420);
+	std::uniform_real_distribution<float> coord(-10.0f, 10.0f);
+	std::uniform_real_distribution<float> ndc(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	size_t numOutside = 0;
+	size_t numCastersOutside = 0;
+	for (int i = 0; i != kShadowCameras; i++)
+	{
+		const glm::vec3 eye(coord(rng), coord(rng), coord(rng));
+		const glm::mat4 view = glm::lookAt(eye, eye + getRandomDirection(rng), glm::vec3(0.0f, 1.0f, 0.0f));
+		const glm::mat4 proj = glm::perspective(glm::radians(30.0f + 60.0f * unit(rng)), 0.5f + 2.0f * unit(rng), kShadowNear, kShadowFar);
+		const glm::vec3 lightDirection = getRandomDirection(rng);
+
+		ShadowCascade cascades[kNumShadowCascades];
+		computeShadowCascades(view, proj, lightDirection, kShadowNear, kShadowTestDistance, cascades);
+
+		const glm::mat4 invView = glm::inverse(view);
+		const glm::mat4 invProj = glm::inverse(proj);
+		float sliceBegin = kShadowNear;
+		for (const ShadowCascade& cascade : cascades)
+		{
+			const glm::mat4 viewProj = cascade.proj * cascade.view;
+			for (int s = 0; s != kShadowSamples; s++)
+			{
+				const glm::vec4 p = invProj * glm::vec4(ndc(rng), ndc(rng), 1.0f, 1.0f);
+				const float depth = sliceBegin + (cascade.splitDepth - sliceBegin) * unit(rng);
+				const glm::vec3 position = glm::vec3(invView * glm::vec4(glm::vec3(p) / -p.z * depth, 1.0f));
+
+				const glm::vec4 clip = viewProj * glm::vec4(position, 1.0f);
+				const float eps = 1e-4f;
+				numOutside += std::abs(clip.x) > 1.0f + eps || std::abs(clip.y) > 1.0f + eps || clip.z < -eps || clip.z > 1.0f + eps;
+				const glm::vec4 caster = viewProj * glm::vec4(position + lightDirection * kShadowCasterDistance * 0.999f, 1.0f);
+				numCastersOutside += caster.z < -eps;
+			}
+			sliceBegin = cascade.splitDepth;
+		}
+	}
+	const size_t numPoints = size_t(kShadowCameras) * kNumShadowCascades * kShadowSamples;
+	const bool covered = !numOutside && !numCastersOutside;
+	printf("%zu points of the cascade slices: %zu outside of their cascade, %zu casters clipped %s\n", numPoints, numOutside, numCastersOutside,
+		covered ? "ok" : "FAILED");
+
+	// Turning and moving the camera, a point the camera does not move relative to has to stay on the same spot of its texel
+	const glm::mat4 proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, kShadowNear, kShadowFar);
+	const glm::vec3 lightDirection = glm::normalize(glm::vec3(14.0f, 7.0f, 7.0f));
+	ShadowCascade reference[kNumShadowCascades];
+	computeShadowCascades(glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f)), proj, lightDirection, kShadowNear,
+		kShadowTestDistance, reference);
+	const glm::vec3 fixedPoint(0.3f, 0.2f, -0.4f);
+
+	float maxSizeChange = 0.0f;
+	float maxTexelOffset = 0.0f;
+	for (int i = 0; i != kShadowCameras; i++)
+	{
+		const glm::vec3 eye = glm::vec3(coord(rng), coord(rng), coord(rng)) * 0.1f;
+		ShadowCascade cascades[kNumShadowCascades];
+		computeShadowCascades(glm::lookAt(eye, eye + getRandomDirection(rng), glm::vec3(0.0f, 1.0f, 0.0f)), proj, lightDirection, kShadowNear,
+			kShadowTestDistance, cascades);
+		for (uint32_t c = 0; c != kNumShadowCascades; c++)
+		{
+			maxSizeChange = std::max(maxSizeChange, std::abs(cascades[c].texelSize / reference[c].texelSize - 1.0f));
+			const glm::vec2 offset = getCascadeTexel(cascades[c], fixedPoint) - getCascadeTexel(reference[c], fixedPoint);
+			const glm::vec2 fraction = glm::abs(offset - glm::vec2(std::round(offset.x), std::round(offset.y)));
+			maxTexelOffset = std::max({ maxTexelOffset, fraction.x, fraction.y });
+		}
+	}
+	const bool stable = maxSizeChange < 1e-4f && maxTexelOffset < 0.01f;
+	printf("%d camera moves: texel size changed by %g, cascades moved by %g texels off the grid %s\n", kShadowCameras, maxSizeChange, maxTexelOffset,
+		stable ? "ok" : "FAILED");
+
+	ShadowCascade cascades[kNumShadowCascades];
+	float checksum = 0.0f;
+	const double ms = measureMs([&]()
+	{
+		for (int i = 0; i != kShadowIterations; i++)
+		{
+			const float a = (float)i * 0.001f;
+			const glm::vec3 eye(std::cos(a), 0.2f, std::sin(a));
+			computeShadowCascades(glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)), proj, lightDirection, kShadowNear, kShadowTestDistance, cascades);
+			checksum += cascades[kNumShadowCascades - 1].proj[3][0];
+		}
+	});
+	printf("computeShadowCascades: %.3f us per frame (checksum %g)\n", ms * 1000.0 / kShadowIterations, checksum);
+	return covered && stable;
+}
@@ -0,0 +1,68 @@
+#include <filesystem>
+
+#include <lvk/LVK.h>
+
+#include "benchmarks.h"
+#include "model_loader.h"
+#include "sphere_data.h"
+
+static void reportPackingError(const char* name, const std::vector<Vertex>& vertices)
+{
+	const BoundingBox bounds = computeBounds(vertices.data(), vertices.size());
+	const VertexQuantization q = getVertexQuantization(bounds);
+
+	std::vector<PackedVertex> packed;
+	const double ms = measureMs([&]() { packed = packVertices(vertices.data(), vertices.size(), q); });
+
+	float maxPositionError = 0.0f;
+	float maxNormalAngle = 0.0f;
+	float maxUVError = 0.0f;
+	for (size_t i = 0; i != vertices.size(); i++)
+	{
+		const Vertex decoded = unpackVertex(packed[i], q);
+		maxPositionError = std::max(maxPositionError, glm::length(decoded.position - vertices[i].position));
+
+		const float normalLength = glm::length(vertices[i].normal);
+		if (normalLength > 0.0f)
+		{
+			const float cosAngle = glm::clamp(glm::dot(decoded.normal, vertices[i].normal / normalLength), -1.0f, 1.0f);
+			maxNormalAngle = std::max(maxNormalAngle, glm::degrees(std::acos(cosAngle)));
+		}
+
+		maxUVError = std::max(maxUVError, std::max(std::abs(decoded.uv.x - vertices[i].uv.x), std::abs(decoded.uv.y - vertices[i].uv.y)));
+	}
+
+	const float diagonal = glm::length(bounds.max_ - bounds.min_);
+	printf("%-12s %7zu verts: %zu -> %zu KB in %6.2f ms, max error position %.2e (%.5f%% of the diagonal), normal %.4f deg, uv %.2e\n",
+		name, vertices.size(), vertices.size() * sizeof(Vertex) / 1024, packed.size() * sizeof(PackedVertex) / 1024, ms,
+		maxPositionError, diagonal > 0.0f ? 100.0f * maxPositionError / diagonal : 0.0f, maxNormalAngle, maxUVError);
+}
+
+// Round trip of the bundled meshes through PackedVertex
+bool benchmarkVertexPacking()
+{
+	const char* kModels[] = { "bunny.obj", "teapot.obj" };
+	bool passed = true;
+
+	for (const char* model : kModels)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		std::vector<SubMesh> subMeshes;
+		loadModelData(std::filesystem::absolute(std::filesystem::path(RESOURCE_DIR"/models") / model), vertices, indices, subMeshes);
+		if (vertices.empty())
+		{
+			printf("%s: failed to load FAILED\n", model);
+			passed = false;
+			continue;
+		}
+
+		reportPackingError(model, vertices);
+	}
+
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	generateUVSphere(0.15f, 32, 64, vertices, indices);
+	reportPackingError("UV sphere", vertices);
+	return passed;
+}
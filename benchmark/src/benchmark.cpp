@@ -0,0 +1,54 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "benchmarks.h"
+
+struct BenchmarkEntry
+{
+	const char* name;
+	bool (*func)();
+};
+
+static const BenchmarkEntry kBenchmarks[] =
+{
+	{ "cubemap", benchmarkCubemap },
+	{ "mesh", benchmarkMeshCache },
+	{ "meshopt", benchmarkMeshOptimizer },
+	{ "vertexpack", benchmarkVertexPacking },
+	{ "lod", benchmarkLods },
+	{ "meshlet", benchmarkMeshlets },
+	{ "shaders", benchmarkShaderPreprocessor },
+	{ "spirv", benchmarkSpirvCache },
+	{ "culling", benchmarkInstanceCulling },
+	{ "frustum", benchmarkFrustumCulling },
+	{ "bvh", benchmarkBvh },
+	{ "hiz", benchmarkHiZ },
+	{ "profiler", benchmarkProfiler },
+	{ "camerapath", benchmarkCameraPath },
+	{ "clusters", benchmarkLightClusters },
+	{ "shadows", benchmarkShadowCascades },
+};
+
+// Usage: Benchmark [name...], runs everything when no name is given. Fails when a check of one of them failed.
+int main(int argc, char** argv)
+{
+	int numFailed = 0;
+	for (const BenchmarkEntry& entry : kBenchmarks)
+	{
+		bool selected = argc < 2;
+		for (int i = 1; i < argc; i++)
+			selected |= strcmp(argv[i], entry.name) == 0;
+
+		if (!selected)
+			continue;
+
+		printf("=== %s ===\n", entry.name);
+		if (!entry.func())
+		{
+			printf("=== %s FAILED ===\n", entry.name);
+			numFailed++;
+		}
+	}
+
+	return numFailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+
+/// Wall clock time of a single call in milliseconds
+template <typename Func>
+inline double measureMs(Func&& func)
+{
+	const auto start = std::chrono::steady_clock::now();
+	func();
+	const auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Every benchmark lives in its own bench_*.cpp file and returns false when one of its checks failed
+bool benchmarkCubemap();
+bool benchmarkMeshCache();
+bool benchmarkMeshOptimizer();
+bool benchmarkVertexPacking();
+bool benchmarkLods();
+bool benchmarkMeshlets();
+bool benchmarkShaderPreprocessor();
+bool benchmarkSpirvCache();
+bool benchmarkInstanceCulling();
+bool benchmarkFrustumCulling();
+bool benchmarkBvh();
+bool benchmarkHiZ();
+bool benchmarkProfiler();
+bool benchmarkCameraPath();
+bool benchmarkLightClusters();
+bool benchmarkShadowCascades();
@@ -0,0 +1,9 @@
+#include "shading_models.h"
+
+// Every shading model in one window, sharing the context, meshes and textures
+int main(int argc, char** argv)
+{
+	ShadingApp app(argc, argv);
+	addAllShadingModels(app);
+	return app.run();
+}
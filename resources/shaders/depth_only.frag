@@ -0,0 +1,6 @@
+//
+// Fragment shader of the depth prepass pipelines, there is no color attachment and only the depth test runs
+
+void main()
+{
+}
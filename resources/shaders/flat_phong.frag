@@ -5,6 +5,7 @@
 layout (location=0) in vec3 vColor;
 layout (location=1) flat in vec3 vNormal;
 layout (location=2) in vec3 vFragPos;
+layout (location=7) flat in vec4 vInstanceColor;
 
 layout (location=0) out vec4 out_FragColor;
 
@@ -12,8 +13,8 @@ layout (constant_id = 0) const bool isWireframe = false;
 
 void main() {
 	// Object base color
-	vec3 objectColor = vec3(pc.color);
-	float diffuseIntensity = pc.color[3];
+	vec3 objectColor = vec3(pc.color) * vInstanceColor.rgb;
+	float diffuseIntensity = pc.color[3] * vInstanceColor.a;
 
 	// Light color
 	vec3 lightColor = vec3(pc.ambientColor[0], pc.ambientColor[1], pc.ambientColor[2]);
@@ -1,10 +1,7 @@
 //
 
 #include <common.sp>
-
-layout (location=0) in vec3 inPos;
-layout (location=1) in vec3 inNormal;
-layout (location=2) in vec2 inUV;
+#include <vertex.sp>
 
 layout (location=0) out vec3 vColor;
 layout (location=1) out vec3 vNormal;
@@ -14,17 +11,18 @@ layout (constant_id = 0) const bool isWireframe = false;
 
 void main()
 {
-	gl_Position = pc.proj * pc.view * pc.model * vec4(inPos, 1.0f);
+	gl_Position = pc.proj * pc.view * instance.model * vec4(inPos, 1.0f);
 
 	vColor = isWireframe ? vec3(0.0f) : inPos.xyz; // Will be overridden by Gouraud
-	vNormal = mat3(transpose(inverse(pc.model))) * inNormal; 
-	vFragPos = vec3(pc.model * vec4(inPos, 1.0f));
+	vNormal = mat3(transpose(inverse(instance.model))) * inNormal; 
+	vFragPos = vec3(instance.model * vec4(inPos, 1.0f));
+	vInstanceColor = instance.color;
 
 	// In gouraud we calculate the lighting inside vertex shader
 
 	// Object base color
-	vec3 objectColor = vec3(pc.color);
-	float diffuseIntensity = pc.color[3];
+	vec3 objectColor = vec3(pc.color) * instance.color.rgb;
+	float diffuseIntensity = pc.color[3] * instance.color.a;
 
 	// Light color
 	vec3 lightColor = vec3(pc.ambientColor[0], pc.ambientColor[1], pc.ambientColor[2]);
@@ -46,6 +44,21 @@ void main()
 	float specFactor = pow(max(dot(viewDir, reflectDir), 0.0), 32);
 	vec3 specular = specularStrength * specFactor * lightColor; 
 
+	// Point lights of the cluster of the vertex, numLights is 0 without clustered shading
+	vec3 pointLighting = vec3(0.0f);
+	if (pc.numLights != 0) {
+		uint slot = getClusterSlot(vFragPos);
+		uint numClusterLights = pc.clusters.slots[slot];
+		for (uint i = 0u; i < numClusterLights; i++) {
+			PointLight light = pc.lights.lights[pc.clusters.slots[slot + 1u + i]];
+			vec3 pointDirection;
+			float attenuation = getLightAttenuation(light, vFragPos, pointDirection);
+			float pointDiffFactor = max(dot(normalUnit, pointDirection), 0.0);
+			float pointSpecFactor = pow(max(dot(viewDir, reflect(-pointDirection, normalUnit)), 0.0), 32);
+			pointLighting += attenuation * light.color * (pointDiffFactor * diffuseIntensity + specularStrength * pointSpecFactor);
+		}
+	}
+
 	// Result
-	vColor = isWireframe ? vec3(0.0f) : objectColor * (ambientColor + diffuseColor + specular);
+	vColor = isWireframe ? vec3(0.0f) : objectColor * (ambientColor + diffuseColor + specular + pointLighting);
 }
\ No newline at end of file
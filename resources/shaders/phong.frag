@@ -1,10 +1,12 @@
 //
 
 #include <common.sp>
+#include <shadow.sp>
 
 layout (location=0) in vec3 vColor;
 layout (location=1) in vec3 vNormal;
 layout (location=2) in vec3 vFragPos;
+layout (location=7) flat in vec4 vInstanceColor;
 
 layout (location=0) out vec4 out_FragColor;
 
@@ -12,8 +14,8 @@ layout (constant_id = 0) const bool isWireframe = false;
 
 void main() {
 	// Object base color
-	vec3 objectColor = vec3(pc.color);
-	float diffuseIntensity = pc.color[3];
+	vec3 objectColor = vec3(pc.color) * vInstanceColor.rgb;
+	float diffuseIntensity = pc.color[3] * vInstanceColor.a;
 
 	// Light color
 	vec3 lightColor = vec3(pc.ambientColor[0], pc.ambientColor[1], pc.ambientColor[2]);
@@ -27,16 +29,35 @@ void main() {
 	vec3 lightDirection = normalize(vec3(pc.lightPosition) - vFragPos);
 	float diffFactor = max(dot(normalUnit, lightDirection), 0.0);
 	vec3 diffuseColor = diffFactor * lightColor * diffuseIntensity;
+
+	// Shadow of the main light
+	float shadow = getShadow(vFragPos, normalUnit);
+	diffuseColor *= shadow;
 	
 	// Specular
 	float specularStrength = pc.lightingParams.x;
 	vec3 viewDir = normalize(vec3(pc.cameraPosition) - vFragPos);
 	vec3 reflectDir = reflect(-lightDirection, normalUnit);  
 	float specFactor = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-	vec3 specular = specularStrength * specFactor * lightColor; 
+	vec3 specular = specularStrength * specFactor * lightColor * shadow; 
+
+	// Point lights of the cluster, numLights is 0 without clustered shading
+	vec3 pointLighting = vec3(0.0f);
+	if (pc.numLights != 0) {
+		uint slot = getClusterSlot(vFragPos);
+		uint numClusterLights = pc.clusters.slots[slot];
+		for (uint i = 0u; i < numClusterLights; i++) {
+			PointLight light = pc.lights.lights[pc.clusters.slots[slot + 1u + i]];
+			vec3 pointDirection;
+			float attenuation = getLightAttenuation(light, vFragPos, pointDirection);
+			float pointDiffFactor = max(dot(normalUnit, pointDirection), 0.0);
+			float pointSpecFactor = pow(max(dot(viewDir, reflect(-pointDirection, normalUnit)), 0.0), 32);
+			pointLighting += attenuation * light.color * (pointDiffFactor * diffuseIntensity + specularStrength * pointSpecFactor);
+		}
+	}
 	
 	// Result
-	vec4 finalColor = vec4(objectColor, 1.0f) * vec4(ambientColor + diffuseColor + specular, 1.0f);
+	vec4 finalColor = vec4(objectColor, 1.0f) * vec4(ambientColor + diffuseColor + specular + pointLighting, 1.0f);
 	
 	out_FragColor = isWireframe ? vec4(0.0f, 0.0f, 0.0f, 1.0f) : finalColor;
 };
\ No newline at end of file
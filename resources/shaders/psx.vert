@@ -1,22 +1,20 @@
 //
 
 #include <common.sp>
-
-layout (location=0) in vec3 inPos;
-layout (location=1) in vec3 inNormal;
-layout (location=2) in vec2 inUV;
+#include <vertex.sp>
 
 layout (location=0) out vec3 vColor;
 layout (location=1) out vec3 vNormal;
 layout (location=2) out vec3 vFragPos;
 layout (location=3) out vec2 vUV;
+layout (location=4) out vec3 vDirectColor; // Lit by the main light, psx.frag shadows it
 
 layout (constant_id = 0) const bool isWireframe = false;
 
 void main()
 {
 	// PSX has low precision vertices snap to coarse grid in screen space
-	vec4 clip = pc.proj * pc.view * pc.model * vec4(inPos, 1.0);
+	vec4 clip = pc.proj * pc.view * instance.model * vec4(inPos, 1.0);
 	
 	// Clip space -> NDC conversion
 	vec2 ndc = clip.xy / clip.w;
@@ -32,14 +30,15 @@ void main()
 	gl_Position = clip;
 
 	vColor = isWireframe ? vec3(0.0f) : inPos.xyz; // will be overridden by Gouraud
-	vNormal = mat3(transpose(inverse(pc.model))) * inNormal; 
-	vFragPos = vec3(pc.model * vec4(inPos, 1.0f));
+	vNormal = mat3(transpose(inverse(instance.model))) * inNormal; 
+	vFragPos = vec3(instance.model * vec4(inPos, 1.0f));
+	vInstanceColor = instance.color;
 	vUV = inUV;
 
 	// In gouraud we calculate the lighting inside vertex shader
 	// Object base color
-	vec3 objectColor = vec3(pc.color);
-	float diffuseIntensity = pc.color[3];
+	vec3 objectColor = vec3(pc.color) * instance.color.rgb;
+	float diffuseIntensity = pc.color[3] * instance.color.a;
 
 	// Light color
 	vec3 lightColor = vec3(pc.ambientColor[0], pc.ambientColor[1], pc.ambientColor[2]);
@@ -62,5 +61,6 @@ void main()
 	vec3 specular = specularStrength * specFactor * lightColor;
 
 	// Result
-	vColor = isWireframe ? vec3(0.0f) : (objectColor) * (ambientColor + diffuseColor + specular);
+	vColor = isWireframe ? vec3(0.0f) : (objectColor) * ambientColor;
+	vDirectColor = isWireframe ? vec3(0.0f) : (objectColor) * (diffuseColor + specular);
 }
\ No newline at end of file
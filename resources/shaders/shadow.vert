@@ -0,0 +1,12 @@
+//
+// Casters of the shadow cascades, pc.view and pc.proj are those of a cascade (see shadow_maps.h). Drawn with
+// depth_only.frag.
+
+#include <common.sp>
+#include <vertex.sp>
+
+void main()
+{
+	gl_Position = pc.proj * pc.view * instance.model * vec4(inPos, 1.0);
+	vInstanceColor = instance.color;
+}
@@ -8,5 +8,5 @@ layout (location=0) out vec4 out_FragColor;
 
 void main() {
 	// Since we are not using the texture Id for meshes we can use it for our cubemap
-	out_FragColor = textureBindlessCube(pc.textureId, 0, dir);
+	out_FragColor = textureBindlessCubeLod(pc.textureId, pc.samplerId, dir, pc.lightingParams.y);
 };
\ No newline at end of file
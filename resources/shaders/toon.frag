@@ -1,11 +1,13 @@
 //
 
 #include <common.sp>
+#include <shadow.sp>
 
 layout (location=0) in vec3 vColor;
 layout (location=1) in vec3 vNormal;
 layout (location=2) in vec3 vFragPos;
 layout (location=3) in vec2 vUV;
+layout (location=7) flat in vec4 vInstanceColor;
 
 layout (location=0) out vec4 out_FragColor;
 
@@ -23,8 +25,8 @@ void main() {
 	const float rimLightPower = pc.lightingParams.z;
 
 	// Object base color
-	vec3 objectColor = vec3(pc.color);
-	float diffuseIntensity = pc.color[3];
+	vec3 objectColor = vec3(pc.color) * vInstanceColor.rgb;
+	float diffuseIntensity = pc.color[3] * vInstanceColor.a;
 
 	// Light color
 	vec3 lightColor = vec3(pc.ambientColor[0], pc.ambientColor[1], pc.ambientColor[2]);
@@ -36,7 +38,8 @@ void main() {
 	// Diffuse
 	vec3 normalUnit = normalize(vNormal);
 	vec3 lightDirection = normalize(vec3(pc.lightPosition) - vFragPos);
-	float diffFactor = max(dot(normalUnit, lightDirection), 0.0);
+	float shadow = getShadow(vFragPos, normalUnit);
+	float diffFactor = max(dot(normalUnit, lightDirection), 0.0) * shadow; // Banded with the shadow so its edge is a band too
 
 	// Store original diffuse
 	float originalDiffFactor = diffFactor;
@@ -54,7 +57,7 @@ void main() {
 	vec3 viewDir = normalize(vec3(pc.cameraPosition) - vFragPos); // Pixel to camera
 	vec3 reflectDir = reflect(-lightDirection, normalUnit);  
 	float specFactor = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-	vec3 specular = specularStrength * specFactor * lightColor;
+	vec3 specular = specularStrength * specFactor * lightColor * shadow;
 
 	// Full brightness toon specular
 	//float toonSpecular = smoothstep(0.005, 0.01, specFactor);
@@ -71,6 +74,24 @@ void main() {
 	//float toonSpecular = step(0.5, specFactor);
 	//vec3 specular = specularStrength * toonSpecular * lightColor;
 
+	// Point lights of the cluster, numLights is 0 without clustered shading
+	vec3 pointLighting = vec3(0.0f);
+	if (pc.numLights != 0) {
+		uint slot = getClusterSlot(vFragPos);
+		uint numClusterLights = pc.clusters.slots[slot];
+		for (uint i = 0u; i < numClusterLights; i++) {
+			PointLight light = pc.lights.lights[pc.clusters.slots[slot + 1u + i]];
+			vec3 pointDirection;
+			float attenuation = getLightAttenuation(light, vFragPos, pointDirection);
+			float pointDiffFactor = max(dot(normalUnit, pointDirection), 0.0);
+			// Banded like the main light
+			if (pointDiffFactor > 0)
+				pointDiffFactor = ceil(pointDiffFactor * toonColorLevels) * toonScaleFactor;
+			float pointSpecFactor = pow(max(dot(viewDir, reflect(-pointDirection, normalUnit)), 0.0), 32);
+			pointLighting += attenuation * light.color * (pointDiffFactor * diffuseIntensity + specularStrength * pointSpecFactor);
+		}
+	}
+
 	// Rim lighting
 	float rimFactor = dot(viewDir, normalUnit);
 	rimFactor = 1.0f - rimFactor;
@@ -79,6 +100,6 @@ void main() {
 	vec3 rimColor = diffuseColor * rimFactor;
 	
 	// Result
-	vec4 finalColor = vec4(objectColor, 1.0f) * vec4(ambientColor + diffuseColor + specular + rimColor, 1.0f);
+	vec4 finalColor = vec4(objectColor, 1.0f) * vec4(ambientColor + diffuseColor + specular + rimColor + pointLighting, 1.0f);
 	out_FragColor = finalColor;
 };
\ No newline at end of file
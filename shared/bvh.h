@@ -0,0 +1,385 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "utils_math.h"
+
+/*
+	Bounding volume hierarchy over the boxes of scene objects. The build bins the box centroids along every axis and
+	splits where the surface area heuristic is lowest, refit() keeps the tree and only updates the boxes of objects that
+	moved. The item boxes are stored in leaf order and every node covers a contiguous range of them, so a subtree inside
+	the frustum is appended without looking at its nodes.
+*/
+
+// Leaves hold at most this many items, unless the tree reached kBvhMaxDepth
+static constexpr uint32_t kBvhMaxLeafSize = 4;
+// Bins along each axis of the SAH split search
+static constexpr uint32_t kBvhNumBins = 16;
+// Deeper nodes become leaves, the traversal stacks are sized for it
+static constexpr uint32_t kBvhMaxDepth = 64;
+
+struct BvhNode
+{
+	BoundingBox bounds;
+	uint32_t leftChild = 0; // The right child follows it, 0 for leaves since the root is no child
+	uint32_t firstItem = 0; // Leaf order
+	uint32_t numItems = 0;
+};
+
+/// Nearest hit of a ray query, item is ~0u for a miss
+struct BvhRayHit
+{
+	uint32_t item = ~0u;
+	float t = std::numeric_limits<float>::infinity();
+};
+
+inline float getBoxSurfaceArea(const BoundingBox& box)
+{
+	const glm::vec3 size = box.getSize();
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+/// Slab test, distance at which the ray enters the box (0 from inside of it) or infinity when that is not before tMax
+inline float intersectRayBox(const glm::vec3& origin, const glm::vec3& invDir, const BoundingBox& box, float tMax)
+{
+	const glm::vec3 t0 = (box.min_ - origin) * invDir;
+	const glm::vec3 t1 = (box.max_ - origin) * invDir;
+	glm::vec3 tNear = glm::min(t0, t1);
+	glm::vec3 tFar = glm::max(t0, t1);
+	// A ray parallel to a slab that starts on one of its planes gives 0 * inf = NaN. It stays on the plane, so the
+	// slab covers all of it.
+	for (int i = 0; i != 3; i++)
+	{
+		if (std::isnan(t0[i]) || std::isnan(t1[i]))
+		{
+			tNear[i] = -std::numeric_limits<float>::infinity();
+			tFar[i] = std::numeric_limits<float>::infinity();
+		}
+	}
+
+	const float enter = std::max({ tNear.x, tNear.y, tNear.z, 0.0f });
+	const float exit = std::min({ tFar.x, tFar.y, tFar.z, tMax });
+	return enter <= exit && enter < tMax ? enter : std::numeric_limits<float>::infinity();
+}
+
+class Bvh
+{
+public:
+	/// Item i of the queries is boxes[i]
+	void build(const BoundingBox* boxes, uint32_t numItems)
+	{
+		nodes_.clear();
+		itemIndices_.resize(numItems);
+		itemBoxes_.resize(numItems);
+		if (!numItems)
+			return;
+
+		// Partitioned along with the nodes, so every pass of the build reads them in order
+		std::vector<BuildItem> items(numItems);
+		for (uint32_t i = 0; i != numItems; i++)
+			items[i] = { boxes[i], boxes[i].getCenter(), i };
+
+		nodes_.reserve(2 * size_t(numItems));
+		nodes_.push_back({ .firstItem = 0, .numItems = numItems });
+
+		struct BuildTask
+		{
+			uint32_t node;
+			uint32_t depth;
+		};
+		std::vector<BuildTask> tasks = { { 0, 1 } };
+		while (!tasks.empty())
+		{
+			const BuildTask task = tasks.back();
+			tasks.pop_back();
+
+			BuildItem* first = items.data() + nodes_[task.node].firstItem;
+			BuildItem* last = first + nodes_[task.node].numItems;
+			BoundingBox bounds = getEmptyBox();
+			BoundingBox centroidBounds = getEmptyBox();
+			for (const BuildItem* item = first; item != last; item++)
+			{
+				bounds.combineBox(item->box);
+				centroidBounds.combinePoint(item->centroid);
+			}
+			nodes_[task.node].bounds = bounds;
+			if (last - first <= kBvhMaxLeafSize || task.depth == kBvhMaxDepth)
+				continue;
+
+			const uint32_t middle = uint32_t(splitItems(first, last, centroidBounds) - items.data());
+
+			const uint32_t left = (uint32_t)nodes_.size();
+			nodes_[task.node].leftChild = left;
+			nodes_.push_back({ .firstItem = nodes_[task.node].firstItem, .numItems = middle - nodes_[task.node].firstItem });
+			nodes_.push_back({ .firstItem = middle, .numItems = uint32_t(last - items.data()) - middle });
+			tasks.push_back({ left, task.depth + 1 });
+			tasks.push_back({ left + 1, task.depth + 1 });
+		}
+
+		for (uint32_t i = 0; i != numItems; i++)
+		{
+			itemIndices_[i] = items[i].index;
+			itemBoxes_[i] = items[i].box;
+		}
+	}
+
+	/// New boxes for the same items, the tree stays and only the node bounds follow
+	void refit(const BoundingBox* boxes)
+	{
+		for (size_t i = 0; i != itemBoxes_.size(); i++)
+			itemBoxes_[i] = boxes[itemIndices_[i]];
+
+		// Children are always stored after their parent
+		for (size_t i = nodes_.size(); i-- > 0;)
+		{
+			BvhNode& node = nodes_[i];
+			if (node.leftChild)
+			{
+				node.bounds = nodes_[node.leftChild].bounds;
+				node.bounds.combineBox(nodes_[node.leftChild + 1].bounds);
+				continue;
+			}
+
+			node.bounds = itemBoxes_[node.firstItem];
+			for (uint32_t j = node.firstItem + 1; j != node.firstItem + node.numItems; j++)
+				node.bounds.combineBox(itemBoxes_[j]);
+		}
+	}
+
+	/// Items whose box passes isBoxInFrustum(), the same set a linear scan finds. Nodes outside of a plane are skipped,
+	/// planes a node is completely inside of are not tested again below it.
+	void cullFrustum(const glm::mat4& viewProj, std::vector<uint32_t>& outVisible) const
+	{
+		outVisible.clear();
+		if (nodes_.empty())
+			return;
+
+		glm::vec4 planes[6];
+		glm::vec4 corners[8];
+		getFrustumPlanes(viewProj, planes);
+		getFrustumCorners(viewProj, corners);
+
+		struct CullTask
+		{
+			uint32_t node;
+			uint32_t insidePlanes; // Bit per plane
+		};
+		CullTask stack[kBvhMaxDepth + 1];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = { 0, 0 };
+
+		while (stackSize)
+		{
+			const CullTask task = stack[--stackSize];
+			const BvhNode& node = nodes_[task.node];
+
+			uint32_t insidePlanes = task.insidePlanes;
+			bool outside = false;
+			for (uint32_t p = 0; p != 6 && !outside; p++)
+			{
+				if (insidePlanes & (1u << p))
+					continue;
+
+				// Corners furthest along and against the plane normal
+				glm::vec3 positive;
+				glm::vec3 negative;
+				for (int axis = 0; axis != 3; axis++)
+				{
+					positive[axis] = planes[p][axis] > 0.0f ? node.bounds.max_[axis] : node.bounds.min_[axis];
+					negative[axis] = planes[p][axis] > 0.0f ? node.bounds.min_[axis] : node.bounds.max_[axis];
+				}
+				outside = glm::dot(planes[p], glm::vec4(positive, 1.0f)) < 0.0f;
+				if (glm::dot(planes[p], glm::vec4(negative, 1.0f)) >= 0.0f)
+					insidePlanes |= 1u << p;
+			}
+			if (outside)
+				continue;
+
+			if (insidePlanes == 0x3f)
+			{
+				outVisible.insert(outVisible.end(), itemIndices_.begin() + node.firstItem, itemIndices_.begin() + node.firstItem + node.numItems);
+			}
+			else if (!node.leftChild)
+			{
+				for (uint32_t i = node.firstItem; i != node.firstItem + node.numItems; i++)
+				{
+					if (isBoxInFrustum(planes, corners, itemBoxes_[i]))
+						outVisible.push_back(itemIndices_[i]);
+				}
+			}
+			else
+			{
+				stack[stackSize++] = { node.leftChild, insidePlanes };
+				stack[stackSize++] = { node.leftChild + 1, insidePlanes };
+			}
+		}
+	}
+
+	/// Nearest item along the ray, intersectItem(item, tMax) returns the distance of its hit or infinity.
+	/// Nodes are visited front to back and skipped once they start behind the nearest hit.
+	template <typename IntersectItem>
+	BvhRayHit raycast(const glm::vec3& origin, const glm::vec3& dir, IntersectItem&& intersectItem, float tMax = std::numeric_limits<float>::infinity()) const
+	{
+		return raycastLeafOrder(origin, dir, tMax, [&](uint32_t i, float t) { return intersectItem(itemIndices_[i], t); });
+	}
+
+	/// Nearest item box the ray enters
+	BvhRayHit raycast(const glm::vec3& origin, const glm::vec3& dir, float tMax = std::numeric_limits<float>::infinity()) const
+	{
+		const glm::vec3 invDir = 1.0f / dir;
+		return raycastLeafOrder(origin, dir, tMax, [&](uint32_t i, float t) { return intersectRayBox(origin, invDir, itemBoxes_[i], t); });
+	}
+
+	uint32_t getNumItems() const { return (uint32_t)itemIndices_.size(); }
+	const std::vector<BvhNode>& getNodes() const { return nodes_; }
+
+private:
+	struct BuildItem
+	{
+		BoundingBox box;
+		glm::vec3 centroid;
+		uint32_t index;
+	};
+
+	/// intersectItem() gets positions in leaf order
+	template <typename IntersectItem>
+	BvhRayHit raycastLeafOrder(const glm::vec3& origin, const glm::vec3& dir, float tMax, IntersectItem&& intersectItem) const
+	{
+		BvhRayHit hit;
+		hit.t = tMax;
+		if (nodes_.empty())
+			return hit;
+
+		const glm::vec3 invDir = 1.0f / dir;
+		uint32_t stack[kBvhMaxDepth + 1];
+		uint32_t stackSize = 0;
+		if (intersectRayBox(origin, invDir, nodes_[0].bounds, hit.t) < hit.t)
+			stack[stackSize++] = 0;
+
+		while (stackSize)
+		{
+			const BvhNode& node = nodes_[stack[--stackSize]];
+			if (!node.leftChild)
+			{
+				for (uint32_t i = node.firstItem; i != node.firstItem + node.numItems; i++)
+				{
+					const float t = intersectItem(i, hit.t);
+					if (t < hit.t)
+					{
+						hit.t = t;
+						hit.item = itemIndices_[i];
+					}
+				}
+				continue;
+			}
+
+			uint32_t near = node.leftChild;
+			uint32_t far = node.leftChild + 1;
+			float tNear = intersectRayBox(origin, invDir, nodes_[near].bounds, hit.t);
+			float tFar = intersectRayBox(origin, invDir, nodes_[far].bounds, hit.t);
+			if (tFar < tNear)
+			{
+				std::swap(near, far);
+				std::swap(tNear, tFar);
+			}
+			// The nearer child is popped first, a closer hit in it makes the other one skip its items
+			if (tFar < hit.t)
+				stack[stackSize++] = far;
+			if (tNear < hit.t)
+				stack[stackSize++] = near;
+		}
+		return hit;
+	}
+
+	/// Partitions [first, last) at the cheapest binned SAH split and returns where the right half starts.
+	/// Items with the same centroid are split in the middle.
+	static BuildItem* splitItems(BuildItem* first, BuildItem* last, const BoundingBox& centroidBounds)
+	{
+		// Bins of all three axes are filled in one pass over the items, a flat axis puts everything into its first bin
+		const glm::vec3 extent = centroidBounds.getSize();
+		glm::vec3 binScale;
+		for (int axis = 0; axis != 3; axis++)
+			binScale[axis] = extent[axis] > 0.0f ? float(kBvhNumBins) / extent[axis] : 0.0f;
+
+		BoundingBox binBounds[3][kBvhNumBins];
+		uint32_t binCounts[3][kBvhNumBins] = {};
+		for (int axis = 0; axis != 3; axis++)
+			std::fill_n(binBounds[axis], kBvhNumBins, getEmptyBox());
+
+		for (const BuildItem* item = first; item != last; item++)
+		{
+			const glm::vec3 bin = (item->centroid - centroidBounds.min_) * binScale;
+			for (int axis = 0; axis != 3; axis++)
+			{
+				const uint32_t b = std::min(uint32_t(bin[axis]), kBvhNumBins - 1);
+				binCounts[axis][b]++;
+				binBounds[axis][b].combineBox(item->box);
+			}
+		}
+
+		const uint32_t count = uint32_t(last - first);
+		int bestAxis = -1;
+		uint32_t bestBin = 0;
+		float bestCost = std::numeric_limits<float>::max();
+		for (int axis = 0; axis != 3; axis++)
+		{
+			// Area times count of everything right of each split, then sweep from the left
+			float rightCosts[kBvhNumBins] = {};
+			BoundingBox bounds = getEmptyBox();
+			uint32_t numItems = 0;
+			for (uint32_t bin = kBvhNumBins - 1; bin != 0; bin--)
+			{
+				bounds.combineBox(binBounds[axis][bin]);
+				numItems += binCounts[axis][bin];
+				rightCosts[bin] = numItems ? getBoxSurfaceArea(bounds) * float(numItems) : 0.0f;
+			}
+
+			bounds = getEmptyBox();
+			numItems = 0;
+			for (uint32_t bin = 0; bin != kBvhNumBins - 1; bin++)
+			{
+				bounds.combineBox(binBounds[axis][bin]);
+				numItems += binCounts[axis][bin];
+				if (!numItems || numItems == count)
+					continue;
+
+				const float cost = getBoxSurfaceArea(bounds) * float(numItems) + rightCosts[bin + 1];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = bin;
+				}
+			}
+		}
+
+		if (bestAxis < 0)
+			return first + count / 2;
+
+		const float centroidMin = centroidBounds.min_[bestAxis];
+		const float scale = binScale[bestAxis];
+		return std::partition(first, last, [&](const BuildItem& item)
+			{
+				return std::min(uint32_t((item.centroid[bestAxis] - centroidMin) * scale), kBvhNumBins - 1) <= bestBin;
+			});
+	}
+
+	/// Inverted box that any combineBox() replaces
+	static BoundingBox getEmptyBox()
+	{
+		BoundingBox box;
+		box.min_ = glm::vec3(std::numeric_limits<float>::max());
+		box.max_ = glm::vec3(std::numeric_limits<float>::lowest());
+		return box;
+	}
+
+	std::vector<BvhNode> nodes_;
+	std::vector<uint32_t> itemIndices_; // Item of each position in leaf order
+	std::vector<BoundingBox> itemBoxes_; // Leaf order
+};
@@ -79,6 +79,10 @@ public:
 		yawDesired_ = yaw_;
 		pitchDesired_ = pitch_;
 
+		// Headless runs have no window
+		if (!window)
+			return;
+
 		glfwSetWindowUserPointer(window, this);
 		glfwSetKeyCallback(window, [](GLFWwindow* window, int key, int scancode, int action, int mods)
 			{
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/*
+	Camera path for runs that have to see the same frames every time: keys of camera position and look at target,
+	Catmull-Rom interpolated so the camera passes through every key. A looped path wraps around to its first key, a
+	recorded one stops at its last. Paths are saved as text, one key per line with its time, position and target.
+*/
+
+// Time step of every frame of a scripted run, headless or benchmark
+static constexpr float kFixedFrameSeconds = 1.0f / 60.0f;
+
+// Time between the keys of a recording
+static constexpr float kCameraRecordInterval = 0.1f;
+
+struct CameraKey
+{
+	float time = 0.0f;
+	glm::vec3 position = glm::vec3(0.0f);
+	glm::vec3 target = glm::vec3(0.0f);
+};
+
+/// Uniform Catmull-Rom between p1 (t = 0) and p2 (t = 1)
+inline glm::vec3 getCatmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t)
+{
+	const float t2 = t * t;
+	const float t3 = t2 * t;
+	return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+
+class CameraPath
+{
+public:
+	CameraPath() = default;
+
+	/// Keys in increasing time, a looped path goes from its last key back to the first in duration - last key time
+	CameraPath(std::vector<CameraKey> keys, bool looped, float duration = 0.0f) : keys_(std::move(keys)), looped_(looped), duration_(duration) {}
+
+	/// numKeys keys on a circle around target, once around in period seconds
+	static CameraPath makeOrbit(const glm::vec3& target, float radius, float height, float period, uint32_t numKeys = 16)
+	{
+		std::vector<CameraKey> keys(numKeys);
+		for (uint32_t i = 0; i != numKeys; i++)
+		{
+			const float angle = 6.2831853f * (float)i / (float)numKeys;
+			keys[i].time = period * (float)i / (float)numKeys;
+			keys[i].position = glm::vec3(radius * std::sin(angle), height, radius * std::cos(angle));
+			keys[i].target = target;
+		}
+		return CameraPath(std::move(keys), true, period);
+	}
+
+	bool empty() const { return keys_.empty(); }
+	const std::vector<CameraKey>& getKeys() const { return keys_; }
+
+	float getDuration() const { return looped_ ? duration_ : (keys_.empty() ? 0.0f : keys_.back().time); }
+
+	void addKey(const CameraKey& key) { keys_.push_back(key); }
+
+	void evaluate(float time, glm::vec3& outPosition, glm::vec3& outTarget) const
+	{
+		const int numKeys = (int)keys_.size();
+		if (numKeys < 2)
+		{
+			outPosition = numKeys ? keys_[0].position : glm::vec3(0.0f);
+			outTarget = numKeys ? keys_[0].target : glm::vec3(0.0f);
+			return;
+		}
+
+		if (looped_)
+		{
+			time = std::fmod(time, duration_);
+			if (time < 0.0f)
+				time += duration_;
+		}
+		time = std::clamp(time, keys_.front().time, looped_ ? duration_ : keys_.back().time);
+
+		// Key at or before time, the segment ends at the next one
+		const auto next = std::upper_bound(keys_.begin(), keys_.end(), time, [](float t, const CameraKey& key) { return t < key.time; });
+		const int i = std::min((int)(next - keys_.begin()) - 1, looped_ ? numKeys - 1 : numKeys - 2);
+		const float segmentEnd = i + 1 < numKeys ? keys_[i + 1].time : duration_;
+		const float t = segmentEnd > keys_[i].time ? (time - keys_[i].time) / (segmentEnd - keys_[i].time) : 0.0f;
+
+		auto key = [&](int k) -> const CameraKey& { return keys_[looped_ ? (k + numKeys) % numKeys : std::clamp(k, 0, numKeys - 1)]; };
+		outPosition = getCatmullRom(key(i - 1).position, key(i).position, key(i + 1).position, key(i + 2).position, std::min(t, 1.0f));
+		outTarget = getCatmullRom(key(i - 1).target, key(i).target, key(i + 1).target, key(i + 2).target, std::min(t, 1.0f));
+	}
+
+	bool save(const std::filesystem::path& file) const
+	{
+		FILE* out = fopen(file.string().c_str(), "w");
+		if (!out)
+			return false;
+
+		fprintf(out, "# time position.xyz target.xyz\n");
+		for (const CameraKey& key : keys_)
+			fprintf(out, "%.9g %.9g %.9g %.9g %.9g %.9g %.9g\n", key.time, key.position.x, key.position.y, key.position.z, key.target.x, key.target.y, key.target.z);
+		return fclose(out) == 0;
+	}
+
+	/// A loaded path is not looped, keys have to be in increasing time
+	bool load(const std::filesystem::path& file)
+	{
+		FILE* in = fopen(file.string().c_str(), "r");
+		if (!in)
+			return false;
+
+		std::vector<CameraKey> keys;
+		char line[256];
+		while (fgets(line, sizeof(line), in))
+		{
+			CameraKey key;
+			if (line[0] == '#' || sscanf(line, "%f %f %f %f %f %f %f", &key.time, &key.position.x, &key.position.y, &key.position.z, &key.target.x, &key.target.y, &key.target.z) != 7)
+				continue;
+			if (!keys.empty() && key.time <= keys.back().time)
+				continue;
+			keys.push_back(key);
+		}
+		fclose(in);
+
+		if (keys.empty())
+			return false;
+		*this = CameraPath(std::move(keys), false);
+		return true;
+	}
+
+private:
+	std::vector<CameraKey> keys_;
+	bool looped_ = false;
+	float duration_ = 0.0f;
+};
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <lvk/LVK.h>
+#include <glm/glm.hpp>
+
+#include "utils_math.h"
+
+/*
+	Hierarchical Z: a mip chain of the depth buffer where every texel keeps the farthest depth under it. Level 0 is the
+	power of two below the depth buffer size, so each level halves the one before exactly and a screen rectangle maps
+	to the same texels on the CPU and in depth_pyramid.comp. A box is occluded when its nearest depth lies behind the
+	farthest depth of the few texels that cover its screen rectangle.
+
+	The functions here are the CPU reference of depth_pyramid.comp and of the occlusion test in cull_instances.comp,
+	the shaders have to stay in sync with them.
+*/
+
+// Levels the cull shader can address, enough for a 32K depth buffer
+static constexpr uint32_t kMaxDepthPyramidLevels = 16;
+
+// Threads per group of depth_pyramid.comp along x and y
+static constexpr uint32_t kDepthPyramidGroupSize = 8;
+
+/// Size of level 0 for a depth buffer of width x height
+inline glm::uvec2 getDepthPyramidSize(uint32_t width, uint32_t height)
+{
+	return glm::uvec2(std::bit_floor(std::max(width, 1u)), std::bit_floor(std::max(height, 1u)));
+}
+
+inline uint32_t getDepthPyramidLevels(const glm::uvec2& size)
+{
+	return std::min((uint32_t)std::bit_width(std::max(size.x, size.y)), kMaxDepthPyramidLevels);
+}
+
+inline glm::uvec2 getDepthPyramidLevelSize(const glm::uvec2& size, uint32_t level)
+{
+	return glm::uvec2(std::max(size.x >> level, 1u), std::max(size.y >> level, 1u));
+}
+
+/// Texels [begin, end) of the source that texel dst of the next level covers, rounded outwards so level 0 stays
+/// conservative for any depth buffer size
+inline void getDepthPyramidFootprint(const glm::uvec2& dst, const glm::uvec2& srcSize, const glm::uvec2& dstSize, glm::uvec2& begin, glm::uvec2& end)
+{
+	begin = dst * srcSize / dstSize;
+	end = ((dst + 1u) * srcSize + dstSize - 1u) / dstSize;
+}
+
+struct DepthPyramidLevel
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<float> depth;
+
+	float get(uint32_t x, uint32_t y) const { return depth[y * width + x]; }
+};
+
+/// CPU reference of depth_pyramid.comp, depth is width x height floats
+inline void buildDepthPyramid(const float* depth, uint32_t width, uint32_t height, std::vector<DepthPyramidLevel>& outLevels)
+{
+	const glm::uvec2 size = getDepthPyramidSize(width, height);
+	outLevels.resize(getDepthPyramidLevels(size));
+
+	glm::uvec2 srcSize(width, height);
+	const float* src = depth;
+	for (uint32_t level = 0; level != outLevels.size(); level++)
+	{
+		DepthPyramidLevel& dst = outLevels[level];
+		const glm::uvec2 dstSize = getDepthPyramidLevelSize(size, level);
+		dst.width = dstSize.x;
+		dst.height = dstSize.y;
+		dst.depth.resize(size_t(dstSize.x) * dstSize.y);
+
+		for (uint32_t y = 0; y != dstSize.y; y++)
+		{
+			for (uint32_t x = 0; x != dstSize.x; x++)
+			{
+				glm::uvec2 begin, end;
+				getDepthPyramidFootprint(glm::uvec2(x, y), srcSize, dstSize, begin, end);
+
+				float farthest = 0.0f;
+				for (uint32_t sy = begin.y; sy != end.y; sy++)
+					for (uint32_t sx = begin.x; sx != end.x; sx++)
+						farthest = std::max(farthest, src[sy * srcSize.x + sx]);
+				dst.depth[y * dstSize.x + x] = farthest;
+			}
+		}
+
+		srcSize = dstSize;
+		src = dst.depth.data();
+	}
+}
+
+/// Screen rectangle of a box in UV of the depth buffer, v down like its rows, and the nearest depth of the box
+struct DepthRect
+{
+	glm::vec2 uvMin;
+	glm::vec2 uvMax;
+	float nearestDepth = 0.0f;
+};
+
+/// False when the box reaches behind the camera and has no rectangle. uvScale maps the viewport into the depth buffer,
+/// (viewWidth / width, 1) for the first of side by side views.
+inline bool getBoxDepthRect(const BoundingBox& box, const glm::mat4& viewProj, const glm::vec2& uvScale, DepthRect& out)
+{
+	glm::vec2 ndcMin(std::numeric_limits<float>::max());
+	glm::vec2 ndcMax(std::numeric_limits<float>::lowest());
+	float nearest = std::numeric_limits<float>::max();
+	for (int c = 0; c != 8; c++)
+	{
+		const glm::vec3 corner((c & 1) ? box.max_.x : box.min_.x, (c & 2) ? box.max_.y : box.min_.y, (c & 4) ? box.max_.z : box.min_.z);
+		const glm::vec4 clip = viewProj * glm::vec4(corner, 1.0f);
+		if (clip.w <= 0.0f)
+			return false;
+
+		const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		ndcMin = glm::min(ndcMin, glm::vec2(ndc));
+		ndcMax = glm::max(ndcMax, glm::vec2(ndc));
+		nearest = std::min(nearest, ndc.z);
+	}
+
+	// LVK flips the viewport, NDC y = 1 is the top row
+	out.uvMin = glm::clamp(glm::vec2(0.5f + 0.5f * ndcMin.x, 0.5f - 0.5f * ndcMax.y), glm::vec2(0.0f), glm::vec2(1.0f)) * uvScale;
+	out.uvMax = glm::clamp(glm::vec2(0.5f + 0.5f * ndcMax.x, 0.5f - 0.5f * ndcMin.y), glm::vec2(0.0f), glm::vec2(1.0f)) * uvScale;
+	out.nearestDepth = nearest;
+	return true;
+}
+
+/// Level where the rectangle spans at most two texels each way
+inline uint32_t getDepthPyramidLevel(const DepthRect& rect, const glm::uvec2& size, uint32_t numLevels)
+{
+	const glm::vec2 extent = (rect.uvMax - rect.uvMin) * glm::vec2(size);
+	const float maxExtent = std::max(extent.x, extent.y);
+	const uint32_t level = maxExtent > 1.0f ? (uint32_t)std::ceil(std::log2(maxExtent)) : 0;
+	return std::min(level, numLevels - 1);
+}
+
+/// Texels [first, last] of a level that cover the rectangle
+inline void getDepthPyramidTexels(const DepthRect& rect, const glm::uvec2& levelSize, glm::uvec2& first, glm::uvec2& last)
+{
+	const glm::vec2 size(levelSize);
+	first = glm::min(glm::uvec2(rect.uvMin * size), levelSize - 1u);
+	last = glm::min(glm::uvec2(rect.uvMax * size), levelSize - 1u);
+}
+
+/// CPU reference of the occlusion test in cull_instances.comp
+inline bool isBoxOccluded(const BoundingBox& box, const glm::mat4& viewProj, const glm::vec2& uvScale, const std::vector<DepthPyramidLevel>& levels)
+{
+	DepthRect rect;
+	if (levels.empty() || !getBoxDepthRect(box, viewProj, uvScale, rect))
+		return false;
+
+	const glm::uvec2 size(levels[0].width, levels[0].height);
+	const uint32_t level = getDepthPyramidLevel(rect, size, (uint32_t)levels.size());
+	glm::uvec2 first, last;
+	getDepthPyramidTexels(rect, glm::uvec2(levels[level].width, levels[level].height), first, last);
+
+	float farthest = 0.0f;
+	for (uint32_t y = first.y; y <= last.y; y++)
+		for (uint32_t x = first.x; x <= last.x; x++)
+			farthest = std::max(farthest, levels[level].get(x, y));
+	return rect.nearestDepth > farthest;
+}
+
+/// Push constants of depth_pyramid.comp
+struct DepthPyramidPushConstants
+{
+	glm::uvec2 srcSize;
+	glm::uvec2 dstSize;
+	uint32_t srcTexture = 0; // Depth texture for level 0, the storage view of the level before otherwise
+	uint32_t dstTexture = 0;
+	uint32_t srcIsDepth = 0;
+};
+
+/*
+	GPU depth pyramid, built from the depth texture by one dispatch per level. Every level has a storage view of its
+	own, the shaders address them by bindless index. Recreated whenever the depth texture changes size.
+*/
+class DepthPyramid
+{
+public:
+	DepthPyramid(std::unique_ptr<lvk::IContext>& ctx, lvk::ShaderModuleHandle buildShader) : ctx_(ctx.get())
+	{
+		pipeline_ = ctx->createComputePipeline({ .smComp = buildShader, .debugName = "Pipeline: depth pyramid" });
+		LVK_ASSERT(pipeline_.valid());
+	}
+
+	DepthPyramid(const DepthPyramid&) = delete;
+	DepthPyramid& operator=(const DepthPyramid&) = delete;
+
+	/// Records the build from depthTexture, outside of a render pass. The texture needs TextureUsageBits_Sampled.
+	void build(lvk::ICommandBuffer& buff, lvk::TextureHandle depthTexture)
+	{
+		const lvk::Dimensions depthSize = ctx_->getDimensions(depthTexture);
+		resize(depthSize.width, depthSize.height);
+
+		buff.cmdBindComputePipeline(pipeline_);
+		glm::uvec2 srcSize(depthSize.width, depthSize.height);
+		for (uint32_t level = 0; level != levels_.size(); level++)
+		{
+			const glm::uvec2 dstSize = getDepthPyramidLevelSize(size_, level);
+			const DepthPyramidPushConstants pc{
+				.srcSize = srcSize,
+				.dstSize = dstSize,
+				.srcTexture = level ? levels_[level - 1].index() : depthTexture.index(),
+				.dstTexture = levels_[level].index(),
+				.srcIsDepth = level ? 0u : 1u,
+			};
+			buff.cmdPushConstants(pc);
+			// The dependency on the pyramid orders every level after the one it reads
+			buff.cmdDispatchThreadGroups(
+				{ .width = (dstSize.x + kDepthPyramidGroupSize - 1) / kDepthPyramidGroupSize, .height = (dstSize.y + kDepthPyramidGroupSize - 1) / kDepthPyramidGroupSize },
+				{ .textures = { texture_, level ? lvk::TextureHandle{} : depthTexture } });
+			srcSize = dstSize;
+		}
+	}
+
+	lvk::TextureHandle getTexture() const { return texture_; }
+	glm::uvec2 getSize() const { return size_; }
+	uint32_t getNumLevels() const { return (uint32_t)levels_.size(); }
+
+	/// Bindless index of the storage view of a level
+	uint32_t getLevelIndex(uint32_t level) const { return levels_[level].index(); }
+
+private:
+	void resize(uint32_t width, uint32_t height)
+	{
+		if (width == depthWidth_ && height == depthHeight_)
+			return;
+
+		depthWidth_ = width;
+		depthHeight_ = height;
+		size_ = getDepthPyramidSize(width, height);
+		const uint32_t numLevels = getDepthPyramidLevels(size_);
+
+		// Views before the texture they belong to
+		levels_.clear();
+		texture_ = ctx_->createTexture(
+			{ .type = lvk::TextureType_2D,
+			  .format = lvk::Format_R_F32,
+			  .dimensions = { size_.x, size_.y },
+			  .usage = lvk::TextureUsageBits_Sampled | lvk::TextureUsageBits_Storage,
+			  .numMipLevels = numLevels,
+			  .debugName = "Texture: depth pyramid" });
+		for (uint32_t level = 0; level != numLevels; level++)
+			levels_.push_back(ctx_->createTextureView(texture_, { .mipLevel = level, .numMipLevels = 1 }, "Texture: depth pyramid level"));
+	}
+
+	lvk::IContext* ctx_ = nullptr;
+	lvk::Holder<lvk::ComputePipelineHandle> pipeline_;
+	lvk::Holder<lvk::TextureHandle> texture_;
+	std::vector<lvk::Holder<lvk::TextureHandle>> levels_;
+	glm::uvec2 size_ = glm::uvec2(0);
+	uint32_t depthWidth_ = 0;
+	uint32_t depthHeight_ = 0;
+};
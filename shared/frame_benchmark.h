@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <numeric>
+#include <string>
+#include <vector>
+
+/*
+	Benchmark mode of the apps: every shading model on every mesh for a fixed number of frames. Each run replays the
+	camera path from its start with a fixed time step, so the mesh rotation and the camera are the same in every run of
+	every build. The frame times of each run are summarized and written as CSV or JSON, regressions show up as numbers.
+*/
+
+// Frames of a run before its times count, they cover pipeline warm up and the frames GPU times are read back late
+static constexpr uint32_t kBenchmarkWarmupFrames = 60;
+
+struct BenchmarkOptions
+{
+	bool enabled = false;
+	uint32_t numFrames = 240;
+	// .json for JSON, CSV otherwise
+	std::string outputFile = "benchmark_results.csv";
+};
+
+/// Frame times of one model on one mesh
+struct BenchmarkRun
+{
+	int model = 0;
+	int mesh = 0;
+	std::string modelName;
+	std::string meshName;
+	std::vector<float> cpuMs;
+	std::vector<float> gpuMs;
+	std::vector<float> frameMs;
+};
+
+struct FrameTimeSummary
+{
+	float mean = 0.0f;
+	float p50 = 0.0f;
+	float p95 = 0.0f;
+	float p99 = 0.0f;
+	float max = 0.0f;
+};
+
+/// Mean, nearest rank percentiles and maximum
+inline FrameTimeSummary summarizeFrameTimes(std::vector<float> ms)
+{
+	if (ms.empty())
+		return {};
+
+	std::sort(ms.begin(), ms.end());
+	const size_t n = ms.size();
+	auto rank = [&](float p) { return ms[std::clamp((size_t)std::ceil(p * (float)n), (size_t)1, n) - 1]; };
+	return {
+		.mean = float(std::accumulate(ms.begin(), ms.end(), 0.0) / double(n)),
+		.p50 = rank(0.50f),
+		.p95 = rank(0.95f),
+		.p99 = rank(0.99f),
+		.max = ms.back(),
+	};
+}
+
+inline bool writeBenchmarkResults(const std::filesystem::path& file, const std::vector<BenchmarkRun>& runs)
+{
+	FILE* out = fopen(file.string().c_str(), "w");
+	if (!out)
+		return false;
+
+	const bool json = file.extension() == ".json";
+	if (json)
+		fprintf(out, "{\"runs\":[");
+	else
+		fprintf(out, "model,mesh,frames,cpu_mean_ms,cpu_p50_ms,cpu_p95_ms,cpu_p99_ms,gpu_mean_ms,gpu_p50_ms,gpu_p95_ms,gpu_p99_ms,frame_mean_ms,frame_p99_ms,frame_max_ms\n");
+
+	for (size_t i = 0; i != runs.size(); i++)
+	{
+		const BenchmarkRun& run = runs[i];
+		const FrameTimeSummary cpu = summarizeFrameTimes(run.cpuMs);
+		const FrameTimeSummary gpu = summarizeFrameTimes(run.gpuMs);
+		const FrameTimeSummary frame = summarizeFrameTimes(run.frameMs);
+		if (json)
+		{
+			auto writeSummary = [out](const char* name, const FrameTimeSummary& s)
+			{
+				fprintf(out, ",\"%s\":{\"mean\":%.4f,\"p50\":%.4f,\"p95\":%.4f,\"p99\":%.4f,\"max\":%.4f}", name, s.mean, s.p50, s.p95, s.p99, s.max);
+			};
+			fprintf(out, "%s\n{\"model\":\"%s\",\"mesh\":\"%s\",\"frames\":%zu", i ? "," : "", run.modelName.c_str(), run.meshName.c_str(), run.cpuMs.size());
+			writeSummary("cpu", cpu);
+			writeSummary("gpu", gpu);
+			writeSummary("frame", frame);
+			fprintf(out, "}");
+		}
+		else
+		{
+			fprintf(out, "%s,%s,%zu,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n", run.modelName.c_str(), run.meshName.c_str(), run.cpuMs.size(), cpu.mean,
+				cpu.p50, cpu.p95, cpu.p99, gpu.mean, gpu.p50, gpu.p95, gpu.p99, frame.mean, frame.p99, frame.max);
+		}
+	}
+
+	if (json)
+		fprintf(out, "\n]}\n");
+	return fclose(out) == 0;
+}
@@ -0,0 +1,398 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <lvk/LVK.h>
+
+/*
+	Frame profiler: GPU timestamps around the debug label scopes of the frame and CPU timers around parts of recording.
+	A scope is known by its path, the names of the scopes it is nested in joined with '/', and a scope that runs more
+	than once in a frame adds up. Every scope keeps its times of the last kProfilerHistory frames for percentiles.
+
+	The GPU results of a frame are read back when its slot comes around again, by then its submit has finished and
+	reading the queries does not stall. A trace of a number of frames can be written as Chrome trace JSON, for
+	chrome://tracing or Perfetto. CPU and GPU clocks are not calibrated against each other, the GPU events of a frame
+	start at its submit on the CPU timeline.
+*/
+
+// Frames the percentiles of a scope are taken over
+static constexpr uint32_t kProfilerHistory = 256;
+
+// Timed GPU scopes per frame, the scopes after them still get their debug label
+static constexpr uint32_t kMaxProfilerGpuScopes = 64;
+
+// Frames a trace started from the UI covers
+static constexpr uint32_t kProfilerTraceFrames = 120;
+
+struct ProfilerPercentiles
+{
+	float p50 = 0.0f;
+	float p95 = 0.0f;
+	float p99 = 0.0f;
+};
+
+/// Rolling window of the per-frame times of one scope
+struct ProfilerStat
+{
+	std::string path;
+	// Last part of the path and how deep the scope is nested
+	std::string name;
+	uint32_t depth = 0;
+	bool gpu = false;
+
+	float samples[kProfilerHistory] = {};
+	uint32_t numAdded = 0;
+	float lastMs = 0.0f;
+	// Sum of the current frame so far
+	float frameMs = 0.0f;
+	bool inFrame = false;
+
+	void add(float ms)
+	{
+		samples[numAdded % kProfilerHistory] = ms;
+		numAdded++;
+		lastMs = ms;
+	}
+
+	uint32_t getNumSamples() const { return std::min(numAdded, kProfilerHistory); }
+
+	/// Index of the oldest sample, for ImGui::PlotLines
+	uint32_t getOldestSample() const { return numAdded > kProfilerHistory ? numAdded % kProfilerHistory : 0; }
+
+	/// Nearest rank percentiles of the window
+	ProfilerPercentiles getPercentiles() const
+	{
+		const uint32_t n = getNumSamples();
+		if (!n)
+			return {};
+
+		// Each selection leaves the larger samples after it, the next one only looks at those
+		float window[kProfilerHistory];
+		std::copy(samples, samples + n, window);
+		float* begin = window;
+		auto select = [&](float p)
+		{
+			float* nth = window + std::clamp((uint32_t)std::ceil(p * (float)n), 1u, n) - 1;
+			std::nth_element(begin, nth, window + n);
+			begin = nth;
+			return *nth;
+		};
+		const float p50 = select(0.50f);
+		const float p95 = select(0.95f);
+		return { p50, p95, select(0.99f) };
+	}
+};
+
+/// One scope of a traced frame, in microseconds since the profiler was created
+struct ProfilerTraceEvent
+{
+	uint32_t stat = 0;
+	double startUs = 0.0;
+	double durationUs = 0.0;
+};
+
+/// Chrome trace JSON of events, CPU scopes on one track and GPU scopes on another
+inline bool writeChromeTrace(const std::filesystem::path& file, const std::vector<ProfilerStat>& stats, const std::vector<ProfilerTraceEvent>& events)
+{
+	FILE* out = fopen(file.string().c_str(), "w");
+	if (!out)
+		return false;
+
+	fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+	fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+	for (const ProfilerTraceEvent& event : events)
+	{
+		const ProfilerStat& stat = stats[event.stat];
+		fprintf(out, ",\n{\"name\":\"");
+		for (char c : stat.name)
+		{
+			if (c == '"' || c == '\\')
+				fputc('\\', out);
+			fputc(c, out);
+		}
+		fprintf(out, "\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}", stat.gpu ? "gpu" : "cpu", event.startUs,
+			event.durationUs, stat.gpu ? 2 : 1);
+	}
+	fprintf(out, "\n]}\n");
+	return fclose(out) == 0;
+}
+
+class FrameProfiler
+{
+public:
+	FrameProfiler(std::unique_ptr<lvk::IContext>& ctx, uint32_t numFrames) : ctx_(ctx.get()), frames_(numFrames), startTime_(std::chrono::steady_clock::now())
+	{
+		queryPool_ = ctx->createQueryPool(2 * kMaxProfilerGpuScopes * numFrames, "Query pool: frame profiler", nullptr);
+		frameStat_ = getStat("Frame", "Frame", 0, true);
+		frameIntervalStat_ = getStat("Frame interval", "Frame interval", 0, false);
+	}
+
+	FrameProfiler(const FrameProfiler&) = delete;
+	FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+	/// Starts the frame and its GPU scope, outside of a render pass
+	void begin(lvk::ICommandBuffer& buff)
+	{
+		// The CPU scopes of the last frame are complete now
+		const double nowUs = getMicroseconds();
+		if (lastBeginUs_ > 0.0)
+			addFrameTime(frameIntervalStat_, float((nowUs - lastBeginUs_) * 0.001));
+		lastBeginUs_ = nowUs;
+		addFrameSamples(false);
+
+		frame_ = (frame_ + 1) % (uint32_t)frames_.size();
+		readResults(frames_[frame_], frame_);
+		writeFinishedTrace();
+
+		frames_[frame_].scopes.clear();
+		buff.cmdResetQueryPool(queryPool_, getFirstQuery(frame_), 2 * kMaxProfilerGpuScopes);
+		pushGpuScope(buff, "Frame");
+	}
+
+	/// Ends the GPU scope of the frame, outside of a render pass
+	void end(lvk::ICommandBuffer& buff) { popGpuScope(buff); }
+
+	void endFrame(lvk::SubmitHandle submit)
+	{
+		FrameSlot& slot = frames_[frame_];
+		slot.submit = submit;
+		slot.submitUs = getMicroseconds();
+		slot.pending = true;
+		slot.traced = traceFramesLeft_ > 0;
+		if (slot.traced)
+			traceFramesLeft_--;
+	}
+
+	/// Debug label and timestamps around the commands until popGpuScope()
+	void pushGpuScope(lvk::ICommandBuffer& buff, const char* name, uint32_t color = 0xff0000ff)
+	{
+		buff.cmdPushDebugGroupLabel(name, color);
+
+		FrameSlot& slot = frames_[frame_];
+		if (slot.scopes.size() == kMaxProfilerGpuScopes)
+		{
+			gpuStack_.push_back(~0u);
+			return;
+		}
+
+		const uint32_t parent = gpuStack_.empty() || gpuStack_.back() == ~0u ? ~0u : slot.scopes[gpuStack_.back()].stat;
+		const uint32_t query = (uint32_t)slot.scopes.size();
+		slot.scopes.push_back({ getChildStat(parent, name, true) });
+		gpuStack_.push_back(query);
+		buff.cmdWriteTimestamp(queryPool_, getFirstQuery(frame_) + 2 * query);
+	}
+
+	void popGpuScope(lvk::ICommandBuffer& buff)
+	{
+		LVK_ASSERT(!gpuStack_.empty());
+		const uint32_t query = gpuStack_.back();
+		gpuStack_.pop_back();
+		if (query != ~0u)
+			buff.cmdWriteTimestamp(queryPool_, getFirstQuery(frame_) + 2 * query + 1);
+		buff.cmdPopDebugGroupLabel();
+	}
+
+	void pushCpuScope(const char* name)
+	{
+		const uint32_t parent = cpuStack_.empty() ? ~0u : cpuStack_.back().stat;
+		cpuStack_.push_back({ getChildStat(parent, name, false), getMicroseconds() });
+	}
+
+	void popCpuScope()
+	{
+		LVK_ASSERT(!cpuStack_.empty());
+		const CpuScope scope = cpuStack_.back();
+		cpuStack_.pop_back();
+
+		const double endUs = getMicroseconds();
+		addFrameTime(scope.stat, float((endUs - scope.startUs) * 0.001));
+		if (traceFramesLeft_ > 0)
+			traceEvents_.push_back({ scope.stat, scope.startUs, endUs - scope.startUs });
+	}
+
+	/// Records the next numFrames frames and writes them to file once their GPU times are in
+	void startTrace(const std::filesystem::path& file, uint32_t numFrames)
+	{
+		traceFile_ = file;
+		traceFramesLeft_ = numFrames;
+		traceEvents_.clear();
+	}
+
+	bool isTracing() const { return !traceFile_.empty(); }
+
+	/// Waits for the frames in flight, reads their GPU times and writes a trace that is still being recorded
+	void finish()
+	{
+		addFrameSamples(false);
+		for (uint32_t i = 0; i != frames_.size(); i++)
+			readResults(frames_[i], i);
+		traceFramesLeft_ = 0;
+		writeFinishedTrace();
+	}
+
+	/// Scopes in the order they first ran
+	const std::vector<ProfilerStat>& getStats() const { return stats_; }
+	const ProfilerStat& getFrameIntervalStat() const { return stats_[frameIntervalStat_]; }
+
+	/// GPU time of the newest frame that finished
+	float getFrameGpuMs() const { return stats_[frameStat_].lastMs; }
+
+private:
+	struct GpuScope
+	{
+		uint32_t stat = 0;
+	};
+
+	struct CpuScope
+	{
+		uint32_t stat = 0;
+		double startUs = 0.0;
+	};
+
+	struct FrameSlot
+	{
+		std::vector<GpuScope> scopes;
+		lvk::SubmitHandle submit;
+		double submitUs = 0.0;
+		bool pending = false;
+		bool traced = false;
+	};
+
+	static uint32_t getFirstQuery(uint32_t frame) { return 2 * kMaxProfilerGpuScopes * frame; }
+
+	double getMicroseconds() const { return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime_).count(); }
+
+	uint32_t getStat(const std::string& path, const char* name, uint32_t depth, bool gpu)
+	{
+		std::unordered_map<std::string, uint32_t>& indices = gpu ? gpuStatIndices_ : cpuStatIndices_;
+		const auto it = indices.find(path);
+		if (it != indices.end())
+			return it->second;
+
+		ProfilerStat& stat = stats_.emplace_back();
+		stat.path = path;
+		stat.name = name;
+		stat.depth = depth;
+		stat.gpu = gpu;
+		indices.emplace(path, (uint32_t)stats_.size() - 1);
+		return (uint32_t)stats_.size() - 1;
+	}
+
+	uint32_t getChildStat(uint32_t parent, const char* name, bool gpu)
+	{
+		if (parent == ~0u)
+			return getStat(name, name, 0, gpu);
+		return getStat(stats_[parent].path + "/" + name, name, stats_[parent].depth + 1, gpu);
+	}
+
+	void addFrameTime(uint32_t stat, float ms)
+	{
+		stats_[stat].frameMs += ms;
+		stats_[stat].inFrame = true;
+	}
+
+	/// One sample per scope that ran, the sum of its times
+	void addFrameSamples(bool gpu)
+	{
+		for (ProfilerStat& stat : stats_)
+		{
+			if (stat.gpu != gpu || !stat.inFrame)
+				continue;
+			stat.add(stat.frameMs);
+			stat.frameMs = 0.0f;
+			stat.inFrame = false;
+		}
+	}
+
+	void readResults(FrameSlot& slot, uint32_t frame)
+	{
+		if (!slot.pending)
+			return;
+
+		// An empty handle would wait for the whole device
+		if (!slot.submit.empty())
+			ctx_->wait(slot.submit);
+		slot.pending = false;
+
+		const uint32_t numQueries = 2 * (uint32_t)slot.scopes.size();
+		timestamps_.resize(numQueries);
+		if (!numQueries || !ctx_->getQueryPoolResults(queryPool_, getFirstQuery(frame), numQueries, numQueries * sizeof(uint64_t), timestamps_.data(), sizeof(uint64_t)))
+			return;
+
+		const double periodMs = ctx_->getTimestampPeriodToMs();
+		for (uint32_t i = 0; i != slot.scopes.size(); i++)
+		{
+			const double ms = double(timestamps_[2 * i + 1] - timestamps_[2 * i]) * periodMs;
+			addFrameTime(slot.scopes[i].stat, float(ms));
+			if (slot.traced)
+			{
+				// Scope 0 is the frame
+				const double startUs = slot.submitUs + double(timestamps_[2 * i] - timestamps_[0]) * periodMs * 1000.0;
+				traceEvents_.push_back({ slot.scopes[i].stat, startUs, ms * 1000.0 });
+			}
+		}
+		slot.traced = false;
+		addFrameSamples(true);
+	}
+
+	void writeFinishedTrace()
+	{
+		if (traceFile_.empty() || traceFramesLeft_ > 0)
+			return;
+		for (const FrameSlot& slot : frames_)
+			if (slot.pending && slot.traced)
+				return;
+
+		if (writeChromeTrace(traceFile_, stats_, traceEvents_))
+			LLOGL("Wrote %zu profiler events to %s\n", traceEvents_.size(), traceFile_.string().c_str());
+		else
+			LLOGW("Could not write %s\n", traceFile_.string().c_str());
+		traceFile_.clear();
+		traceEvents_.clear();
+	}
+
+	lvk::IContext* ctx_ = nullptr;
+	lvk::Holder<lvk::QueryPoolHandle> queryPool_;
+	std::vector<FrameSlot> frames_;
+	uint32_t frame_ = 0;
+	std::vector<uint64_t> timestamps_;
+	std::chrono::steady_clock::time_point startTime_;
+	double lastBeginUs_ = 0.0;
+
+	std::vector<ProfilerStat> stats_;
+	std::unordered_map<std::string, uint32_t> gpuStatIndices_;
+	std::unordered_map<std::string, uint32_t> cpuStatIndices_;
+	uint32_t frameStat_ = 0;
+	uint32_t frameIntervalStat_ = 0;
+	// Open scopes, a GPU scope past kMaxProfilerGpuScopes is ~0u
+	std::vector<uint32_t> gpuStack_;
+	std::vector<CpuScope> cpuStack_;
+
+	std::filesystem::path traceFile_;
+	uint32_t traceFramesLeft_ = 0;
+	std::vector<ProfilerTraceEvent> traceEvents_;
+};
+
+/// Times the CPU work until the end of the enclosing block
+class ProfilerCpuScope
+{
+public:
+	ProfilerCpuScope(FrameProfiler& profiler, const char* name) : profiler_(profiler) { profiler.pushCpuScope(name); }
+	~ProfilerCpuScope() { profiler_.popCpuScope(); }
+
+	ProfilerCpuScope(const ProfilerCpuScope&) = delete;
+	ProfilerCpuScope& operator=(const ProfilerCpuScope&) = delete;
+
+private:
+	FrameProfiler& profiler_;
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <lvk/LVK.h>
+
+/// Slice of the current frame's region, ptr is persistently mapped and gpuAddress can go into push constants
+struct FrameAllocation
+{
+	uint8_t* ptr = nullptr;
+	uint64_t gpuAddress = 0;
+	size_t offset = 0;
+	size_t size = 0;
+};
+
+/*
+	Bump allocator over one host visible, persistently mapped buffer split into a region per frame in flight.
+	Per-frame data is written straight into the mapping, so there is no cmdUpdateBuffer copy and no transfer barrier
+	in the command buffer, and the GPU can still read the previous frames while the CPU fills the next region.
+	A region is reused only after the submit that last read it has finished.
+*/
+class FrameRingAllocator
+{
+public:
+	FrameRingAllocator(std::unique_ptr<lvk::IContext>& ctx, size_t frameSize, uint32_t numFrames, const char* debugName = "Buffer: frame ring")
+		: ctx_(ctx.get()), frameSize_(alignSize(frameSize, kMaxAlignment)), submits_(numFrames)
+	{
+		buffer_ = ctx->createBuffer(
+			{ .usage = lvk::BufferUsageBits_Uniform | lvk::BufferUsageBits_Storage,
+			  .storage = lvk::StorageType_HostVisible,
+			  .size = frameSize_ * numFrames,
+			  .debugName = debugName },
+			nullptr);
+		mapped_ = ctx->getMappedPtr(buffer_);
+		LVK_ASSERT(mapped_);
+	}
+
+	FrameRingAllocator(const FrameRingAllocator&) = delete;
+	FrameRingAllocator& operator=(const FrameRingAllocator&) = delete;
+
+	/// Moves on to the next region, waits for the GPU only if it still reads it from numFrames submits ago
+	void beginFrame()
+	{
+		frame_ = (frame_ + 1) % (uint32_t)submits_.size();
+		// An empty handle would wait for the whole device
+		if (!submits_[frame_].empty())
+			ctx_->wait(submits_[frame_]);
+		submits_[frame_] = {};
+		used_ = 0;
+	}
+
+	/// Space in the current region, alignment is at most kMaxAlignment. The region has to be large enough for a frame.
+	FrameAllocation allocate(size_t size, size_t alignment = 16)
+	{
+		const size_t begin = alignSize(used_, alignment);
+		LVK_ASSERT_MSG(begin + size <= frameSize_, "Frame ring region is too small for this frame");
+		if (begin + size > frameSize_)
+			return {};
+
+		used_ = begin + size;
+		const size_t offset = frame_ * frameSize_ + begin;
+		return { mapped_ + offset, ctx_->gpuAddress(buffer_, offset), offset, size };
+	}
+
+	/// Copies data into the current region and returns its GPU address
+	template<typename T>
+	uint64_t push(const T& data)
+	{
+		const FrameAllocation allocation = allocate(sizeof(T));
+		if (allocation.ptr)
+			memcpy(allocation.ptr, &data, sizeof(T));
+		return allocation.gpuAddress;
+	}
+
+	/// Call before submitting, makes the writes of this frame visible to the GPU on non coherent memory
+	void flush()
+	{
+		if (used_)
+			ctx_->flushMappedMemory(buffer_, frame_ * frameSize_, used_);
+	}
+
+	/// The region of this frame stays untouched until submit has finished
+	void endFrame(lvk::SubmitHandle submit) { submits_[frame_] = submit; }
+
+	lvk::BufferHandle getBuffer() const { return buffer_; }
+	size_t getFrameSize() const { return frameSize_; }
+	size_t getUsedSize() const { return used_; }
+
+	// Largest alignment allocate() supports, every region starts at a multiple of it
+	static constexpr size_t kMaxAlignment = 256;
+
+private:
+	static size_t alignSize(size_t size, size_t alignment) { return (size + alignment - 1) & ~(alignment - 1); }
+
+	lvk::IContext* ctx_ = nullptr;
+	lvk::Holder<lvk::BufferHandle> buffer_;
+	uint8_t* mapped_ = nullptr;
+	size_t frameSize_ = 0;
+	size_t used_ = 0;
+	uint32_t frame_ = 0;
+	std::vector<lvk::SubmitHandle> submits_;
+};
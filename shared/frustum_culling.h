@@ -0,0 +1,266 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "utils_math.h"
+#include "utils_parallel.h"
+#include "utils_simd.h"
+
+/*
+	Frustum culling of many boxes at once. The boxes are stored as a structure of arrays, so one SIMD register holds a
+	coordinate of 4 (SSE2), 8 (AVX2) or 16 (AVX-512) neighbouring boxes, and the instruction set is picked at run time.
+	The result is the same as isBoxInFrustum() box by box, including its rounding:
+	- All 8 corners are behind a plane exactly when the corner furthest along the plane normal is, and the sign of the
+	  normal picks that corner for every lane at once. Its dot product is summed in the order of glm::dot().
+	- All 8 frustum corners are on one side of the box exactly when their minimum or maximum is.
+*/
+
+/// Boxes as a structure of arrays
+struct BoundingBoxSoA
+{
+	std::vector<float> minX, minY, minZ;
+	std::vector<float> maxX, maxY, maxZ;
+
+	size_t size() const { return minX.size(); }
+
+	void resize(size_t size)
+	{
+		for (std::vector<float>* v : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ })
+			v->resize(size);
+	}
+
+	void set(size_t i, const BoundingBox& box)
+	{
+		minX[i] = box.min_.x;
+		minY[i] = box.min_.y;
+		minZ[i] = box.min_.z;
+		maxX[i] = box.max_.x;
+		maxY[i] = box.max_.y;
+		maxZ[i] = box.max_.z;
+	}
+
+	BoundingBox get(size_t i) const
+	{
+		BoundingBox box;
+		box.min_ = glm::vec3(minX[i], minY[i], minZ[i]);
+		box.max_ = glm::vec3(maxX[i], maxY[i], maxZ[i]);
+		return box;
+	}
+};
+
+/// Planes and corners of a view projection, the corner bounds replace the 48 corner comparisons of isBoxInFrustum()
+struct BoxCullFrustum
+{
+	glm::vec4 planes[6];
+	glm::vec4 corners[8];
+	glm::vec3 cornersMin;
+	glm::vec3 cornersMax;
+};
+
+inline BoxCullFrustum getBoxCullFrustum(const glm::mat4& viewProj)
+{
+	BoxCullFrustum frustum;
+	getFrustumPlanes(viewProj, frustum.planes);
+	getFrustumCorners(viewProj, frustum.corners);
+
+	frustum.cornersMin = glm::vec3(frustum.corners[0]);
+	frustum.cornersMax = glm::vec3(frustum.corners[0]);
+	for (int i = 1; i != 8; i++)
+	{
+		frustum.cornersMin = glm::min(frustum.cornersMin, glm::vec3(frustum.corners[i]));
+		frustum.cornersMax = glm::max(frustum.cornersMax, glm::vec3(frustum.corners[i]));
+	}
+	return frustum;
+}
+
+// Boxes per task of cullBoxesParallel(), a multiple of 64 so no two tasks write the same mask word
+static constexpr uint32_t kBoxCullChunkSize = 16384;
+
+/// 64 bit words of a visibility mask, bit i % 64 of word i / 64 is box i
+inline size_t getBoxCullMaskWords(size_t numBoxes)
+{
+	return (numBoxes + 63) / 64;
+}
+
+namespace boxcull
+{
+	/// Boxes [begin, end) with isBoxInFrustum(), the mask bits have to be clear
+	inline void cullScalar(const BoxCullFrustum& frustum, const BoundingBoxSoA& boxes, uint32_t begin, uint32_t end, uint64_t* outMask)
+	{
+		glm::vec4 planes[6];
+		glm::vec4 corners[8];
+		std::copy(frustum.planes, frustum.planes + 6, planes);
+		std::copy(frustum.corners, frustum.corners + 8, corners);
+
+		for (uint32_t i = begin; i != end; i++)
+		{
+			if (isBoxInFrustum(planes, corners, boxes.get(i)))
+				outMask[i >> 6] |= uint64_t(1) << (i & 63);
+		}
+	}
+
+#if defined(SIMD_SSE2)
+	inline void cullSSE2(const BoxCullFrustum& frustum, const BoundingBoxSoA& boxes, uint32_t begin, uint32_t end, uint64_t* outMask)
+	{
+		const __m128 zero = _mm_setzero_ps();
+
+		uint32_t i = begin;
+		for (; i + 4 <= end; i += 4)
+		{
+			const __m128 minX = _mm_loadu_ps(boxes.minX.data() + i);
+			const __m128 minY = _mm_loadu_ps(boxes.minY.data() + i);
+			const __m128 minZ = _mm_loadu_ps(boxes.minZ.data() + i);
+			const __m128 maxX = _mm_loadu_ps(boxes.maxX.data() + i);
+			const __m128 maxY = _mm_loadu_ps(boxes.maxY.data() + i);
+			const __m128 maxZ = _mm_loadu_ps(boxes.maxZ.data() + i);
+
+			// Lanes that are culled
+			__m128 outside = _mm_setzero_ps();
+			for (const glm::vec4& plane : frustum.planes)
+			{
+				const __m128 x = _mm_mul_ps(_mm_set1_ps(plane.x), plane.x > 0.0f ? maxX : minX);
+				const __m128 y = _mm_mul_ps(_mm_set1_ps(plane.y), plane.y > 0.0f ? maxY : minY);
+				const __m128 z = _mm_mul_ps(_mm_set1_ps(plane.z), plane.z > 0.0f ? maxZ : minZ);
+				const __m128 d = _mm_add_ps(_mm_add_ps(x, y), _mm_add_ps(z, _mm_set1_ps(plane.w)));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(d, zero));
+			}
+			outside = _mm_or_ps(outside, _mm_cmpgt_ps(_mm_set1_ps(frustum.cornersMin.x), maxX));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_set1_ps(frustum.cornersMax.x), minX));
+			outside = _mm_or_ps(outside, _mm_cmpgt_ps(_mm_set1_ps(frustum.cornersMin.y), maxY));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_set1_ps(frustum.cornersMax.y), minY));
+			outside = _mm_or_ps(outside, _mm_cmpgt_ps(_mm_set1_ps(frustum.cornersMin.z), maxZ));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_set1_ps(frustum.cornersMax.z), minZ));
+
+			const uint64_t visible = uint64_t(~_mm_movemask_ps(outside) & 0xf);
+			outMask[i >> 6] |= visible << (i & 63);
+		}
+		cullScalar(frustum, boxes, i, end, outMask);
+	}
+
+	SIMD_TARGET("avx2")
+	inline void cullAVX2(const BoxCullFrustum& frustum, const BoundingBoxSoA& boxes, uint32_t begin, uint32_t end, uint64_t* outMask)
+	{
+		const __m256 zero = _mm256_setzero_ps();
+
+		uint32_t i = begin;
+		for (; i + 8 <= end; i += 8)
+		{
+			const __m256 minX = _mm256_loadu_ps(boxes.minX.data() + i);
+			const __m256 minY = _mm256_loadu_ps(boxes.minY.data() + i);
+			const __m256 minZ = _mm256_loadu_ps(boxes.minZ.data() + i);
+			const __m256 maxX = _mm256_loadu_ps(boxes.maxX.data() + i);
+			const __m256 maxY = _mm256_loadu_ps(boxes.maxY.data() + i);
+			const __m256 maxZ = _mm256_loadu_ps(boxes.maxZ.data() + i);
+
+			__m256 outside = _mm256_setzero_ps();
+			for (const glm::vec4& plane : frustum.planes)
+			{
+				const __m256 x = _mm256_mul_ps(_mm256_set1_ps(plane.x), plane.x > 0.0f ? maxX : minX);
+				const __m256 y = _mm256_mul_ps(_mm256_set1_ps(plane.y), plane.y > 0.0f ? maxY : minY);
+				const __m256 z = _mm256_mul_ps(_mm256_set1_ps(plane.z), plane.z > 0.0f ? maxZ : minZ);
+				const __m256 d = _mm256_add_ps(_mm256_add_ps(x, y), _mm256_add_ps(z, _mm256_set1_ps(plane.w)));
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, zero, _CMP_LT_OQ));
+			}
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_set1_ps(frustum.cornersMin.x), maxX, _CMP_GT_OQ));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_set1_ps(frustum.cornersMax.x), minX, _CMP_LT_OQ));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_set1_ps(frustum.cornersMin.y), maxY, _CMP_GT_OQ));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_set1_ps(frustum.cornersMax.y), minY, _CMP_LT_OQ));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_set1_ps(frustum.cornersMin.z), maxZ, _CMP_GT_OQ));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_set1_ps(frustum.cornersMax.z), minZ, _CMP_LT_OQ));
+
+			const uint64_t visible = uint64_t(~_mm256_movemask_ps(outside) & 0xff);
+			outMask[i >> 6] |= visible << (i & 63);
+		}
+		cullScalar(frustum, boxes, i, end, outMask);
+	}
+
+	SIMD_TARGET("avx512f")
+	inline void cullAVX512(const BoxCullFrustum& frustum, const BoundingBoxSoA& boxes, uint32_t begin, uint32_t end, uint64_t* outMask)
+	{
+		const __m512 zero = _mm512_setzero_ps();
+
+		uint32_t i = begin;
+		for (; i + 16 <= end; i += 16)
+		{
+			const __m512 minX = _mm512_loadu_ps(boxes.minX.data() + i);
+			const __m512 minY = _mm512_loadu_ps(boxes.minY.data() + i);
+			const __m512 minZ = _mm512_loadu_ps(boxes.minZ.data() + i);
+			const __m512 maxX = _mm512_loadu_ps(boxes.maxX.data() + i);
+			const __m512 maxY = _mm512_loadu_ps(boxes.maxY.data() + i);
+			const __m512 maxZ = _mm512_loadu_ps(boxes.maxZ.data() + i);
+
+			__mmask16 outside = 0;
+			for (const glm::vec4& plane : frustum.planes)
+			{
+				const __m512 x = _mm512_mul_ps(_mm512_set1_ps(plane.x), plane.x > 0.0f ? maxX : minX);
+				const __m512 y = _mm512_mul_ps(_mm512_set1_ps(plane.y), plane.y > 0.0f ? maxY : minY);
+				const __m512 z = _mm512_mul_ps(_mm512_set1_ps(plane.z), plane.z > 0.0f ? maxZ : minZ);
+				const __m512 d = _mm512_add_ps(_mm512_add_ps(x, y), _mm512_add_ps(z, _mm512_set1_ps(plane.w)));
+				outside |= _mm512_cmp_ps_mask(d, zero, _CMP_LT_OQ);
+			}
+			outside |= _mm512_cmp_ps_mask(_mm512_set1_ps(frustum.cornersMin.x), maxX, _CMP_GT_OQ);
+			outside |= _mm512_cmp_ps_mask(_mm512_set1_ps(frustum.cornersMax.x), minX, _CMP_LT_OQ);
+			outside |= _mm512_cmp_ps_mask(_mm512_set1_ps(frustum.cornersMin.y), maxY, _CMP_GT_OQ);
+			outside |= _mm512_cmp_ps_mask(_mm512_set1_ps(frustum.cornersMax.y), minY, _CMP_LT_OQ);
+			outside |= _mm512_cmp_ps_mask(_mm512_set1_ps(frustum.cornersMin.z), maxZ, _CMP_GT_OQ);
+			outside |= _mm512_cmp_ps_mask(_mm512_set1_ps(frustum.cornersMax.z), minZ, _CMP_LT_OQ);
+
+			const uint64_t visible = uint64_t(~outside & 0xffff);
+			outMask[i >> 6] |= visible << (i & 63);
+		}
+		cullScalar(frustum, boxes, i, end, outMask);
+	}
+#endif // SIMD_SSE2
+
+	/// Boxes [begin, end) at level, begin is a multiple of 64
+	inline void cullRange(const BoxCullFrustum& frustum, const BoundingBoxSoA& boxes, uint32_t begin, uint32_t end, uint64_t* outMask, simd::Level level)
+	{
+		std::fill(outMask + begin / 64, outMask + getBoxCullMaskWords(end), uint64_t(0));
+
+		switch (level)
+		{
+#if defined(SIMD_SSE2)
+		case simd::Level_AVX512: cullAVX512(frustum, boxes, begin, end, outMask); break;
+		case simd::Level_AVX2: cullAVX2(frustum, boxes, begin, end, outMask); break;
+		case simd::Level_SSE2: cullSSE2(frustum, boxes, begin, end, outMask); break;
+#endif
+		default: cullScalar(frustum, boxes, begin, end, outMask); break;
+		}
+	}
+} // namespace boxcull
+
+/// Visibility mask of every box, outMask has getBoxCullMaskWords() words. level has to be at most simd::getLevel().
+inline void cullBoxes(const BoxCullFrustum& frustum, const BoundingBoxSoA& boxes, uint64_t* outMask, simd::Level level = simd::getLevel())
+{
+	boxcull::cullRange(frustum, boxes, 0, (uint32_t)boxes.size(), outMask, level);
+}
+
+/// cullBoxes() in chunks of kBoxCullChunkSize boxes on the thread pool
+inline void cullBoxesParallel(const BoxCullFrustum& frustum, const BoundingBoxSoA& boxes, uint64_t* outMask, simd::Level level = simd::getLevel())
+{
+	const uint32_t numBoxes = (uint32_t)boxes.size();
+	const uint32_t numChunks = (numBoxes + kBoxCullChunkSize - 1) / kBoxCullChunkSize;
+
+	getThreadPool().parallelFor(0, numChunks, [&](uint32_t chunk)
+		{
+			const uint32_t begin = chunk * kBoxCullChunkSize;
+			boxcull::cullRange(frustum, boxes, begin, std::min(begin + kBoxCullChunkSize, numBoxes), outMask, level);
+		});
+}
+
+/// Indices of the set bits of a cullBoxes() mask in increasing order, returns their count
+inline uint32_t compactVisibleBoxes(const uint64_t* mask, size_t numBoxes, std::vector<uint32_t>& outIndices)
+{
+	outIndices.clear();
+	for (size_t w = 0; w != getBoxCullMaskWords(numBoxes); w++)
+	{
+		for (uint64_t bits = mask[w]; bits; bits &= bits - 1)
+			outIndices.push_back(uint32_t(w * 64 + std::countr_zero(bits)));
+	}
+	return (uint32_t)outIndices.size();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <lvk/LVK.h>
+
+#include <stb/stb_image_write.h>
+
+/*
+	Headless runs render a fixed number of frames into an offscreen color texture instead of a swapchain, with no window
+	and without initializing GLFW, so they work on machines without a display or a GPU (lavapipe). Time advances by a
+	fixed step and the camera follows a camera path (camera_path.h), every run of a build on one driver renders the same
+	frames. The last frame can be written to a PNG or HDR file, which makes golden image comparisons possible.
+*/
+
+// Frames in flight without a swapchain to take the count from
+static constexpr uint32_t kHeadlessFramesInFlight = 3;
+
+struct HeadlessOptions
+{
+	bool enabled = false;
+	uint32_t width = 1280;
+	uint32_t height = 720;
+	uint32_t numFrames = 60;
+	// PNG or HDR file the last frame is written to, nothing is written when empty
+	std::string outputFile;
+	// Ask LVK for a software device such as lavapipe, it only falls back between discrete and integrated GPUs
+	bool softwareDevice = false;
+};
+
+inline bool isHdrImageFile(const std::filesystem::path& file)
+{
+	return file.extension() == ".hdr";
+}
+
+/// RGBA8 for PNG files, HDR files keep the full float range
+inline lvk::Format getHeadlessColorFormat(const HeadlessOptions& options)
+{
+	return isHdrImageFile(options.outputFile) ? lvk::Format_RGBA_F32 : lvk::Format_RGBA_UN8;
+}
+
+/// Reads texture back and writes it to file, texture is RGBA_UN8 for PNG files and RGBA_F32 for HDR files
+inline bool saveTextureImage(lvk::IContext& ctx, lvk::TextureHandle texture, const std::filesystem::path& file)
+{
+	const lvk::Dimensions size = ctx.getDimensions(texture);
+	const bool isHdr = isHdrImageFile(file);
+	const size_t pixelSize = isHdr ? 4 * sizeof(float) : 4;
+
+	std::vector<uint8_t> pixels(size_t(size.width) * size.height * pixelSize);
+	const lvk::Result result = ctx.download(texture, { .dimensions = { size.width, size.height, 1 } }, pixels.data());
+	if (!result.isOk())
+	{
+		LLOGW("Could not read back the frame for %s\n", file.string().c_str());
+		return false;
+	}
+
+	const std::string path = file.string();
+	const int written = isHdr
+		? stbi_write_hdr(path.c_str(), (int)size.width, (int)size.height, 4, reinterpret_cast<const float*>(pixels.data()))
+		: stbi_write_png(path.c_str(), (int)size.width, (int)size.height, 4, pixels.data(), (int)(size.width * 4));
+	if (!written)
+	{
+		LLOGW("Could not write %s\n", path.c_str());
+		return false;
+	}
+
+	LLOGL("Wrote %ux%u frame to %s\n", size.width, size.height, path.c_str());
+	return true;
+}
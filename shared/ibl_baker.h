@@ -0,0 +1,243 @@
+#pragma once
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <ktx.h>
+#include <lvk/LVK.h>
+#include <stb/stb_image.h>
+
+#include "bitmap.h"
+#include "utils_cubemap.h"
+
+// Bake settings, stored in the cached .ktx files so changing them bakes again
+static constexpr int kIrradianceFaceSize = 32;
+static constexpr int kIrradianceSamples = 2048;
+static constexpr int kSpecularFaceSize = 256;
+static constexpr int kSpecularMipLevels = 6;
+static constexpr int kSpecularSamples = 1024;
+
+// Bump when the baking code changes what it produces
+static constexpr int kIBLBakeVersion = 1;
+
+// KTX1 stores the format as an OpenGL enum, GL_RGBA32F
+static constexpr uint32_t kKtxFormatRGBA32F = 0x8814;
+
+// Key/value entry of the cached maps that holds the settings they were baked with
+static constexpr const char* kKtxBakeSettingsKey = "LVKShading.bakeSettings";
+
+inline std::string getIrradianceBakeSettings()
+{
+	return "irradiance v" + std::to_string(kIBLBakeVersion) + " size " + std::to_string(kIrradianceFaceSize) + " samples " +
+		std::to_string(kIrradianceSamples);
+}
+
+inline std::string getSpecularBakeSettings()
+{
+	return "specular v" + std::to_string(kIBLBakeVersion) + " size " + std::to_string(kSpecularFaceSize) + " mips " +
+		std::to_string(kSpecularMipLevels) + " samples " + std::to_string(kSpecularSamples);
+}
+
+/// Image based lighting maps of one environment
+struct IBLTextures
+{
+	lvk::Holder<lvk::TextureHandle> irradiance;
+	// Roughness of mip level i is i / (numSpecularMips - 1)
+	lvk::Holder<lvk::TextureHandle> prefilteredSpecular;
+	uint32_t numSpecularMips = 0;
+};
+
+/// Writes float RGBA cube map levels (largest first) and the settings they were baked with into a KTX file. The file
+/// is written under a temporary name first, so a failed write never leaves a partial cache behind.
+inline bool saveCubemapKTX(const std::filesystem::path& file, const std::vector<Bitmap>& levels, const std::string& bakeSettings)
+{
+	ktxTextureCreateInfo createInfo{};
+	createInfo.glInternalformat = kKtxFormatRGBA32F;
+	createInfo.baseWidth = (uint32_t)levels[0].w_;
+	createInfo.baseHeight = (uint32_t)levels[0].h_;
+	createInfo.baseDepth = 1u;
+	createInfo.numDimensions = 2u;
+	createInfo.numLevels = (uint32_t)levels.size();
+	createInfo.numLayers = 1u;
+	createInfo.numFaces = 6u;
+	createInfo.isArray = KTX_FALSE;
+	createInfo.generateMipmaps = KTX_FALSE;
+
+	ktxTexture1* texture = nullptr;
+	if (ktxTexture1_Create(&createInfo, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &texture) != KTX_SUCCESS)
+	{
+		LLOGW("Failed to create KTX texture for %s\n", file.string().c_str());
+		return false;
+	}
+
+	bool filled = ktxHashList_AddKVPair(&texture->kvDataHead, kKtxBakeSettingsKey, (unsigned int)bakeSettings.size() + 1, bakeSettings.c_str()) == KTX_SUCCESS;
+	for (uint32_t level = 0; level != levels.size() && filled; level++)
+	{
+		const size_t faceSize = levels[level].data_.size() / 6;
+		for (uint32_t face = 0; face != 6 && filled; face++)
+		{
+			filled = ktxTexture_SetImageFromMemory(ktxTexture(texture), level, 0, face, levels[level].data_.data() + face * faceSize, faceSize) == KTX_SUCCESS;
+		}
+	}
+
+	const std::filesystem::path tempFile = std::filesystem::path(file).concat(".tmp");
+	bool saved = filled && ktxTexture_WriteToNamedFile(ktxTexture(texture), tempFile.string().c_str()) == KTX_SUCCESS;
+	ktxTexture_Destroy(ktxTexture(texture));
+
+	std::error_code ec;
+	if (saved)
+	{
+		std::filesystem::rename(tempFile, file, ec);
+		saved = !ec;
+	}
+	if (!saved)
+	{
+		std::filesystem::remove(tempFile, ec);
+		LLOGW("Failed to write %s\n", file.string().c_str());
+	}
+
+	return saved;
+}
+
+/// Reads a float RGBA cube map written by saveCubemapKTX(), fails when it was baked with other settings
+inline bool loadCubemapKTX(const std::filesystem::path& file, const std::string& bakeSettings, std::vector<Bitmap>& outLevels)
+{
+	ktxTexture1* texture = nullptr;
+	if (ktxTexture1_CreateFromNamedFile(file.string().c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &texture) != KTX_SUCCESS)
+		return false;
+
+	if (texture->glInternalformat != kKtxFormatRGBA32F || texture->numFaces != 6)
+	{
+		LLOGW("Unexpected cube map format in %s\n", file.string().c_str());
+		ktxTexture_Destroy(ktxTexture(texture));
+		return false;
+	}
+
+	// The stored value includes the terminating zero
+	unsigned int settingsSize = 0;
+	void* settings = nullptr;
+	const bool isCurrent = ktxHashList_FindValue(&texture->kvDataHead, kKtxBakeSettingsKey, &settingsSize, &settings) == KTX_SUCCESS &&
+		settingsSize == bakeSettings.size() + 1 && memcmp(settings, bakeSettings.c_str(), settingsSize) == 0;
+	if (!isCurrent)
+	{
+		LLOGL("%s was baked with other settings\n", file.string().c_str());
+		ktxTexture_Destroy(ktxTexture(texture));
+		return false;
+	}
+
+	outLevels.clear();
+	for (uint32_t level = 0; level != texture->numLevels; level++)
+	{
+		const int size = std::max((int)texture->baseWidth >> level, 1);
+		Bitmap bitmap(size, size, 6, 4, eBitmapFormat_Float);
+		bitmap.type_ = eBitmapType_Cube;
+
+		const size_t faceSize = bitmap.data_.size() / 6;
+		for (uint32_t face = 0; face != 6; face++)
+		{
+			ktx_size_t offset = 0;
+			ktxTexture_GetImageOffset(ktxTexture(texture), level, 0, face, &offset);
+			memcpy(bitmap.data_.data() + face * faceSize, ktxTexture_GetData(ktxTexture(texture)) + offset, faceSize);
+		}
+
+		outLevels.push_back(std::move(bitmap));
+	}
+
+	ktxTexture_Destroy(ktxTexture(texture));
+	return true;
+}
+
+/// Cube texture with all levels uploaded, LVK expects the faces of each mip level next to each other
+inline lvk::Holder<lvk::TextureHandle> createCubemapTexture(std::unique_ptr<lvk::IContext>& ctx, const std::vector<Bitmap>& levels, const char* debugName)
+{
+	std::vector<uint8_t> data;
+	for (const Bitmap& level : levels)
+		data.insert(data.end(), level.data_.begin(), level.data_.end());
+
+	lvk::TextureDesc desc{};
+	desc.type = lvk::TextureType_Cube;
+	desc.format = lvk::Format_RGBA_F32;
+	desc.dimensions = { (uint32_t)levels[0].w_, (uint32_t)levels[0].h_ };
+	desc.usage = lvk::TextureUsageBits_Sampled;
+	desc.numMipLevels = (uint32_t)levels.size();
+	desc.data = data.data();
+	desc.dataNumMipLevels = (uint32_t)levels.size();
+	desc.debugName = debugName;
+
+	return ctx->createTexture(desc);
+}
+
+/// Bakes the diffuse irradiance map and the GGX prefiltered specular mip chain of an equirectangular HDR
+inline bool bakeIBL(const std::filesystem::path& hdrPath, std::vector<Bitmap>& outIrradiance, std::vector<Bitmap>& outSpecular)
+{
+	int w, h;
+	const float* img = stbi_loadf(hdrPath.string().c_str(), &w, &h, nullptr, 4);
+	if (!img)
+	{
+		LLOGW("Failed to load environment %s\n", hdrPath.string().c_str());
+		return false;
+	}
+
+	const std::vector<Bitmap> envMips = cubemap::buildEquirectangularMips(Bitmap(w, h, 4, eBitmapFormat_Float, img));
+	stbi_image_free((void*)img);
+
+	outIrradiance.clear();
+	outIrradiance.push_back(cubemap::convolveLambertian(envMips, kIrradianceFaceSize, kIrradianceSamples));
+
+	outSpecular.clear();
+	for (int level = 0; level != kSpecularMipLevels; level++)
+	{
+		const float roughness = float(level) / float(kSpecularMipLevels - 1);
+		outSpecular.push_back(cubemap::convolveGGX(envMips, std::max(kSpecularFaceSize >> level, 1), roughness, kSpecularSamples));
+	}
+
+	return true;
+}
+
+/// Irradiance and prefiltered specular maps of an equirectangular HDR. They are baked on the first run and
+/// cached as <name>_irradiance.ktx and <name>_specular.ktx next to the HDR, later runs only load the cache as long as
+/// it is newer than the HDR and was baked with the current settings.
+inline IBLTextures loadIBL(const std::filesystem::path& hdrPath, std::unique_ptr<lvk::IContext>& ctx)
+{
+	const std::filesystem::path irradiancePath = std::filesystem::path(hdrPath).replace_extension().concat("_irradiance.ktx");
+	const std::filesystem::path specularPath = std::filesystem::path(hdrPath).replace_extension().concat("_specular.ktx");
+
+	// A cache older than its HDR is stale
+	auto isCacheValid = [&hdrPath](const std::filesystem::path& cachePath)
+		{
+			std::error_code ec;
+			return std::filesystem::exists(cachePath, ec) &&
+				std::filesystem::last_write_time(cachePath, ec) >= std::filesystem::last_write_time(hdrPath, ec);
+		};
+
+	const auto start = std::chrono::steady_clock::now();
+
+	std::vector<Bitmap> irradiance;
+	std::vector<Bitmap> specular;
+
+	const bool fromCache = isCacheValid(irradiancePath) && isCacheValid(specularPath) &&
+		loadCubemapKTX(irradiancePath, getIrradianceBakeSettings(), irradiance) && loadCubemapKTX(specularPath, getSpecularBakeSettings(), specular);
+
+	if (!fromCache)
+	{
+		if (!bakeIBL(hdrPath, irradiance, specular))
+			return {};
+
+		saveCubemapKTX(irradiancePath, irradiance, getIrradianceBakeSettings());
+		saveCubemapKTX(specularPath, specular, getSpecularBakeSettings());
+	}
+
+	const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	LLOGL("IBL maps for %s %s in %.1f ms\n", hdrPath.filename().string().c_str(), fromCache ? "loaded from cache" : "baked", ms);
+
+	IBLTextures ibl;
+	ibl.irradiance = createCubemapTexture(ctx, irradiance, "Cubemap: irradiance");
+	ibl.prefilteredSpecular = createCubemapTexture(ctx, specular, "Cubemap: prefiltered specular");
+	ibl.numSpecularMips = (uint32_t)specular.size();
+
+	return ibl;
+}
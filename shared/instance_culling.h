@@ -0,0 +1,240 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <lvk/LVK.h>
+#include <glm/glm.hpp>
+
+#include "depth_pyramid.h"
+#include "frame_ring_allocator.h"
+#include "mesh_data.h"
+
+/// Transform and material of one instance of a mesh, matches Instance in instance.sp
+struct Instance
+{
+	glm::mat4 model = glm::mat4(1.0f);
+	glm::vec4 color = glm::vec4(1.0f); // Multiplies UniformData::color
+};
+
+/// VkDrawIndexedIndirectCommand
+struct DrawIndexedIndirectCommand
+{
+	uint32_t indexCount = 0;
+	uint32_t instanceCount = 0;
+	uint32_t firstIndex = 0;
+	int32_t vertexOffset = 0;
+	uint32_t firstInstance = 0;
+};
+
+/// Matches CullData in cull_instances.comp
+struct InstanceCullData
+{
+	glm::vec4 frustumPlanes[6];
+	glm::vec4 frustumCorners[8];
+	glm::vec4 boundsMin;
+	glm::vec4 boundsMax;
+	glm::mat4 pyramidViewProj = glm::mat4(1.0f);
+	glm::vec4 pyramidUvScale = glm::vec4(0.0f);
+	uint32_t pyramidLevels[kMaxDepthPyramidLevels] = {};
+	uint64_t instances = 0;
+	uint64_t visibleInstances = 0;
+	uint64_t drawCommand = 0;
+	uint64_t visibility = 0;
+	uint64_t occludedInstances = 0;
+	uint32_t numInstances = 0;
+	uint32_t numPyramidLevels = 0;
+	uint32_t phase = 0;
+};
+
+/// Depth pyramid an occlusion test reads, with the view projection it was rendered with
+struct OcclusionPyramid
+{
+	const DepthPyramid* pyramid = nullptr;
+	glm::mat4 viewProj = glm::mat4(1.0f);
+	glm::vec2 uvScale = glm::vec2(1.0f); // See getBoxDepthRect()
+};
+
+// Threads per group of cull_instances.comp
+static constexpr uint32_t kCullGroupSize = 64;
+
+/// CPU reference of cull_instances.comp, the same box per instance and the same frustum test.
+/// Visible instances are appended to outVisible in order, outVisibility (optional) gets 1 or 0 per instance.
+/// Returns the visible instance count.
+inline uint32_t cullInstances(const Instance* instances, uint32_t numInstances, const BoundingBox& bounds, const glm::mat4& viewProj,
+	Instance* outVisible, uint32_t* outVisibility = nullptr)
+{
+	glm::vec4 frustumPlanes[6];
+	glm::vec4 frustumCorners[8];
+	getFrustumPlanes(viewProj, frustumPlanes);
+	getFrustumCorners(viewProj, frustumCorners);
+
+	uint32_t numVisible = 0;
+	for (uint32_t i = 0; i != numInstances; i++)
+	{
+		const bool visible = isBoxInFrustum(frustumPlanes, frustumCorners, bounds.getTransformed(instances[i].model));
+		if (outVisibility)
+			outVisibility[i] = visible ? 1 : 0;
+		if (visible)
+			outVisible[numVisible++] = instances[i];
+	}
+	return numVisible;
+}
+
+/*
+	GPU frustum culling of the instances of one draw. A compute pass tests the box of every instance and compacts the
+	visible ones into a device buffer while it counts them into an indirect draw command, so the draw is the same
+	handful of commands whatever the instance count. The buffers are reused every frame, the dispatch and the render
+	pass list them as dependencies so LVK puts barriers between the draw of one frame and the culling of the next.
+
+	With occlusion culling cull() also tests the instances against the depth pyramid of the last frame and keeps the
+	hidden ones in a list. Once the visible ones are drawn and the pyramid is rebuilt, cullOccluded() tests that list
+	again and fills a second draw with the instances that just came into view.
+*/
+class InstanceCuller
+{
+public:
+	InstanceCuller(std::unique_ptr<lvk::IContext>& ctx, lvk::ShaderModuleHandle computeShader, uint32_t maxInstances)
+		: ctx_(ctx.get()), maxInstances_(maxInstances)
+	{
+		pipeline_ = ctx->createComputePipeline({ .smComp = computeShader, .debugName = "Pipeline: instance culling" });
+		LVK_ASSERT(pipeline_.valid());
+
+		visibleInstances_ = ctx->createBuffer(
+			{ .usage = lvk::BufferUsageBits_Storage,
+			  .storage = lvk::StorageType_Device,
+			  .size = sizeof(Instance) * maxInstances,
+			  .debugName = "Buffer: visible instances" },
+			nullptr);
+		drawCommand_ = ctx->createBuffer(
+			{ .usage = lvk::BufferUsageBits_Indirect | lvk::BufferUsageBits_Storage,
+			  .storage = lvk::StorageType_Device,
+			  .size = sizeof(DrawIndexedIndirectCommand),
+			  .debugName = "Buffer: culled draw command" },
+			nullptr);
+		// Host visible so it can be compared with cullInstances() once the frame has finished
+		visibility_ = ctx->createBuffer(
+			{ .usage = lvk::BufferUsageBits_Storage,
+			  .storage = lvk::StorageType_HostVisible,
+			  .size = sizeof(uint32_t) * maxInstances,
+			  .debugName = "Buffer: instance visibility" },
+			nullptr);
+		// Count followed by the instance indices
+		occludedInstances_ = ctx->createBuffer(
+			{ .usage = lvk::BufferUsageBits_Storage,
+			  .storage = lvk::StorageType_Device,
+			  .size = sizeof(uint32_t) * (maxInstances + 1),
+			  .debugName = "Buffer: occluded instances" },
+			nullptr);
+		lateVisibleInstances_ = ctx->createBuffer(
+			{ .usage = lvk::BufferUsageBits_Storage,
+			  .storage = lvk::StorageType_Device,
+			  .size = sizeof(Instance) * maxInstances,
+			  .debugName = "Buffer: disoccluded instances" },
+			nullptr);
+		lateDrawCommand_ = ctx->createBuffer(
+			{ .usage = lvk::BufferUsageBits_Indirect | lvk::BufferUsageBits_Storage,
+			  .storage = lvk::StorageType_Device,
+			  .size = sizeof(DrawIndexedIndirectCommand),
+			  .debugName = "Buffer: disoccluded draw command" },
+			nullptr);
+	}
+
+	InstanceCuller(const InstanceCuller&) = delete;
+	InstanceCuller& operator=(const InstanceCuller&) = delete;
+
+	/// Records the culling of numInstances instances at address instances, outside of a render pass. The draw command
+	/// draws range, cull data goes into the frame ring. Instances hidden in occlusion (optional) are not drawn and wait
+	/// for cullOccluded().
+	void cull(lvk::ICommandBuffer& buff, FrameRingAllocator& ring, uint64_t instances, uint32_t numInstances,
+		const BoundingBox& bounds, const DrawRange& range, const glm::mat4& viewProj, const OcclusionPyramid* occlusion = nullptr)
+	{
+		LVK_ASSERT(numInstances <= maxInstances_);
+
+		const DrawIndexedIndirectCommand command{ .indexCount = range.indexCount, .firstIndex = range.firstIndex };
+		const uint32_t numOccluded = 0;
+		buff.cmdUpdateBuffer(drawCommand_, 0, sizeof(command), &command);
+		buff.cmdUpdateBuffer(occludedInstances_, 0, sizeof(numOccluded), &numOccluded);
+
+		InstanceCullData cullData = getCullData(instances, numInstances, bounds, viewProj, occlusion);
+		cullData.visibleInstances = ctx_->gpuAddress(visibleInstances_);
+		cullData.drawCommand = ctx_->gpuAddress(drawCommand_);
+
+		buff.cmdBindComputePipeline(pipeline_);
+		buff.cmdPushConstants(ring.push(cullData));
+		buff.cmdDispatchThreadGroups({ .width = (numInstances + kCullGroupSize - 1) / kCullGroupSize },
+			{ .textures = { occlusion ? occlusion->pyramid->getTexture() : lvk::TextureHandle{} },
+			  .buffers = { drawCommand_, visibleInstances_, occludedInstances_ } });
+	}
+
+	/// Records the second test of the instances cull() found occluded, against a pyramid of the current frame. Takes the
+	/// same instances, bounds and range as the cull() before it.
+	void cullOccluded(lvk::ICommandBuffer& buff, FrameRingAllocator& ring, uint64_t instances, uint32_t numInstances,
+		const BoundingBox& bounds, const DrawRange& range, const OcclusionPyramid& occlusion)
+	{
+		const DrawIndexedIndirectCommand command{ .indexCount = range.indexCount, .firstIndex = range.firstIndex };
+		buff.cmdUpdateBuffer(lateDrawCommand_, 0, sizeof(command), &command);
+
+		InstanceCullData cullData = getCullData(instances, numInstances, bounds, occlusion.viewProj, &occlusion);
+		cullData.visibleInstances = ctx_->gpuAddress(lateVisibleInstances_);
+		cullData.drawCommand = ctx_->gpuAddress(lateDrawCommand_);
+		cullData.phase = 1;
+
+		// Sized for the worst case, the shader reads the real count from the occluded list
+		buff.cmdBindComputePipeline(pipeline_);
+		buff.cmdPushConstants(ring.push(cullData));
+		buff.cmdDispatchThreadGroups({ .width = (numInstances + kCullGroupSize - 1) / kCullGroupSize },
+			{ .textures = { occlusion.pyramid->getTexture() }, .buffers = { lateDrawCommand_, lateVisibleInstances_, occludedInstances_ } });
+	}
+
+	/// Command for cmdDrawIndexedIndirect
+	lvk::BufferHandle getDrawCommand() const { return drawCommand_; }
+
+	/// Storage buffer of the visible instances, in no particular order
+	lvk::BufferHandle getVisibleInstanceBuffer() const { return visibleInstances_; }
+	uint64_t getVisibleInstances() const { return ctx_->gpuAddress(visibleInstances_); }
+
+	/// Draw and instances of cullOccluded()
+	lvk::BufferHandle getLateDrawCommand() const { return lateDrawCommand_; }
+	lvk::BufferHandle getLateVisibleInstanceBuffer() const { return lateVisibleInstances_; }
+	uint64_t getLateVisibleInstances() const { return ctx_->gpuAddress(lateVisibleInstances_); }
+
+	/// 1 or 0 per instance of the last cull(), valid after its submit has finished. Occlusion does not change it.
+	const uint32_t* getVisibility() const { return reinterpret_cast<const uint32_t*>(ctx_->getMappedPtr(visibility_)); }
+
+private:
+	InstanceCullData getCullData(uint64_t instances, uint32_t numInstances, const BoundingBox& bounds, const glm::mat4& viewProj,
+		const OcclusionPyramid* occlusion) const
+	{
+		InstanceCullData cullData;
+		getFrustumPlanes(viewProj, cullData.frustumPlanes);
+		getFrustumCorners(viewProj, cullData.frustumCorners);
+		cullData.boundsMin = glm::vec4(bounds.min_, 1.0f);
+		cullData.boundsMax = glm::vec4(bounds.max_, 1.0f);
+		cullData.instances = instances;
+		cullData.visibility = ctx_->gpuAddress(visibility_);
+		cullData.occludedInstances = ctx_->gpuAddress(occludedInstances_);
+		cullData.numInstances = numInstances;
+
+		if (occlusion)
+		{
+			const DepthPyramid& pyramid = *occlusion->pyramid;
+			cullData.pyramidViewProj = occlusion->viewProj;
+			cullData.pyramidUvScale = glm::vec4(occlusion->uvScale.x, occlusion->uvScale.y, (float)pyramid.getSize().x, (float)pyramid.getSize().y);
+			cullData.numPyramidLevels = pyramid.getNumLevels();
+			for (uint32_t level = 0; level != pyramid.getNumLevels(); level++)
+				cullData.pyramidLevels[level] = pyramid.getLevelIndex(level);
+		}
+		return cullData;
+	}
+
+	lvk::IContext* ctx_ = nullptr;
+	uint32_t maxInstances_ = 0;
+	lvk::Holder<lvk::ComputePipelineHandle> pipeline_;
+	lvk::Holder<lvk::BufferHandle> visibleInstances_;
+	lvk::Holder<lvk::BufferHandle> drawCommand_;
+	lvk::Holder<lvk::BufferHandle> visibility_;
+	lvk::Holder<lvk::BufferHandle> occludedInstances_;
+	lvk::Holder<lvk::BufferHandle> lateVisibleInstances_;
+	lvk::Holder<lvk::BufferHandle> lateDrawCommand_;
+};
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <lvk/LVK.h>
+#include <glm/glm.hpp>
+
+#include "frame_ring_allocator.h"
+#include "utils_math.h"
+
+/*
+	Clustered forward shading: the view frustum is split into a grid of clusters, screen tiles in x and y and slices in
+	depth that grow exponentially between the near and far plane, so far clusters are not much longer than they are
+	wide. A compute pass tests every point light against a view space box around every cluster and writes the indices
+	of the lights that reach it into the slot of the cluster. A fragment finds its cluster from its position and only
+	loops over those lights, whatever the light count of the scene.
+
+	The functions here are the CPU reference of cluster_lights.comp and of the cluster lookup in light.sp, the shaders
+	have to stay in sync with them.
+*/
+
+// Clusters along x, y and depth, matches kClusterGrid in light.sp
+static constexpr uint32_t kClusterGridX = 16;
+static constexpr uint32_t kClusterGridY = 9;
+static constexpr uint32_t kClusterGridZ = 24;
+static constexpr uint32_t kNumClusters = kClusterGridX * kClusterGridY * kClusterGridZ;
+
+// Lights a cluster holds, the ones after that are dropped. Every cluster has a slot of its light count and this many
+// light indices.
+static constexpr uint32_t kMaxClusterLights = 256;
+static constexpr uint32_t kClusterSlotSize = kMaxClusterLights + 1;
+
+// Largest point light count of the app
+static constexpr uint32_t kMaxPointLights = 4096;
+
+// Threads per group of cluster_lights.comp, also the lights it moves into shared memory at a time
+static constexpr uint32_t kClusterGroupSize = 64;
+static_assert(kNumClusters % kClusterGroupSize == 0);
+
+/// Matches PointLight in light.sp
+struct PointLight
+{
+	glm::vec3 position = glm::vec3(0.0f);
+	float radius = 1.0f; // No light reaches past it
+	glm::vec3 color = glm::vec3(1.0f);
+	float intensity = 1.0f;
+};
+
+/// Matches ClusterData in cluster_lights.comp
+struct LightClusterData
+{
+	glm::mat4 view = glm::mat4(1.0f);
+	glm::mat4 invProj = glm::mat4(1.0f);
+	uint64_t lights = 0;
+	uint64_t clusters = 0;
+	uint32_t numLights = 0;
+	float zNear = 0.0f;
+	float zFar = 0.0f;
+};
+
+/// Slices per unit of log depth, clusterParams.y of UniformData
+inline float getClusterSliceScale(float zNear, float zFar)
+{
+	return (float)kClusterGridZ / std::log(zFar / zNear);
+}
+
+/// View space depth where slice begins, slice kClusterGridZ begins at zFar
+inline float getClusterSliceDepth(uint32_t slice, float zNear, float zFar)
+{
+	return zNear * std::pow(zFar / zNear, (float)slice / (float)kClusterGridZ);
+}
+
+/// Slice of a view space depth, depths outside of the near and far plane go to the first or last slice
+inline uint32_t getClusterSlice(float depth, float zNear, float sliceScale)
+{
+	const float slice = std::log(std::max(depth, zNear) / zNear) * sliceScale;
+	return std::min((uint32_t)slice, kClusterGridZ - 1);
+}
+
+/// Cluster of a world space position, getClusterIndex() of light.sp. Positions outside of the frustum go to the
+/// nearest cluster.
+inline uint32_t getClusterIndex(const glm::vec3& position, const glm::mat4& viewProj, float zNear, float zFar)
+{
+	const glm::vec4 clip = viewProj * glm::vec4(position, 1.0f);
+	const glm::vec2 ndc = clip.w > 0.0f ? glm::vec2(clip) / clip.w : glm::vec2(0.0f);
+	const glm::vec2 grid((float)kClusterGridX, (float)kClusterGridY);
+	const glm::uvec2 tile = glm::uvec2(glm::clamp((ndc * 0.5f + 0.5f) * grid, glm::vec2(0.0f), grid - 1.0f));
+	const uint32_t slice = getClusterSlice(clip.w, zNear, getClusterSliceScale(zNear, zFar));
+	return (slice * kClusterGridY + tile.y) * kClusterGridX + tile.x;
+}
+
+/// View space box around the part of the frustum of a perspective projection that cluster (x, y, z) covers, the
+/// rays through the corners of its tile between the depths of its slice
+inline BoundingBox getClusterBox(uint32_t x, uint32_t y, uint32_t z, const glm::mat4& invProj, float zNear, float zFar)
+{
+	const float depthBegin = getClusterSliceDepth(z, zNear, zFar);
+	const float depthEnd = getClusterSliceDepth(z + 1, zNear, zFar);
+	glm::vec3 corners[8];
+	for (uint32_t c = 0; c != 4; c++)
+	{
+		const glm::vec2 ndc = glm::vec2((float)(x + (c & 1)) / (float)kClusterGridX, (float)(y + (c >> 1)) / (float)kClusterGridY) * 2.0f - 1.0f;
+		// Any point of the ray, scaled to view z = -1
+		const glm::vec4 p = invProj * glm::vec4(ndc, 1.0f, 1.0f);
+		const glm::vec3 dir = glm::vec3(p) / -p.z;
+		corners[2 * c] = dir * depthBegin;
+		corners[2 * c + 1] = dir * depthEnd;
+	}
+	return BoundingBox(corners, 8);
+}
+
+inline bool isSphereInBox(const glm::vec3& center, float radius, const BoundingBox& box)
+{
+	const glm::vec3 d = glm::clamp(center, box.min_, box.max_) - center;
+	return glm::dot(d, d) <= radius * radius;
+}
+
+/// CPU reference of cluster_lights.comp. outClusters gets kNumClusters slots of kClusterSlotSize values, the light
+/// count of the cluster followed by the indices of the lights that reach it, in light order. Returns the number of
+/// lights dropped from full clusters.
+inline uint32_t buildLightClusters(const PointLight* lights, uint32_t numLights, const glm::mat4& view, const glm::mat4& proj,
+	float zNear, float zFar, std::vector<uint32_t>& outClusters)
+{
+	outClusters.resize(size_t(kNumClusters) * kClusterSlotSize);
+
+	std::vector<glm::vec4> viewLights(numLights);
+	for (uint32_t i = 0; i != numLights; i++)
+		viewLights[i] = glm::vec4(glm::vec3(view * glm::vec4(lights[i].position, 1.0f)), lights[i].radius);
+
+	const glm::mat4 invProj = glm::inverse(proj);
+	uint32_t numDropped = 0;
+	for (uint32_t cluster = 0; cluster != kNumClusters; cluster++)
+	{
+		const uint32_t x = cluster % kClusterGridX;
+		const uint32_t y = (cluster / kClusterGridX) % kClusterGridY;
+		const uint32_t z = cluster / (kClusterGridX * kClusterGridY);
+		const BoundingBox box = getClusterBox(x, y, z, invProj, zNear, zFar);
+
+		uint32_t* slot = &outClusters[size_t(cluster) * kClusterSlotSize];
+		uint32_t count = 0;
+		for (uint32_t i = 0; i != numLights; i++)
+		{
+			if (!isSphereInBox(glm::vec3(viewLights[i]), viewLights[i].w, box))
+				continue;
+			if (count < kMaxClusterLights)
+				slot[1 + count++] = i;
+			else
+				numDropped++;
+		}
+		slot[0] = count;
+	}
+	return numDropped;
+}
+
+/*
+	GPU light assignment, one dispatch of cluster_lights.comp a frame into a device buffer of cluster slots. The
+	lights live in the frame ring. The buffer is reused every frame, the dispatch and the render pass list it as a
+	dependency so LVK puts barriers between the shading of one frame and the assignment of the next.
+*/
+class LightClusters
+{
+public:
+	LightClusters(std::unique_ptr<lvk::IContext>& ctx, lvk::ShaderModuleHandle computeShader) : ctx_(ctx.get())
+	{
+		pipeline_ = ctx->createComputePipeline({ .smComp = computeShader, .debugName = "Pipeline: light clusters" });
+		LVK_ASSERT(pipeline_.valid());
+
+		clusters_ = ctx->createBuffer(
+			{ .usage = lvk::BufferUsageBits_Storage,
+			  .storage = lvk::StorageType_Device,
+			  .size = sizeof(uint32_t) * kNumClusters * kClusterSlotSize,
+			  .debugName = "Buffer: light clusters" },
+			nullptr);
+	}
+
+	LightClusters(const LightClusters&) = delete;
+	LightClusters& operator=(const LightClusters&) = delete;
+
+	/// Records the assignment of numLights PointLights at address lights, outside of a render pass. zNear and zFar are
+	/// the planes of proj, the cluster data goes into the frame ring.
+	void build(lvk::ICommandBuffer& buff, FrameRingAllocator& ring, uint64_t lights, uint32_t numLights, const glm::mat4& view,
+		const glm::mat4& proj, float zNear, float zFar)
+	{
+		const LightClusterData data{
+			.view = view,
+			.invProj = glm::inverse(proj),
+			.lights = lights,
+			.clusters = ctx_->gpuAddress(clusters_),
+			.numLights = numLights,
+			.zNear = zNear,
+			.zFar = zFar,
+		};
+
+		buff.cmdBindComputePipeline(pipeline_);
+		buff.cmdPushConstants(ring.push(data));
+		buff.cmdDispatchThreadGroups({ .width = kNumClusters / kClusterGroupSize }, { .buffers = { clusters_ } });
+	}
+
+	lvk::BufferHandle getClusterBuffer() const { return clusters_; }
+	uint64_t getClusters() const { return ctx_->gpuAddress(clusters_); }
+
+private:
+	lvk::IContext* ctx_ = nullptr;
+	lvk::Holder<lvk::ComputePipelineHandle> pipeline_;
+	lvk::Holder<lvk::BufferHandle> clusters_;
+};
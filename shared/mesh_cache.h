@@ -0,0 +1,265 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+	MappedFile& operator=(MappedFile&& other) noexcept
+	{
+		if (this != &other)
+		{
+			close();
+			data_ = other.data_;
+			size_ = other.size_;
+#if defined(_WIN32)
+			file_ = other.file_;
+			mapping_ = other.mapping_;
+			other.file_ = INVALID_HANDLE_VALUE;
+			other.mapping_ = nullptr;
+#endif
+			other.data_ = nullptr;
+			other.size_ = 0;
+		}
+		return *this;
+	}
+
+	bool open(const std::filesystem::path& file)
+	{
+		close();
+#if defined(_WIN32)
+		file_ = CreateFileW(file.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file_ == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0)
+		{
+			close();
+			return false;
+		}
+
+		mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		data_ = mapping_ ? static_cast<const uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+		size_ = (size_t)size.QuadPart;
+#else
+		const int fd = ::open(file.string().c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat st{};
+		if (fstat(fd, &st) != 0 || st.st_size == 0)
+		{
+			::close(fd);
+			return false;
+		}
+
+		void* ptr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		data_ = ptr == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(ptr);
+		size_ = (size_t)st.st_size;
+#endif
+		if (!data_)
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close()
+	{
+#if defined(_WIN32)
+		if (data_) UnmapViewOfFile(data_);
+		if (mapping_) CloseHandle(mapping_);
+		if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+		mapping_ = nullptr;
+		file_ = INVALID_HANDLE_VALUE;
+#else
+		if (data_) munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+		data_ = nullptr;
+		size_ = 0;
+	}
+
+	const uint8_t* data() const { return data_; }
+	size_t size() const { return size_; }
+	bool valid() const { return data_ != nullptr; }
+
+private:
+	const uint8_t* data_ = nullptr;
+	size_t size_ = 0;
+#if defined(_WIN32)
+	HANDLE file_ = INVALID_HANDLE_VALUE;
+	HANDLE mapping_ = nullptr;
+#endif
+};
+
+/// 64-bit FNV-1a
+inline uint64_t hashBytes(const uint8_t* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull)
+{
+	for (size_t i = 0; i != size; i++)
+	{
+		hash ^= data[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+/// Hash of the file contents, 0 when the file can't be read
+inline uint64_t hashFile(const std::filesystem::path& file)
+{
+	MappedFile mapped;
+	if (!mapped.open(file))
+		return 0;
+	return hashBytes(mapped.data(), mapped.size());
+}
+
+/*
+	Mesh cache file layout, everything is ready to be uploaded as is:
+		MeshCacheHeader
+		Vertex[numVertices]
+		uint32_t[numIndices]
+		SubMesh[numSubMeshes]
+		MeshLod[numLods]
+		vec4[numMeshlets] spheres, vec4[numMeshlets] cones, uvec2[numMeshlets] ranges (MeshletData)
+*/
+static constexpr uint32_t kMeshCacheMagic = 0x4853454d; // "MESH"
+static constexpr uint32_t kMeshCacheVersion = 5;
+
+struct MeshCacheHeader
+{
+	uint32_t magic = kMeshCacheMagic;
+	uint32_t version = kMeshCacheVersion;
+	uint64_t sourceHash = 0;
+	uint32_t importFlags = 0;
+	uint32_t vertexSize = 0;
+	uint32_t numVertices = 0;
+	uint32_t numIndices = 0;
+	uint32_t subMeshSize = 0;
+	uint32_t numSubMeshes = 0;
+	float boundsMin[3] = {};
+	float boundsMax[3] = {};
+	uint32_t lodSize = 0;
+	uint32_t numLods = 0;
+	uint32_t numMeshlets = 0;
+	uint32_t padding = 0;
+};
+static_assert(sizeof(MeshCacheHeader) == 80, "MeshCacheHeader is written to disk as is");
+
+/// Cache file of a mesh source file, stored next to it
+inline std::filesystem::path getMeshCachePath(const std::filesystem::path& source)
+{
+	return std::filesystem::path(source).concat(".meshcache");
+}
+
+// Bytes per meshlet of the SoA arrays: sphere, cone and index range
+static constexpr size_t kMeshletCacheSize = 4 * sizeof(float) + 4 * sizeof(float) + 2 * sizeof(uint32_t);
+
+inline bool saveMeshCache(const std::filesystem::path& file, const MeshCacheHeader& header, const void* vertices, const uint32_t* indices, const void* subMeshes, const void* lods,
+	const void* meshletSpheres, const void* meshletCones, const void* meshletRanges)
+{
+	std::ofstream out(file, std::ios::binary | std::ios::trunc);
+	if (!out)
+		return false;
+
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(vertices), (std::streamsize)header.vertexSize * header.numVertices);
+	out.write(reinterpret_cast<const char*>(indices), (std::streamsize)sizeof(uint32_t) * header.numIndices);
+	out.write(reinterpret_cast<const char*>(subMeshes), (std::streamsize)header.subMeshSize * header.numSubMeshes);
+	out.write(reinterpret_cast<const char*>(lods), (std::streamsize)header.lodSize * header.numLods);
+	out.write(reinterpret_cast<const char*>(meshletSpheres), (std::streamsize)4 * sizeof(float) * header.numMeshlets);
+	out.write(reinterpret_cast<const char*>(meshletCones), (std::streamsize)4 * sizeof(float) * header.numMeshlets);
+	out.write(reinterpret_cast<const char*>(meshletRanges), (std::streamsize)2 * sizeof(uint32_t) * header.numMeshlets);
+
+	return out.good();
+}
+
+/// Maps a cache file and checks it was made from the same source, import flags and struct layouts.
+/// Returns the header inside the mapping or nullptr when the cache has to be rebuilt.
+inline const MeshCacheHeader* openMeshCache(MappedFile& mapped, const std::filesystem::path& file, uint64_t sourceHash, uint32_t importFlags, uint32_t vertexSize, uint32_t subMeshSize, uint32_t lodSize)
+{
+	if (!mapped.open(file) || mapped.size() < sizeof(MeshCacheHeader))
+		return nullptr;
+
+	const MeshCacheHeader* header = reinterpret_cast<const MeshCacheHeader*>(mapped.data());
+
+	const bool isValid = header->magic == kMeshCacheMagic &&
+		header->version == kMeshCacheVersion &&
+		header->sourceHash == sourceHash &&
+		header->importFlags == importFlags &&
+		header->vertexSize == vertexSize &&
+		header->subMeshSize == subMeshSize &&
+		header->lodSize == lodSize &&
+		mapped.size() == sizeof(MeshCacheHeader) + size_t(header->vertexSize) * header->numVertices +
+			sizeof(uint32_t) * header->numIndices + size_t(header->subMeshSize) * header->numSubMeshes +
+			size_t(header->lodSize) * header->numLods + kMeshletCacheSize * header->numMeshlets;
+
+	if (!isValid)
+	{
+		mapped.close();
+		return nullptr;
+	}
+
+	return header;
+}
+
+inline const void* getMeshCacheVertices(const MeshCacheHeader* header)
+{
+	return reinterpret_cast<const uint8_t*>(header) + sizeof(MeshCacheHeader);
+}
+
+inline const uint32_t* getMeshCacheIndices(const MeshCacheHeader* header)
+{
+	return reinterpret_cast<const uint32_t*>(reinterpret_cast<const uint8_t*>(getMeshCacheVertices(header)) + size_t(header->vertexSize) * header->numVertices);
+}
+
+inline const void* getMeshCacheSubMeshes(const MeshCacheHeader* header)
+{
+	return getMeshCacheIndices(header) + header->numIndices;
+}
+
+inline const void* getMeshCacheLods(const MeshCacheHeader* header)
+{
+	return static_cast<const uint8_t*>(getMeshCacheSubMeshes(header)) + size_t(header->subMeshSize) * header->numSubMeshes;
+}
+
+inline const float* getMeshCacheMeshletSpheres(const MeshCacheHeader* header)
+{
+	return reinterpret_cast<const float*>(static_cast<const uint8_t*>(getMeshCacheLods(header)) + size_t(header->lodSize) * header->numLods);
+}
+
+inline const float* getMeshCacheMeshletCones(const MeshCacheHeader* header)
+{
+	return getMeshCacheMeshletSpheres(header) + 4 * size_t(header->numMeshlets);
+}
+
+inline const uint32_t* getMeshCacheMeshletRanges(const MeshCacheHeader* header)
+{
+	return reinterpret_cast<const uint32_t*>(getMeshCacheMeshletCones(header) + 4 * size_t(header->numMeshlets));
+}
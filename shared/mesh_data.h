@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+#include "utils_math.h"
+
+struct Vertex
+{
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 uv;
+};
+
+/// Draw range of one mesh of a flattened scene, indices are absolute so it is drawn with
+/// cmdDrawIndexed(indexCount, 1, firstIndex) from the shared buffers of its MeshData
+struct SubMesh
+{
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+	uint32_t firstVertex = 0;
+	uint32_t vertexCount = 0;
+	uint32_t materialIndex = 0;
+	BoundingBox bounds;
+};
+
+inline BoundingBox computeBounds(const Vertex* vertices, size_t numVertices)
+{
+	BoundingBox bounds;
+	bounds.min_ = vec3(std::numeric_limits<float>::max());
+	bounds.max_ = vec3(std::numeric_limits<float>::lowest());
+	for (size_t i = 0; i != numVertices; i++)
+		bounds.combinePoint(vertices[i].position);
+	return bounds;
+}
+
+/// Index range of one level of detail. All levels share the vertex buffer, level 0 is the full mesh.
+/// error is the simplification error in mesh units, levels are ordered by increasing error.
+struct MeshLod
+{
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+	float error = 0.0f;
+};
+
+/// Index range of one cmdDrawIndexed(indexCount, 1, firstIndex)
+struct DrawRange
+{
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+};
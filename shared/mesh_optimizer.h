@@ -0,0 +1,350 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh_data.h"
+
+/*
+	Import time mesh optimization, run on every sub-mesh before it goes into the mesh cache:
+		1. Tipsify vertex cache ordering (Sander et al. 2007, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw")
+		2. Overdraw ordering, the Tipsify output is cut into clusters that are sorted so outward facing ones are drawn first
+		3. Vertex fetch ordering, vertices are renumbered in the order the index buffer first uses them
+*/
+
+// FIFO post-transform cache the order is tuned for and measured against
+static constexpr uint32_t kVertexCacheSize = 16;
+// A cluster may be split once its own ACMR gets this close to the ACMR of the whole cluster
+static constexpr float kOverdrawThreshold = 1.05f;
+
+static constexpr uint32_t kInvalidIndex = ~0u;
+
+/// ACMR is transformed vertices per triangle (0.5 at best for big regular meshes, 3 at worst),
+/// ATVR is transformed vertices per referenced vertex (1 at best)
+struct VertexCacheStats
+{
+	float acmr = 0.0f;
+	float atvr = 0.0f;
+};
+
+/// Runs the index buffer through a FIFO cache of cacheSize entries
+inline VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t numIndices, size_t numVertices, uint32_t cacheSize = kVertexCacheSize)
+{
+	// A vertex is in the cache while less than cacheSize other vertices entered it after it did
+	std::vector<uint32_t> cacheTime(numVertices, 0);
+	std::vector<bool> referenced(numVertices, false);
+	uint32_t time = cacheSize + 1;
+	uint32_t misses = 0;
+	uint32_t numReferenced = 0;
+
+	for (size_t i = 0; i != numIndices; i++)
+	{
+		const uint32_t v = indices[i];
+		if (time - cacheTime[v] > cacheSize)
+		{
+			cacheTime[v] = time++;
+			misses++;
+		}
+		if (!referenced[v])
+		{
+			referenced[v] = true;
+			numReferenced++;
+		}
+	}
+
+	VertexCacheStats stats;
+	stats.acmr = numIndices ? float(misses) / float(numIndices / 3) : 0.0f;
+	stats.atvr = numReferenced ? float(misses) / float(numReferenced) : 0.0f;
+	return stats;
+}
+
+/// Writes the triangles of indices into destination in Tipsify order. Triangle offsets where the fan had to jump
+/// to a non-local vertex are added to outHardBoundaries, the cache is as good as cold there.
+inline void optimizeVertexCacheTipsify(
+	uint32_t* destination,
+	const uint32_t* indices,
+	size_t numIndices,
+	size_t numVertices,
+	uint32_t cacheSize = kVertexCacheSize,
+	std::vector<uint32_t>* outHardBoundaries = nullptr)
+{
+	const size_t numTriangles = numIndices / 3;
+
+	// Vertex -> triangle adjacency
+	std::vector<uint32_t> liveTriangles(numVertices, 0);
+	for (size_t i = 0; i != numTriangles * 3; i++)
+		liveTriangles[indices[i]]++;
+
+	std::vector<uint32_t> offsets(numVertices + 1, 0);
+	std::partial_sum(liveTriangles.begin(), liveTriangles.end(), offsets.begin() + 1);
+
+	std::vector<uint32_t> adjacency(numTriangles * 3);
+	{
+		std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i != numTriangles * 3; i++)
+			adjacency[cursor[indices[i]]++] = uint32_t(i / 3);
+	}
+
+	std::vector<uint32_t> cacheTime(numVertices, 0);
+	std::vector<bool> emitted(numTriangles, false);
+	std::vector<uint32_t> deadEnd;
+	deadEnd.reserve(numTriangles * 3);
+	std::vector<uint32_t> candidates;
+
+	uint32_t time = cacheSize + 1;
+	uint32_t scanCursor = 0;
+	size_t numEmitted = 0;
+
+	// Most recently used vertex that still has triangles, then the next one in input order
+	auto skipDeadEnd = [&]() -> uint32_t
+		{
+			while (!deadEnd.empty())
+			{
+				const uint32_t v = deadEnd.back();
+				deadEnd.pop_back();
+				if (liveTriangles[v] > 0)
+					return v;
+			}
+			for (; scanCursor < numVertices; scanCursor++)
+			{
+				if (liveTriangles[scanCursor] > 0)
+					return scanCursor;
+			}
+			return kInvalidIndex;
+		};
+
+	uint32_t fanning = skipDeadEnd();
+	if (fanning != kInvalidIndex && outHardBoundaries)
+		outHardBoundaries->push_back(0);
+
+	while (fanning != kInvalidIndex)
+	{
+		// Emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (uint32_t a = offsets[fanning]; a != offsets[fanning + 1]; a++)
+		{
+			const uint32_t t = adjacency[a];
+			if (emitted[t])
+				continue;
+
+			for (uint32_t k = 0; k != 3; k++)
+			{
+				const uint32_t v = indices[t * 3 + k];
+				destination[numEmitted * 3 + k] = v;
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v]--;
+				if (time - cacheTime[v] > cacheSize)
+					cacheTime[v] = time++;
+			}
+			emitted[t] = true;
+			numEmitted++;
+		}
+
+		// Prefer the oldest candidate that will still be in the cache after its own fan is emitted
+		uint32_t next = kInvalidIndex;
+		int bestPriority = -1;
+		for (uint32_t v : candidates)
+		{
+			if (liveTriangles[v] == 0)
+				continue;
+
+			int priority = 0;
+			if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+				priority = int(time - cacheTime[v]);
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = v;
+			}
+		}
+
+		if (next == kInvalidIndex)
+		{
+			next = skipDeadEnd();
+			if (next != kInvalidIndex && outHardBoundaries)
+				outHardBoundaries->push_back((uint32_t)numEmitted);
+		}
+
+		fanning = next;
+	}
+}
+
+/// Reorders whole clusters of a vertex cache optimized index buffer so that clusters facing away from
+/// the mesh center are drawn first and occlude the inner ones. Hard boundaries come from optimizeVertexCacheTipsify(),
+/// they are further split where it costs less than `threshold` in ACMR.
+inline void optimizeOverdraw(
+	uint32_t* indices,
+	size_t numIndices,
+	const Vertex* vertices,
+	size_t numVertices,
+	const std::vector<uint32_t>& hardBoundaries,
+	uint32_t cacheSize = kVertexCacheSize,
+	float threshold = kOverdrawThreshold)
+{
+	const uint32_t numTriangles = uint32_t(numIndices / 3);
+	if (numTriangles == 0 || hardBoundaries.empty())
+		return;
+
+	std::vector<uint32_t> cacheTime(numVertices, 0);
+	uint32_t time = cacheSize + 1;
+
+	auto flushCache = [&]() { time += cacheSize + 1; };
+	auto triangleMisses = [&](uint32_t t)
+		{
+			uint32_t misses = 0;
+			for (uint32_t k = 0; k != 3; k++)
+			{
+				const uint32_t v = indices[t * 3 + k];
+				if (time - cacheTime[v] > cacheSize)
+				{
+					cacheTime[v] = time++;
+					misses++;
+				}
+			}
+			return misses;
+		};
+
+	// Soft boundaries, every cluster starts with a cold cache because it can end up anywhere in the buffer
+	std::vector<uint32_t> clusters;
+	for (size_t c = 0; c != hardBoundaries.size(); c++)
+	{
+		const uint32_t begin = hardBoundaries[c];
+		const uint32_t end = c + 1 < hardBoundaries.size() ? hardBoundaries[c + 1] : numTriangles;
+
+		flushCache();
+		uint32_t clusterMisses = 0;
+		for (uint32_t t = begin; t != end; t++)
+			clusterMisses += triangleMisses(t);
+		const float clusterAcmr = float(clusterMisses) / float(end - begin);
+
+		flushCache();
+		clusters.push_back(begin);
+		uint32_t start = begin;
+		uint32_t misses = 0;
+		for (uint32_t t = begin; t != end; t++)
+		{
+			misses += triangleMisses(t);
+			if (t + 1 != end && float(misses) / float(t + 1 - start) <= threshold * clusterAcmr)
+			{
+				start = t + 1;
+				misses = 0;
+				clusters.push_back(start);
+				flushCache();
+			}
+		}
+	}
+
+	// Area weighted centroid of the whole mesh
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (uint32_t t = 0; t != numTriangles; t++)
+	{
+		const glm::vec3& p0 = vertices[indices[t * 3 + 0]].position;
+		const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+		const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+		const float area = glm::length(glm::cross(p1 - p0, p2 - p0));
+		meshCentroid += (p0 + p1 + p2) * (area / 3.0f);
+		meshArea += area;
+	}
+	meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : glm::vec3(0.0f);
+
+	// Sort key of a cluster is how much its average normal points away from the mesh centroid
+	std::vector<float> sortKey(clusters.size());
+	for (size_t c = 0; c != clusters.size(); c++)
+	{
+		const uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : numTriangles;
+
+		glm::vec3 centroid(0.0f);
+		glm::vec3 normal(0.0f);
+		float area = 0.0f;
+		for (uint32_t t = clusters[c]; t != end; t++)
+		{
+			const glm::vec3& p0 = vertices[indices[t * 3 + 0]].position;
+			const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+			const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+			const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			const float a = glm::length(n);
+			centroid += (p0 + p1 + p2) * (a / 3.0f);
+			normal += n;
+			area += a;
+		}
+
+		const float normalLength = glm::length(normal);
+		sortKey[c] = area > 0.0f && normalLength > 0.0f
+			? glm::dot(centroid / area - meshCentroid, normal / normalLength)
+			: 0.0f;
+	}
+
+	std::vector<uint32_t> order(clusters.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&sortKey](uint32_t a, uint32_t b) { return sortKey[a] > sortKey[b]; });
+
+	const std::vector<uint32_t> source(indices, indices + numTriangles * 3);
+	uint32_t* dst = indices;
+	for (uint32_t c : order)
+	{
+		const uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : numTriangles;
+		dst = std::copy(source.begin() + clusters[c] * 3, source.begin() + end * 3, dst);
+	}
+}
+
+/// Renumbers vertices in the order the index buffer first references them, unused vertices go last
+inline void optimizeVertexFetch(Vertex* vertices, size_t numVertices, uint32_t* indices, size_t numIndices)
+{
+	std::vector<uint32_t> remap(numVertices, kInvalidIndex);
+	uint32_t next = 0;
+
+	for (size_t i = 0; i != numIndices; i++)
+	{
+		uint32_t& r = remap[indices[i]];
+		if (r == kInvalidIndex)
+			r = next++;
+		indices[i] = r;
+	}
+
+	for (uint32_t& r : remap)
+	{
+		if (r == kInvalidIndex)
+			r = next++;
+	}
+
+	const std::vector<Vertex> source(vertices, vertices + numVertices);
+	for (size_t v = 0; v != numVertices; v++)
+		vertices[remap[v]] = source[v];
+}
+
+/// Full optimization of a flattened scene. Every sub-mesh is optimized on its own and keeps its index and vertex ranges.
+inline void optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const std::vector<SubMesh>& subMeshes)
+{
+	std::vector<uint32_t> local;
+	std::vector<uint32_t> reordered;
+	std::vector<uint32_t> hardBoundaries;
+
+	for (const SubMesh& subMesh : subMeshes)
+	{
+		if (subMesh.indexCount < 3)
+			continue;
+
+		uint32_t* subIndices = indices.data() + subMesh.firstIndex;
+		Vertex* subVertices = vertices.data() + subMesh.firstVertex;
+
+		local.resize(subMesh.indexCount);
+		for (uint32_t i = 0; i != subMesh.indexCount; i++)
+			local[i] = subIndices[i] - subMesh.firstVertex;
+
+		reordered.resize(subMesh.indexCount);
+		hardBoundaries.clear();
+		optimizeVertexCacheTipsify(reordered.data(), local.data(), local.size(), subMesh.vertexCount, kVertexCacheSize, &hardBoundaries);
+		optimizeOverdraw(reordered.data(), reordered.size(), subVertices, subMesh.vertexCount, hardBoundaries);
+		optimizeVertexFetch(subVertices, subMesh.vertexCount, reordered.data(), reordered.size());
+
+		for (uint32_t i = 0; i != subMesh.indexCount; i++)
+			subIndices[i] = reordered[i] + subMesh.firstVertex;
+	}
+}
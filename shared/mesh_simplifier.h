@@ -0,0 +1,385 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh_data.h"
+#include "mesh_optimizer.h"
+
+/*
+	Quadric error metric simplification (Garland and Heckbert 1997, "Surface Simplification Using Quadric Error Metrics").
+	Edges are collapsed onto one of their endpoints, so every level reuses the vertices of the full mesh and only needs
+	its own index range. Vertices on open borders and attribute seams (several vertices at one position) never move.
+*/
+
+static constexpr uint32_t kMaxMeshLods = 6;
+// Level i targets kLodReduction^i of the triangles of level 0
+static constexpr float kLodReduction = 0.5f;
+// No levels below this many triangles
+static constexpr uint32_t kMinLodTriangles = 64;
+
+namespace simplify
+{
+	/// Area weighted sum of squared distances to a set of planes, stored as the symmetric 4x4 matrix
+	struct Quadric
+	{
+		double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+		double b0 = 0, b1 = 0, b2 = 0;
+		double c = 0;
+		double weight = 0;
+
+		void addPlane(const glm::vec3& n, float d, float w)
+		{
+			a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+			a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+			b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+			c += w * d * d;
+			weight += w;
+		}
+
+		void add(const Quadric& q)
+		{
+			a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+			b0 += q.b0; b1 += q.b1; b2 += q.b2;
+			c += q.c;
+			weight += q.weight;
+		}
+
+		/// Mean squared distance of p to the planes
+		double evaluate(const glm::vec3& p) const
+		{
+			const double x = p.x, y = p.y, z = p.z;
+			const double e =
+				a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + a11 * y * y + 2 * a12 * y * z + a22 * z * z +
+				2 * (b0 * x + b1 * y + b2 * z) + c;
+			return weight > 0 ? std::max(e, 0.0) / weight : 0.0;
+		}
+	};
+
+	inline uint64_t edgeKey(uint32_t a, uint32_t b)
+	{
+		return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+	}
+
+	struct PositionHash
+	{
+		size_t operator()(const glm::vec3& p) const
+		{
+			// Adding 0 turns -0 into +0, they compare equal so they have to hash the same
+			const glm::vec3 q = p + glm::vec3(0.0f);
+			uint32_t h[3];
+			memcpy(h, &q, sizeof(h));
+			return (h[0] * 73856093u) ^ (h[1] * 19349663u) ^ (h[2] * 83492791u);
+		}
+	};
+} // namespace simplify
+
+/// Simplifies a triangle list down to targetIndexCount indices or as close as the locked vertices allow.
+/// Returns the error of the result in mesh units, the square root of the largest mean squared quadric error of a collapse.
+inline float simplifyMesh(const Vertex* vertices, size_t numVertices, const uint32_t* indices, size_t numIndices, size_t targetIndexCount, std::vector<uint32_t>& outIndices)
+{
+	using namespace simplify;
+
+	// Vertices sharing a position are one vertex for the topology, they only differ in attributes
+	std::vector<uint32_t> remap(numVertices);
+	std::vector<uint32_t> numWedges(numVertices, 0);
+	{
+		std::unordered_map<glm::vec3, uint32_t, PositionHash> positions;
+		positions.reserve(numVertices);
+		for (uint32_t v = 0; v != numVertices; v++)
+		{
+			remap[v] = positions.emplace(vertices[v].position, v).first->second;
+			numWedges[remap[v]]++;
+		}
+	}
+
+	// Triangles that are already degenerate after welding add nothing to the surface
+	std::vector<uint32_t> triangles;
+	triangles.reserve(numIndices);
+	for (size_t i = 0; i + 2 < numIndices; i += 3)
+	{
+		const uint32_t a = remap[indices[i + 0]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+		if (a != b && b != c && c != a)
+			triangles.insert(triangles.end(), { indices[i + 0], indices[i + 1], indices[i + 2] });
+	}
+	const size_t numTriangles = triangles.size() / 3;
+
+	// Open borders, non-manifold edges and attribute seams are locked
+	std::vector<bool> locked(numVertices, false);
+	{
+		std::unordered_map<uint64_t, uint32_t> edgeUse;
+		edgeUse.reserve(triangles.size());
+		for (size_t i = 0; i != triangles.size(); i += 3)
+		{
+			for (int k = 0; k != 3; k++)
+				edgeUse[edgeKey(remap[triangles[i + k]], remap[triangles[i + (k + 1) % 3]])]++;
+		}
+		for (const auto& [key, count] : edgeUse)
+		{
+			if (count != 2)
+			{
+				locked[uint32_t(key >> 32)] = true;
+				locked[uint32_t(key & 0xffffffffu)] = true;
+			}
+		}
+		for (uint32_t v = 0; v != numVertices; v++)
+		{
+			if (numWedges[v] > 1)
+				locked[v] = true;
+		}
+	}
+
+	std::vector<Quadric> quadrics(numVertices);
+	for (size_t i = 0; i != triangles.size(); i += 3)
+	{
+		const glm::vec3& p0 = vertices[triangles[i + 0]].position;
+		const glm::vec3& p1 = vertices[triangles[i + 1]].position;
+		const glm::vec3& p2 = vertices[triangles[i + 2]].position;
+		const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+		const float area = glm::length(n);
+		if (area <= 0.0f)
+			continue;
+		const glm::vec3 normal = n / area;
+		const float d = -glm::dot(normal, p0);
+		for (int k = 0; k != 3; k++)
+			quadrics[remap[triangles[i + k]]].addPlane(normal, d, area);
+	}
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		double cost;
+	};
+
+	std::vector<bool> alive(numTriangles, true);
+	size_t numAlive = numTriangles;
+	double maxCost = 0.0;
+
+	std::vector<uint32_t> offsets(numVertices + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<uint64_t> edges;
+	std::vector<Collapse> collapses;
+	std::vector<bool> touched(numVertices);
+
+	// Every pass collapses the cheapest edges that don't share a vertex, then the adjacency is rebuilt
+	while (numAlive * 3 > targetIndexCount)
+	{
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (size_t t = 0; t != numTriangles; t++)
+		{
+			if (alive[t])
+			{
+				for (int k = 0; k != 3; k++)
+					offsets[remap[triangles[t * 3 + k]] + 1]++;
+			}
+		}
+		for (size_t v = 0; v != numVertices; v++)
+			offsets[v + 1] += offsets[v];
+
+		adjacency.resize(offsets[numVertices]);
+		{
+			std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+			for (uint32_t t = 0; t != numTriangles; t++)
+			{
+				if (alive[t])
+				{
+					for (int k = 0; k != 3; k++)
+						adjacency[cursor[remap[triangles[t * 3 + k]]]++] = t;
+				}
+			}
+		}
+
+		edges.clear();
+		for (size_t t = 0; t != numTriangles; t++)
+		{
+			if (alive[t])
+			{
+				for (int k = 0; k != 3; k++)
+					edges.push_back(edgeKey(remap[triangles[t * 3 + k]], remap[triangles[t * 3 + (k + 1) % 3]]));
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+		collapses.clear();
+		for (uint64_t key : edges)
+		{
+			const uint32_t a = uint32_t(key >> 32);
+			const uint32_t b = uint32_t(key & 0xffffffffu);
+
+			Quadric q = quadrics[a];
+			q.add(quadrics[b]);
+
+			Collapse best{ 0, 0, -1.0 };
+			if (!locked[a])
+				best = { a, b, q.evaluate(vertices[b].position) };
+			if (!locked[b])
+			{
+				const double cost = q.evaluate(vertices[a].position);
+				if (best.cost < 0.0 || cost < best.cost)
+					best = { b, a, cost };
+			}
+			if (best.cost >= 0.0)
+				collapses.push_back(best);
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+		std::fill(touched.begin(), touched.end(), false);
+		size_t numCollapsed = 0;
+
+		for (const Collapse& collapse : collapses)
+		{
+			if (numAlive * 3 <= targetIndexCount)
+				break;
+
+			const uint32_t from = collapse.from;
+			const uint32_t to = collapse.to;
+			if (touched[from] || touched[to])
+				continue;
+
+			// The vertex of `to` the triangles of `from` switch to, taken from a triangle on the collapsed edge
+			uint32_t toVertex = ~0u;
+			bool flips = false;
+			for (uint32_t a = offsets[from]; a != offsets[from + 1]; a++)
+			{
+				const uint32_t t = adjacency[a];
+				if (!alive[t])
+					continue;
+
+				const uint32_t* tri = &triangles[t * 3];
+				bool hasTo = false;
+				for (int k = 0; k != 3; k++)
+				{
+					if (remap[tri[k]] == to)
+					{
+						hasTo = true;
+						toVertex = tri[k];
+					}
+				}
+				if (hasTo)
+					continue;
+
+				// Moving `from` must not turn the triangle over
+				glm::vec3 p[3];
+				glm::vec3 moved[3];
+				for (int k = 0; k != 3; k++)
+				{
+					p[k] = vertices[tri[k]].position;
+					moved[k] = remap[tri[k]] == from ? vertices[to].position : p[k];
+				}
+				const glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+				const glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+				if (glm::dot(before, after) <= 0.0f)
+				{
+					flips = true;
+					break;
+				}
+			}
+			if (flips || toVertex == ~0u)
+				continue;
+
+			for (uint32_t a = offsets[from]; a != offsets[from + 1]; a++)
+			{
+				const uint32_t t = adjacency[a];
+				if (!alive[t])
+					continue;
+
+				uint32_t* tri = &triangles[t * 3];
+				bool hasTo = false;
+				for (int k = 0; k != 3; k++)
+					hasTo |= remap[tri[k]] == to;
+
+				if (hasTo)
+				{
+					alive[t] = false;
+					numAlive--;
+					continue;
+				}
+
+				for (int k = 0; k != 3; k++)
+				{
+					if (remap[tri[k]] == from)
+						tri[k] = toVertex;
+				}
+			}
+
+			quadrics[to].add(quadrics[from]);
+			maxCost = std::max(maxCost, collapse.cost);
+			touched[from] = touched[to] = true;
+			numCollapsed++;
+		}
+
+		if (numCollapsed == 0)
+			break;
+	}
+
+	outIndices.clear();
+	outIndices.reserve(numAlive * 3);
+	for (size_t t = 0; t != numTriangles; t++)
+	{
+		if (alive[t])
+			outIndices.insert(outIndices.end(), { triangles[t * 3 + 0], triangles[t * 3 + 1], triangles[t * 3 + 2] });
+	}
+
+	return float(std::sqrt(maxCost));
+}
+
+/// Appends the simplified levels of every sub-mesh to indices. Level 0 is the range the sub-meshes already cover,
+/// each further level holds all sub-meshes and is vertex cache optimized. Stops early when a level barely shrinks.
+inline void buildMeshLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const std::vector<SubMesh>& subMeshes, std::vector<MeshLod>& outLods)
+{
+	outLods.clear();
+	outLods.push_back({ 0, (uint32_t)indices.size(), 0.0f });
+
+	std::vector<uint32_t> local;
+	std::vector<uint32_t> simplified;
+
+	for (uint32_t level = 1; level != kMaxMeshLods; level++)
+	{
+		const float reduction = std::pow(kLodReduction, float(level));
+		if (float(outLods[0].indexCount / 3) * reduction < float(kMinLodTriangles))
+			break;
+
+		MeshLod lod;
+		lod.firstIndex = (uint32_t)indices.size();
+		lod.error = outLods.back().error;
+
+		for (const SubMesh& subMesh : subMeshes)
+		{
+			if (subMesh.indexCount < 3)
+				continue;
+
+			local.resize(subMesh.indexCount);
+			for (uint32_t i = 0; i != subMesh.indexCount; i++)
+				local[i] = indices[subMesh.firstIndex + i] - subMesh.firstVertex;
+
+			const size_t target = size_t(float(subMesh.indexCount / 3) * reduction) * 3;
+			const float error = simplifyMesh(vertices.data() + subMesh.firstVertex, subMesh.vertexCount, local.data(), local.size(), target, simplified);
+			lod.error = std::max(lod.error, error);
+
+			local.resize(simplified.size());
+			optimizeVertexCacheTipsify(local.data(), simplified.data(), simplified.size(), subMesh.vertexCount);
+
+			for (uint32_t index : local)
+				indices.push_back(index + subMesh.firstVertex);
+		}
+
+		lod.indexCount = (uint32_t)indices.size() - lod.firstIndex;
+
+		// Locked vertices stop the simplifier, a level that saves little is not worth switching to
+		if (lod.indexCount == 0 || lod.indexCount > outLods.back().indexCount * 3 / 4)
+		{
+			indices.resize(lod.firstIndex);
+			break;
+		}
+
+		outLods.push_back(lod);
+	}
+}
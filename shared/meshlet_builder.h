@@ -0,0 +1,376 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh_data.h"
+#include "mesh_simplifier.h"
+#include "utils_math.h"
+
+/*
+	Meshlets (clusters) of level 0. The builder reorders the index buffer of every sub-mesh so each meshlet is a
+	contiguous index range, which lets the clusters that survive culling be drawn with plain cmdDrawIndexed calls.
+	Every meshlet gets a bounding sphere for frustum culling and a normal cone for backface culling of the whole cluster.
+*/
+
+// 64 vertices / 124 triangles per meshlet, the usual mesh shader limits
+static constexpr uint32_t kMaxMeshletVertices = 64;
+static constexpr uint32_t kMaxMeshletTriangles = 124;
+// Meshlets whose normals spread wider than this (smallest dot with the cone axis) get no cone
+static constexpr float kMinMeshletConeDot = 0.1f;
+// How much the builder prefers triangles facing like the meshlet over close ones
+static constexpr float kMeshletConeWeight = 4.0f;
+
+/// Meshlets of a mesh as a structure of arrays, kept on the CPU where cullMeshlets() walks them and stored in this
+/// order in the mesh cache
+struct MeshletData
+{
+	// xyz center, w radius, in mesh space
+	std::vector<glm::vec4> spheres;
+	// xyz axis, w cutoff. A cone with cutoff 1 never culls.
+	std::vector<glm::vec4> cones;
+	// x first index, y index count
+	std::vector<glm::uvec2> ranges;
+
+	size_t size() const { return ranges.size(); }
+	bool empty() const { return ranges.empty(); }
+
+	void clear()
+	{
+		spheres.clear();
+		cones.clear();
+		ranges.clear();
+	}
+};
+
+namespace meshlet
+{
+	inline glm::vec3 triangleNormal(const Vertex* vertices, const uint32_t* tri)
+	{
+		const glm::vec3& a = vertices[tri[0]].position;
+		return glm::cross(vertices[tri[1]].position - a, vertices[tri[2]].position - a);
+	}
+
+	inline glm::vec3 triangleCentroid(const Vertex* vertices, const uint32_t* tri)
+	{
+		return (vertices[tri[0]].position + vertices[tri[1]].position + vertices[tri[2]].position) / 3.0f;
+	}
+} // namespace meshlet
+
+/// Bounding sphere and normal cone of the triangles in indices[0, numIndices)
+inline void computeMeshletBounds(const Vertex* vertices, const uint32_t* indices, size_t numIndices, glm::vec4& outSphere, glm::vec4& outCone)
+{
+	BoundingBox box;
+	box.min_ = vec3(std::numeric_limits<float>::max());
+	box.max_ = vec3(std::numeric_limits<float>::lowest());
+	for (size_t i = 0; i != numIndices; i++)
+		box.combinePoint(vertices[indices[i]].position);
+
+	const glm::vec3 center = box.getCenter();
+	float radius = 0.0f;
+	for (size_t i = 0; i != numIndices; i++)
+		radius = std::max(radius, glm::length(vertices[indices[i]].position - center));
+	outSphere = glm::vec4(center, radius);
+
+	// Axis is the area weighted average normal, the cutoff is the sine of the widest angle to it
+	glm::vec3 axis(0.0f);
+	for (size_t i = 0; i + 2 < numIndices; i += 3)
+		axis += meshlet::triangleNormal(vertices, indices + i);
+
+	outCone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	const float axisLength = glm::length(axis);
+	if (axisLength == 0.0f)
+		return;
+	axis /= axisLength;
+
+	float minDot = 1.0f;
+	for (size_t i = 0; i + 2 < numIndices; i += 3)
+	{
+		const glm::vec3 n = meshlet::triangleNormal(vertices, indices + i);
+		const float length = glm::length(n);
+		if (length > 0.0f)
+			minDot = std::min(minDot, glm::dot(n, axis) / length);
+	}
+
+	if (minDot >= kMinMeshletConeDot)
+		outCone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+}
+
+/// Greedy meshlet builder. Starting from a seed triangle, neighbours that add no vertex are taken first, then the ones
+/// that would otherwise be cut off, then the one closest to the meshlet centroid, until kMaxMeshletVertices or
+/// kMaxMeshletTriangles is reached.
+/// Reorders the triangles of indices in place so every meshlet is contiguous and returns the index count of each.
+/// Within a meshlet the triangles keep their input order, so a vertex cache optimized order mostly survives.
+inline std::vector<uint32_t> buildMeshlets(const Vertex* vertices, size_t numVertices, uint32_t* indices, size_t numIndices)
+{
+	const uint32_t numTriangles = uint32_t(numIndices / 3);
+	std::vector<uint32_t> counts;
+	if (!numTriangles)
+		return counts;
+
+	// Adjacency goes through welded positions, so meshlets grow across attribute seams
+	std::vector<uint32_t> remap(numVertices);
+	{
+		std::unordered_map<glm::vec3, uint32_t, simplify::PositionHash> positions;
+		positions.reserve(numVertices);
+		for (uint32_t v = 0; v != numVertices; v++)
+			remap[v] = positions.emplace(vertices[v].position, v).first->second;
+	}
+
+	std::vector<uint32_t> offsets(numVertices + 1, 0);
+	for (size_t i = 0; i != numTriangles * 3; i++)
+		offsets[remap[indices[i]] + 1]++;
+	for (size_t v = 0; v != numVertices; v++)
+		offsets[v + 1] += offsets[v];
+	std::vector<uint32_t> adjacency(numTriangles * 3);
+	{
+		std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+		for (uint32_t t = 0; t != numTriangles; t++)
+			for (int k = 0; k != 3; k++)
+				adjacency[cursor[remap[indices[t * 3 + k]]]++] = t;
+	}
+
+	std::vector<glm::vec3> centroids(numTriangles);
+	std::vector<glm::vec3> normals(numTriangles);
+	for (uint32_t t = 0; t != numTriangles; t++)
+	{
+		centroids[t] = meshlet::triangleCentroid(vertices, indices + t * 3);
+		const glm::vec3 n = meshlet::triangleNormal(vertices, indices + t * 3);
+		const float length = glm::length(n);
+		normals[t] = length > 0.0f ? n / length : glm::vec3(0.0f);
+	}
+
+	// Stamps of the meshlet a vertex (or welded position) was last added to
+	std::vector<uint32_t> vertexStamp(numVertices, 0);
+	std::vector<uint32_t> positionStamp(numVertices, 0);
+	std::vector<bool> emitted(numTriangles, false);
+
+	// Triangles left around each welded position, a triangle whose corner has no others left would become an island
+	std::vector<uint32_t> live(numVertices, 0);
+	for (size_t v = 0; v != numVertices; v++)
+		live[v] = offsets[v + 1] - offsets[v];
+	const auto liveTriangles = [&](uint32_t t)
+	{
+		return live[remap[indices[t * 3 + 0]]] + live[remap[indices[t * 3 + 1]]] + live[remap[indices[t * 3 + 2]]];
+	};
+	const auto isCorner = [&](uint32_t t)
+	{
+		return live[remap[indices[t * 3 + 0]]] == 1 || live[remap[indices[t * 3 + 1]]] == 1 || live[remap[indices[t * 3 + 2]]] == 1;
+	};
+
+	std::vector<uint32_t> order;
+	order.reserve(numTriangles);
+	std::vector<uint32_t> triangles;
+	std::vector<uint32_t> candidates;
+	uint32_t seedCursor = 0;
+
+	for (uint32_t stamp = 1; order.size() != numTriangles; stamp++)
+	{
+		// Continue from the border of the previous meshlet with its most enclosed triangle, the input order is the fallback
+		uint32_t next = ~0u;
+		uint32_t bestLive = ~0u;
+		for (uint32_t t : candidates)
+		{
+			if (emitted[t])
+				continue;
+			const uint32_t live = liveTriangles(t);
+			if (live < bestLive)
+			{
+				next = t;
+				bestLive = live;
+			}
+		}
+		if (next == ~0u)
+		{
+			while (emitted[seedCursor])
+				seedCursor++;
+			next = seedCursor;
+		}
+
+		triangles.clear();
+		candidates.clear();
+		uint32_t numMeshletVertices = 0;
+		glm::vec3 centroidSum(0.0f);
+		glm::vec3 normalSum(0.0f);
+
+		while (next != ~0u)
+		{
+			emitted[next] = true;
+			triangles.push_back(next);
+			centroidSum += centroids[next];
+			normalSum += normals[next];
+
+			for (int k = 0; k != 3; k++)
+			{
+				const uint32_t v = indices[next * 3 + k];
+				if (vertexStamp[v] != stamp)
+				{
+					vertexStamp[v] = stamp;
+					numMeshletVertices++;
+				}
+				const uint32_t p = remap[v];
+				live[p]--;
+				if (positionStamp[p] != stamp)
+				{
+					positionStamp[p] = stamp;
+					for (uint32_t i = offsets[p]; i != offsets[p + 1]; i++)
+					{
+						if (!emitted[adjacency[i]])
+							candidates.push_back(adjacency[i]);
+					}
+				}
+			}
+
+			if (triangles.size() == kMaxMeshletTriangles)
+				break;
+
+			const glm::vec3 centroid = centroidSum / float(triangles.size());
+			const float normalLength = glm::length(normalSum);
+			const glm::vec3 axis = normalLength > 0.0f ? normalSum / normalLength : glm::vec3(0.0f);
+			next = ~0u;
+			uint32_t bestNew = 4;
+			float bestDistance = std::numeric_limits<float>::max();
+			size_t numLive = 0;
+			for (uint32_t t : candidates)
+			{
+				if (emitted[t])
+					continue;
+				candidates[numLive++] = t;
+
+				uint32_t numNew = 0;
+				for (int k = 0; k != 3; k++)
+					numNew += vertexStamp[indices[t * 3 + k]] != stamp;
+				if (numMeshletVertices + numNew > kMaxMeshletVertices)
+					continue;
+
+				// A triangle that only reuses vertices is free, then corners that would be left behind, then the closest
+				const uint32_t rank = numNew == 0 ? 0 : isCorner(t) ? 1 : 2;
+				// Triangles turning away from the average normal count as further, that keeps the normal cone narrow
+				const glm::vec3 d = centroids[t] - centroid;
+				const float spread = 1.0f + kMeshletConeWeight * (1.0f - glm::dot(normals[t], axis));
+				const float distance = glm::dot(d, d) * spread * spread;
+				if (rank < bestNew || (rank == bestNew && distance < bestDistance))
+				{
+					next = t;
+					bestNew = rank;
+					bestDistance = distance;
+				}
+			}
+			candidates.resize(numLive);
+		}
+
+		std::sort(triangles.begin(), triangles.end());
+		order.insert(order.end(), triangles.begin(), triangles.end());
+		counts.push_back(uint32_t(triangles.size()) * 3);
+	}
+
+	std::vector<uint32_t> reordered(numTriangles * 3);
+	for (uint32_t i = 0; i != numTriangles; i++)
+		for (int k = 0; k != 3; k++)
+			reordered[i * 3 + k] = indices[order[i] * 3 + k];
+	std::copy(reordered.begin(), reordered.end(), indices);
+
+	return counts;
+}
+
+/// Builds the meshlets of every sub-mesh over the level 0 index range, sub-mesh ranges stay valid
+inline void buildMeshMeshlets(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const std::vector<SubMesh>& subMeshes, MeshletData& outMeshlets)
+{
+	outMeshlets.clear();
+
+	std::vector<uint32_t> local;
+
+	for (const SubMesh& subMesh : subMeshes)
+	{
+		if (subMesh.indexCount < 3)
+			continue;
+
+		uint32_t* subIndices = indices.data() + subMesh.firstIndex;
+		const Vertex* subVertices = vertices.data() + subMesh.firstVertex;
+
+		local.resize(subMesh.indexCount);
+		for (uint32_t i = 0; i != subMesh.indexCount; i++)
+			local[i] = subIndices[i] - subMesh.firstVertex;
+
+		const std::vector<uint32_t> counts = buildMeshlets(subVertices, subMesh.vertexCount, local.data(), local.size());
+
+		uint32_t first = 0;
+		for (uint32_t count : counts)
+		{
+			glm::vec4 sphere, cone;
+			computeMeshletBounds(subVertices, local.data() + first, count, sphere, cone);
+			outMeshlets.spheres.push_back(sphere);
+			outMeshlets.cones.push_back(cone);
+			outMeshlets.ranges.push_back(glm::uvec2(subMesh.firstIndex + first, count));
+			first += count;
+		}
+
+		for (uint32_t i = 0; i != subMesh.indexCount; i++)
+			subIndices[i] = local[i] + subMesh.firstVertex;
+	}
+}
+
+/// Camera and frustum in mesh space, so meshlet bounds are tested without transforming them
+struct MeshletCullParams
+{
+	glm::vec4 frustumPlanes[6];
+	glm::vec3 cameraPosition;
+};
+
+/// viewProj * model for the frustum, the inverse of view * model for the camera position.
+/// Non-uniform scale skews the bounding spheres, the apps only scale uniformly.
+inline MeshletCullParams getMeshletCullParams(const glm::mat4& model, const glm::mat4& view, const glm::mat4& proj)
+{
+	MeshletCullParams params;
+	getFrustumPlanes(proj * view * model, params.frustumPlanes);
+	for (glm::vec4& plane : params.frustumPlanes)
+		plane /= glm::length(glm::vec3(plane));
+	params.cameraPosition = glm::vec3(glm::inverse(view * model) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	return params;
+}
+
+/// Sphere completely on the outer side of one of the (normalized, inward facing) frustum planes
+inline bool isMeshletOutsideFrustum(const glm::vec4& sphere, const glm::vec4* frustumPlanes)
+{
+	for (int i = 0; i != 6; i++)
+	{
+		if (glm::dot(frustumPlanes[i], glm::vec4(glm::vec3(sphere), 1.0f)) < -sphere.w)
+			return true;
+	}
+	return false;
+}
+
+/// Every triangle faces away from the camera. Conservative, never true with the camera inside the sphere.
+inline bool isMeshletBackfacing(const glm::vec4& sphere, const glm::vec4& cone, const glm::vec3& cameraPosition)
+{
+	const glm::vec3 toCenter = glm::vec3(sphere) - cameraPosition;
+	return glm::dot(toCenter, glm::vec3(cone)) >= cone.w * glm::length(toCenter) + sphere.w;
+}
+
+/// Index ranges of the visible meshlets, neighbouring ranges are merged into one draw. Returns the visible meshlet count.
+inline uint32_t cullMeshlets(const MeshletData& meshlets, const MeshletCullParams& params, std::vector<DrawRange>& outDraws)
+{
+	outDraws.clear();
+
+	uint32_t numVisible = 0;
+	for (size_t i = 0; i != meshlets.size(); i++)
+	{
+		if (isMeshletOutsideFrustum(meshlets.spheres[i], params.frustumPlanes) ||
+			isMeshletBackfacing(meshlets.spheres[i], meshlets.cones[i], params.cameraPosition))
+			continue;
+
+		numVisible++;
+		const glm::uvec2& range = meshlets.ranges[i];
+		if (!outDraws.empty() && outDraws.back().firstIndex + outDraws.back().indexCount == range.x)
+			outDraws.back().indexCount += range.y;
+		else
+			outDraws.push_back({ range.x, range.y });
+	}
+	return numVisible;
+}
@@ -16,76 +16,208 @@
 #include <stb/stb_image_write.h>
 
 #include "bitmap.h"
+#include "mesh_cache.h"
+#include "mesh_data.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "meshlet_builder.h"
+#include "vertex_format.h"
 #include "utils_math.h"
 #include "utils_cubemap.h"
 
 
-struct Vertex
-{
-	glm::vec3 position;
-	glm::vec3 normal;
-	glm::vec2 uv;
-};
-
-// Mesh data
+// Mesh data, all the sub-meshes of a scene share one vertex and one index buffer
 struct MeshData
 {
+	// CPU copies, left empty when the mesh is uploaded straight from the mesh cache
 	std::vector<Vertex> verts;
 	std::vector<uint32_t> indices;
+	std::vector<SubMesh> subMeshes;
+	// Level 0 is the range the sub-meshes cover, the coarser levels follow it in the index buffer
+	std::vector<MeshLod> lods;
+	// Clusters of level 0, culled on the CPU by getMeshDrawRanges()
+	MeshletData meshlets;
+	uint32_t numIndices = 0;
+	BoundingBox bounds;
+	// Only used when the vertex buffer holds PackedVertex
+	VertexQuantization quantization;
 	lvk::Holder<lvk::BufferHandle> vertexBuffer;
 	lvk::Holder<lvk::BufferHandle> indexBuffer;
 };
 static std::vector<MeshData> md;
 
-inline void loadModelData(const std::filesystem::path& file, std::vector<Vertex>& outVertices, std::vector<uint32_t>& outIndices)
+/// Push constants of a mesh draw, matches PushConstants in common.sp
+struct DrawPushConstants
+{
+	uint64_t uniformData = 0;
+	uint64_t instanceData = 0;
+	glm::vec4 positionOffset;
+	glm::vec4 positionScale;
+};
+
+inline DrawPushConstants getDrawPushConstants(uint64_t uniformData, uint64_t instanceData, const MeshData& mesh)
 {
-	// For smooth shading add this flag as well aiProcess_GenSmoothNormals
-	const aiScene* scene = aiImportFile(file.string().c_str(), aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_JoinIdenticalVertices);
+	DrawPushConstants pc;
+	pc.uniformData = uniformData;
+	pc.instanceData = instanceData;
+	pc.positionOffset = mesh.quantization.positionOffset;
+	pc.positionScale = mesh.quantization.positionScale;
+	return pc;
+}
+
+// A level is drawn once its simplification error covers at most this many pixels
+static constexpr float kLodPixelError = 1.0f;
+
+/// Coarsest level of the mesh whose error projects to at most kLodPixelError pixels, proj is the camera projection
+inline uint32_t selectLod(const MeshData& mesh, const glm::mat4& model, const glm::mat4& view, const glm::mat4& proj, float viewportHeight)
+{
+	if (mesh.lods.size() < 2)
+		return 0;
+
+	// Errors are in mesh units, scale them like the model matrix does
+	const float scale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])) });
+
+	// Distance to the closest point of the bounding sphere, inside of it the full mesh is used
+	const glm::vec3 center = glm::vec3(view * model * glm::vec4(mesh.bounds.getCenter(), 1.0f));
+	const float distance = glm::length(center) - 0.5f * glm::length(mesh.bounds.getSize()) * scale;
+	if (distance <= 0.0f)
+		return 0;
 
-	if (!scene || !scene->HasMeshes())
+	// proj[1][1] is 1 / tan(fovY / 2)
+	const float pixelsPerUnit = proj[1][1] * 0.5f * viewportHeight * scale / distance;
+
+	for (uint32_t i = (uint32_t)mesh.lods.size() - 1; i != 0; i--)
 	{
-		std::cout << "Scene is Invalid or has no meshes\n";
-		return;
+		if (mesh.lods[i].error * pixelsPerUnit <= kLodPixelError)
+			return i;
 	}
+	return 0;
+}
+
+/// Index ranges to draw a level of the mesh with. Level 0 goes through meshlet frustum and backface culling when
+/// cullClusters is set, every other level is a single range. Returns the number of meshlets drawn.
+inline uint32_t getMeshDrawRanges(const MeshData& mesh, uint32_t lod, const glm::mat4& model, const glm::mat4& view, const glm::mat4& proj, bool cullClusters, std::vector<DrawRange>& outDraws)
+{
+	if (lod == 0 && cullClusters && !mesh.meshlets.empty())
+		return cullMeshlets(mesh.meshlets, getMeshletCullParams(model, view, proj), outDraws);
+
+	outDraws.assign(1, { mesh.lods[lod].firstIndex, mesh.lods[lod].indexCount });
+	return lod == 0 ? (uint32_t)mesh.meshlets.size() : 0;
+}
+
+// Assimp post-processing of every imported mesh, part of the mesh cache key
+// For smooth shading add this flag as well aiProcess_GenSmoothNormals
+static constexpr uint32_t kMeshImportFlags = aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_JoinIdenticalVertices;
+
+/// Appends one mesh with its node transform baked into the vertices
+inline void appendMeshData(const aiMesh* mesh, const glm::mat4& transform, std::vector<Vertex>& outVertices, std::vector<uint32_t>& outIndices, std::vector<SubMesh>& outSubMeshes)
+{
+	const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
 
-	const aiMesh* mesh = scene->mMeshes[0];
+	SubMesh subMesh;
+	subMesh.firstIndex = (uint32_t)outIndices.size();
+	subMesh.firstVertex = (uint32_t)outVertices.size();
+	subMesh.vertexCount = mesh->mNumVertices;
+	subMesh.materialIndex = mesh->mMaterialIndex;
 
 	// Populate vertices
 	for (unsigned int i = 0; i != mesh->mNumVertices; i++)
 	{
-		const aiVector3D v = mesh->mVertices[i];
-		outVertices.push_back({ .position = glm::vec3(v.x, v.y, v.z) });
+		const aiVector3D& v = mesh->mVertices[i];
+		Vertex vertex{};
+		vertex.position = glm::vec3(transform * glm::vec4(v.x, v.y, v.z, 1.0f));
+		// Normals
+		if (mesh->HasNormals())
+		{
+			const aiVector3D& n = mesh->mNormals[i];
+			vertex.normal = normalMatrix * glm::vec3(n.x, n.y, n.z);
+		}
+		// UVs
+		if (mesh->HasTextureCoords(0))
+		{
+			const aiVector3D& uv = mesh->mTextureCoords[0][i];
+			vertex.uv = glm::vec2(uv.x, uv.y);
+		}
+		outVertices.push_back(vertex);
 	}
-	// Populate indices
+	// Populate indices, points and lines left over by triangulation are skipped
 	for (unsigned int i = 0; i != mesh->mNumFaces; i++)
 	{
+		const aiFace& face = mesh->mFaces[i];
+		if (face.mNumIndices != 3)
+			continue;
+
 		for (unsigned int j = 0; j < 3; j++)
 		{
-			outIndices.push_back(mesh->mFaces[i].mIndices[j]);
+			outIndices.push_back(subMesh.firstVertex + face.mIndices[j]);
 		}
 	}
-	// Normals
-	if (mesh->HasNormals())
+
+	subMesh.indexCount = (uint32_t)outIndices.size() - subMesh.firstIndex;
+	subMesh.bounds = computeBounds(outVertices.data() + subMesh.firstVertex, subMesh.vertexCount);
+	outSubMeshes.push_back(subMesh);
+}
+
+inline void appendNodeData(const aiScene* scene, const aiNode* node, const glm::mat4& parentTransform, std::vector<Vertex>& outVertices, std::vector<uint32_t>& outIndices, std::vector<SubMesh>& outSubMeshes)
+{
+	// Assimp matrices are row-major
+	const aiMatrix4x4& m = node->mTransformation;
+	const glm::mat4 transform = parentTransform * glm::mat4(
+		m.a1, m.b1, m.c1, m.d1,
+		m.a2, m.b2, m.c2, m.d2,
+		m.a3, m.b3, m.c3, m.d3,
+		m.a4, m.b4, m.c4, m.d4);
+
+	for (unsigned int i = 0; i != node->mNumMeshes; i++)
 	{
-		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
-		{
-			const aiVector3D& n = mesh->mNormals[i];
-			outVertices.at(i).normal = glm::vec3(n.x, n.y, n.z);
-		}
+		appendMeshData(scene->mMeshes[node->mMeshes[i]], transform, outVertices, outIndices, outSubMeshes);
 	}
-	// UVs
-	if (mesh->HasTextureCoords(0))
+
+	for (unsigned int i = 0; i != node->mNumChildren; i++)
 	{
-		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
-		{
-			const aiVector3D& uv = mesh->mTextureCoords[0][i];
-			outVertices.at(i).uv = glm::vec2(uv.x, uv.y);
-		}
+		appendNodeData(scene, node->mChildren[i], transform, outVertices, outIndices, outSubMeshes);
 	}
+}
+
+/// Flattens every mesh of the scene graph into one vertex/index pool, one SubMesh per mesh instance
+inline void loadModelData(const std::filesystem::path& file, std::vector<Vertex>& outVertices, std::vector<uint32_t>& outIndices, std::vector<SubMesh>& outSubMeshes)
+{
+	const aiScene* scene = aiImportFile(file.string().c_str(), kMeshImportFlags);
+
+	if (!scene || !scene->HasMeshes() || !scene->mRootNode)
+	{
+		std::cout << "Scene is Invalid or has no meshes\n";
+		if (scene)
+			aiReleaseImport(scene);
+		return;
+	}
+
+	appendNodeData(scene, scene->mRootNode, glm::mat4(1.0f), outVertices, outIndices, outSubMeshes);
 
 	aiReleaseImport(scene);
 }
 
+/// Import time optimization stage of the mesh pipeline, logs the post-transform cache statistics it gained.
+/// Then builds the LOD chain, appending the simplified levels to indices, and the meshlets of level 0.
+inline void optimizeModelData(const char* name, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const std::vector<SubMesh>& subMeshes, std::vector<MeshLod>& outLods, MeshletData& outMeshlets)
+{
+	const VertexCacheStats before = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+	optimizeMesh(vertices, indices, subMeshes);
+	const VertexCacheStats after = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+
+	LLOGL("Optimized %s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", name, before.acmr, after.acmr, before.atvr, after.atvr);
+
+	buildMeshLods(vertices, indices, subMeshes, outLods);
+
+	for (size_t i = 0; i != outLods.size(); i++)
+		LLOGL("  LOD %zu: %u triangles, error %g\n", i, outLods[i].indexCount / 3, outLods[i].error);
+
+	// Meshlets reorder level 0 only, the sub-mesh and LOD ranges stay valid
+	buildMeshMeshlets(vertices, indices, subMeshes, outMeshlets);
+
+	LLOGL("  %zu meshlets\n", outMeshlets.size());
+}
+
 inline lvk::Holder<lvk::TextureHandle> loadTexture(const std::filesystem::path& filePath, std::unique_ptr<lvk::IContext>& ctx)
 {
 	int w, h, comp;
@@ -114,18 +246,14 @@ inline lvk::Holder<lvk::TextureHandle> loadCubemap(const std::filesystem::path&
 
 	// load HDR image
 	int w, h;
-	const float* img = stbi_loadf(RESOURCE_DIR"/textures/dusk.hdr", &w, &h, nullptr, 4);
+	const float* img = stbi_loadf(filePath.string().c_str(), &w, &h, nullptr, 4);
 	assert(img);
 
-	// Covert HDR into 6-faced vertical cross image
+	// Covert HDR straight into 6 cube faces
 	Bitmap in(w, h, 4, eBitmapFormat_Float, img);
-	Bitmap out = cubemap::convertEquirectangularMapToVerticalCross(in);
 	stbi_image_free((void*)img);
 
-	stbi_write_hdr(".cache/screenshot.hdr", out.w_, out.h_, out.comp_, (const float*)out.data_.data());
-
-	// Extract images out of vertical cross
-	Bitmap finalCubemap = cubemap::convertVerticalCrossToCubeMapFaces(out);
+	Bitmap finalCubemap = cubemap::convertEquirectangularMapToCubeMapFaces(in);
 
 	// Fill in the desc data
 	cubemapTextureDesc.type = lvk::TextureType_Cube;
@@ -139,30 +267,149 @@ inline lvk::Holder<lvk::TextureHandle> loadCubemap(const std::filesystem::path&
 	return cubemapTexture;
 }
 
-inline void loadMesh(
+/// Geometry inside a mapped mesh cache file
+struct MeshCacheView
+{
+	const Vertex* vertices = nullptr;
+	uint32_t numVertices = 0;
+	const uint32_t* indices = nullptr;
+	uint32_t numIndices = 0;
+	const SubMesh* subMeshes = nullptr;
+	uint32_t numSubMeshes = 0;
+	const MeshLod* lods = nullptr;
+	uint32_t numLods = 0;
+	const glm::vec4* meshletSpheres = nullptr;
+	const glm::vec4* meshletCones = nullptr;
+	const glm::uvec2* meshletRanges = nullptr;
+	uint32_t numMeshlets = 0;
+	BoundingBox bounds;
+};
+
+/// Maps the mesh cache of meshPath, a missing or stale cache is rebuilt from the source through Assimp first
+inline bool loadMeshCache(const std::filesystem::path& meshPath, MappedFile& outMapping, MeshCacheView& outView)
+{
+	const uint64_t sourceHash = hashFile(meshPath);
+	const std::filesystem::path cachePath = getMeshCachePath(meshPath);
+
+	const MeshCacheHeader* header = openMeshCache(outMapping, cachePath, sourceHash, kMeshImportFlags, sizeof(Vertex), sizeof(SubMesh), sizeof(MeshLod));
+
+	if (!header)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		std::vector<SubMesh> subMeshes;
+		std::vector<MeshLod> lods;
+		MeshletData meshlets;
+		loadModelData(meshPath, vertices, indices, subMeshes);
+
+		if (vertices.empty())
+			return false;
+
+		optimizeModelData(meshPath.filename().string().c_str(), vertices, indices, subMeshes, lods, meshlets);
+
+		const BoundingBox bounds = computeBounds(vertices.data(), vertices.size());
+
+		MeshCacheHeader newHeader{};
+		newHeader.sourceHash = sourceHash;
+		newHeader.importFlags = kMeshImportFlags;
+		newHeader.vertexSize = sizeof(Vertex);
+		newHeader.numVertices = (uint32_t)vertices.size();
+		newHeader.numIndices = (uint32_t)indices.size();
+		newHeader.subMeshSize = sizeof(SubMesh);
+		newHeader.numSubMeshes = (uint32_t)subMeshes.size();
+		newHeader.lodSize = sizeof(MeshLod);
+		newHeader.numLods = (uint32_t)lods.size();
+		newHeader.numMeshlets = (uint32_t)meshlets.size();
+		memcpy(newHeader.boundsMin, &bounds.min_, sizeof(newHeader.boundsMin));
+		memcpy(newHeader.boundsMax, &bounds.max_, sizeof(newHeader.boundsMax));
+
+		if (!saveMeshCache(cachePath, newHeader, vertices.data(), indices.data(), subMeshes.data(), lods.data(),
+				meshlets.spheres.data(), meshlets.cones.data(), meshlets.ranges.data()))
+		{
+			LLOGW("Failed to write mesh cache %s\n", cachePath.string().c_str());
+			return false;
+		}
+
+		header = openMeshCache(outMapping, cachePath, sourceHash, kMeshImportFlags, sizeof(Vertex), sizeof(SubMesh), sizeof(MeshLod));
+		if (!header)
+			return false;
+	}
+
+	outView.vertices = static_cast<const Vertex*>(getMeshCacheVertices(header));
+	outView.numVertices = header->numVertices;
+	outView.indices = getMeshCacheIndices(header);
+	outView.numIndices = header->numIndices;
+	outView.subMeshes = static_cast<const SubMesh*>(getMeshCacheSubMeshes(header));
+	outView.numSubMeshes = header->numSubMeshes;
+	outView.lods = static_cast<const MeshLod*>(getMeshCacheLods(header));
+	outView.numLods = header->numLods;
+	outView.meshletSpheres = reinterpret_cast<const glm::vec4*>(getMeshCacheMeshletSpheres(header));
+	outView.meshletCones = reinterpret_cast<const glm::vec4*>(getMeshCacheMeshletCones(header));
+	outView.meshletRanges = reinterpret_cast<const glm::uvec2*>(getMeshCacheMeshletRanges(header));
+	outView.numMeshlets = header->numMeshlets;
+	outView.bounds = BoundingBox(
+		vec3(header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]),
+		vec3(header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]));
+
+	return true;
+}
+
+inline void createMeshBuffers(
 	std::unique_ptr<lvk::IContext>& ctx,
-	std::vector<Vertex>& vertData,
-	std::vector<uint32_t>& indexData,
-	lvk::Holder<lvk::BufferHandle>& vertBufHandle,
-	lvk::Holder<lvk::BufferHandle>& IndexBufHandle,
-	const std::filesystem::path& meshPath)
+	MeshData& mesh,
+	const Vertex* vertices,
+	size_t numVertices,
+	const uint32_t* indices,
+	size_t numIndices)
 {
-	loadModelData(meshPath, vertData, indexData);
+	// Vertex buffer, packed against the bounds of the whole vertex pool when enabled
+	std::vector<PackedVertex> packedVertices;
+	if (kPackedVertices)
+	{
+		mesh.quantization = getVertexQuantization(computeBounds(vertices, numVertices));
+		packedVertices = packVertices(vertices, numVertices, mesh.quantization);
+	}
 
-	// Vertex buffer
 	lvk::BufferDesc vertBufDesc{};
 	vertBufDesc.usage = lvk::BufferUsageBits_Vertex;
 	vertBufDesc.storage = lvk::StorageType_Device;
-	vertBufDesc.size = sizeof(Vertex) * vertData.size();
-	vertBufDesc.data = vertData.data();
+	vertBufDesc.size = kPackedVertices ? sizeof(PackedVertex) * numVertices : sizeof(Vertex) * numVertices;
+	vertBufDesc.data = kPackedVertices ? static_cast<const void*>(packedVertices.data()) : vertices;
 	vertBufDesc.debugName = "Buffer: vertex";
-	vertBufHandle = ctx->createBuffer(vertBufDesc);
+	mesh.vertexBuffer = ctx->createBuffer(vertBufDesc);
 	// Index Buffer
 	lvk::BufferDesc indexBufDes{};
 	indexBufDes.usage = lvk::BufferUsageBits_Index;
 	indexBufDes.storage = lvk::StorageType_Device;
-	indexBufDes.size = sizeof(uint32_t) * indexData.size();
-	indexBufDes.data = indexData.data();
+	indexBufDes.size = sizeof(uint32_t) * numIndices;
+	indexBufDes.data = indices;
 	indexBufDes.debugName = "Buffer: index";
-	IndexBufHandle = ctx->createBuffer(indexBufDes);
+	mesh.indexBuffer = ctx->createBuffer(indexBufDes);
+
+	mesh.numIndices = (uint32_t)numIndices;
+}
+
+inline void loadMesh(std::unique_ptr<lvk::IContext>& ctx, MeshData& mesh, const std::filesystem::path& meshPath)
+{
+	MappedFile mapping;
+	MeshCacheView view;
+
+	if (loadMeshCache(meshPath, mapping, view))
+	{
+		// Upload straight out of the mapped cache file
+		mesh.subMeshes.assign(view.subMeshes, view.subMeshes + view.numSubMeshes);
+		mesh.lods.assign(view.lods, view.lods + view.numLods);
+		mesh.meshlets.spheres.assign(view.meshletSpheres, view.meshletSpheres + view.numMeshlets);
+		mesh.meshlets.cones.assign(view.meshletCones, view.meshletCones + view.numMeshlets);
+		mesh.meshlets.ranges.assign(view.meshletRanges, view.meshletRanges + view.numMeshlets);
+		mesh.bounds = view.bounds;
+		createMeshBuffers(ctx, mesh, view.vertices, view.numVertices, view.indices, view.numIndices);
+		return;
+	}
+
+	// No usable cache, go through Assimp and keep the CPU copy
+	loadModelData(meshPath, mesh.verts, mesh.indices, mesh.subMeshes);
+	optimizeModelData(meshPath.filename().string().c_str(), mesh.verts, mesh.indices, mesh.subMeshes, mesh.lods, mesh.meshlets);
+	createMeshBuffers(ctx, mesh, mesh.verts.data(), mesh.verts.size(), mesh.indices.data(), mesh.indices.size());
+	mesh.bounds = computeBounds(mesh.verts.data(), mesh.verts.size());
 }
\ No newline at end of file
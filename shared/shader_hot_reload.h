@@ -0,0 +1,232 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <lvk/LVK.h>
+
+#include "shader_processor.h"
+
+// How often the worker looks at the write times of the watched shaders and their includes
+static constexpr std::chrono::milliseconds kShaderPollInterval{ 250 };
+
+/// Watches the shaders of render pipelines and everything they include. A worker thread recompiles a changed shader
+/// to SPIR-V, update() then swaps in new pipelines between frames. A shader that fails to compile keeps the old ones.
+class ShaderHotReload
+{
+public:
+	explicit ShaderHotReload(std::unique_ptr<lvk::IContext>& ctx) : ctx_(ctx.get()), resource_(getShaderResource(*ctx))
+	{
+		worker_ = std::thread([this]() { workerLoop(); });
+	}
+
+	~ShaderHotReload()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		cv_.notify_all();
+		worker_.join();
+	}
+
+	ShaderHotReload(const ShaderHotReload&) = delete;
+	ShaderHotReload& operator=(const ShaderHotReload&) = delete;
+
+	/// Rebuilds pipeline from desc whenever vertFile, fragFile or one of their includes changes.
+	/// pipeline has to outlive the watcher, as does anything desc points to (specialization data).
+	void watch(lvk::Holder<lvk::RenderPipelineHandle>& pipeline, const lvk::RenderPipelineDesc& desc, const fs::path& vertFile, const fs::path& fragFile)
+	{
+		const fs::path vert = fs::absolute(vertFile).lexically_normal();
+		const fs::path frag = fs::absolute(fragFile).lexically_normal();
+		pipelines_.push_back({ &pipeline, desc, vert, frag });
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (const fs::path& file : { vert, frag })
+		{
+			const bool isWatched = std::any_of(files_.begin(), files_.end(), [&file](const WatchedFile& watched) { return watched.file == file; });
+			if (isWatched)
+				continue;
+
+			const PreprocessedShader shader = getShaderPreprocessor().preprocess(file);
+			files_.push_back({ file, shader.dependencies, getNewestWriteTime(shader.dependencies) });
+		}
+	}
+
+	/// Call between frames, swaps in the pipelines of every shader the worker finished. Never waits for the worker.
+	void update()
+	{
+		std::vector<CompiledShader> compiled;
+		{
+			std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+			if (!lock.owns_lock() || compiled_.empty())
+				return;
+			compiled.swap(compiled_);
+		}
+
+		for (CompiledShader& shader : compiled)
+		{
+			lvk::Result result;
+			lvk::Holder<lvk::ShaderModuleHandle> module = ctx_->createShaderModule(
+				{ shader.spirv.data(), shader.spirv.size(), shaderStageFromPath(shader.file), (std::string("Shader module : ") + shader.file.string()).c_str() }, &result);
+			if (!result.isOk())
+			{
+				// A cached binary the driver rejects is compiled again on the next edit
+				std::error_code ec;
+				if (!shader.cachePath.empty())
+					fs::remove(shader.cachePath, ec);
+				LLOGW("Failed to reload shader module %s, keeping the old one\n", shader.file.string().c_str());
+				continue;
+			}
+
+			// Either every pipeline of the shader moves to the new module or none does, the previous module can only go
+			// once nothing uses it any more
+			std::vector<RebuiltPipeline> rebuilt;
+			for (WatchedPipeline& watched : pipelines_)
+			{
+				if (watched.vertFile != shader.file && watched.fragFile != shader.file)
+					continue;
+
+				lvk::RenderPipelineDesc desc = watched.desc;
+				if (watched.vertFile == shader.file)
+					desc.smVert = module;
+				if (watched.fragFile == shader.file)
+					desc.smFrag = module;
+
+				lvk::Holder<lvk::RenderPipelineHandle> pipeline = ctx_->createRenderPipeline(desc, &result);
+				if (!result.isOk())
+					break;
+				rebuilt.push_back({ &watched, desc, std::move(pipeline) });
+			}
+			if (!result.isOk())
+			{
+				LLOGW("Failed to rebuild a pipeline of %s, keeping the old ones\n", shader.file.string().c_str());
+				continue;
+			}
+
+			// LVK defers destroying the old pipelines until the GPU is done with them
+			for (RebuiltPipeline& pipeline : rebuilt)
+			{
+				pipeline.watched->desc = pipeline.desc;
+				*pipeline.watched->pipeline = std::move(pipeline.pipeline);
+			}
+			modules_[shader.file] = std::move(module);
+			LLOGL("Reloaded shader %s, rebuilt %zu pipelines\n", shader.file.string().c_str(), rebuilt.size());
+		}
+	}
+
+private:
+	struct WatchedFile
+	{
+		fs::path file;
+		std::vector<fs::path> dependencies;
+		fs::file_time_type writeTime;
+	};
+
+	struct WatchedPipeline
+	{
+		lvk::Holder<lvk::RenderPipelineHandle>* pipeline = nullptr;
+		lvk::RenderPipelineDesc desc;
+		fs::path vertFile;
+		fs::path fragFile;
+	};
+
+	struct RebuiltPipeline
+	{
+		WatchedPipeline* watched = nullptr;
+		lvk::RenderPipelineDesc desc;
+		lvk::Holder<lvk::RenderPipelineHandle> pipeline;
+	};
+
+	struct CompiledShader
+	{
+		fs::path file;
+		std::vector<uint8_t> spirv;
+		fs::path cachePath; // Set when the SPIR-V came from the cache
+	};
+
+	static fs::file_time_type getNewestWriteTime(const std::vector<fs::path>& files)
+	{
+		fs::file_time_type newest = fs::file_time_type::min();
+		for (const fs::path& file : files)
+		{
+			std::error_code ec;
+			const fs::file_time_type writeTime = fs::last_write_time(file, ec);
+			if (!ec)
+				newest = std::max(newest, writeTime);
+		}
+		return newest;
+	}
+
+	void workerLoop()
+	{
+		// The worker has its own include cache, ShaderPreprocessor is not thread safe
+		ShaderPreprocessor preprocessor;
+		std::vector<WatchedFile> files;
+
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				cv_.wait_for(lock, kShaderPollInterval, [this]() { return stop_; });
+				if (stop_)
+					return;
+				files = files_;
+			}
+
+			for (const WatchedFile& watched : files)
+			{
+				const fs::file_time_type writeTime = getNewestWriteTime(watched.dependencies);
+				if (writeTime <= watched.writeTime)
+					continue;
+
+				const lvk::ShaderStage stage = shaderStageFromPath(watched.file);
+				const PreprocessedShader shader = preprocessor.preprocess(watched.file, getShaderPreamble(stage) + getShaderDefines());
+
+				CompiledShader compiled{ watched.file };
+				bool cacheHit = false;
+				const bool isCompiled = shader.isValid && getShaderSpirv(watched.file, shader.code, stage, resource_, compiled.spirv, cacheHit);
+				if (cacheHit)
+					compiled.cachePath = getSpirvCachePath(watched.file, getSpirvCacheKey(shader.code, stage, resource_));
+				if (!isCompiled)
+					LLOGW("Shader %s failed to compile, keeping the old pipelines\n", watched.file.string().c_str());
+
+				std::lock_guard<std::mutex> lock(mutex_);
+				for (WatchedFile& file : files_)
+				{
+					if (file.file != watched.file)
+						continue;
+					// A failed compile waits for the next edit, a new include gets watched from now on
+					file.writeTime = writeTime;
+					if (shader.isValid)
+						file.dependencies = shader.dependencies;
+				}
+				if (isCompiled)
+					compiled_.push_back(std::move(compiled));
+			}
+		}
+	}
+
+	lvk::IContext* ctx_ = nullptr;
+	const glslang_resource_t resource_; // Read by the worker
+
+	// Main thread only
+	std::vector<WatchedPipeline> pipelines_;
+	std::map<fs::path, lvk::Holder<lvk::ShaderModuleHandle>> modules_;
+
+	// Shared with the worker
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	bool stop_ = false;
+	std::vector<WatchedFile> files_;
+	std::vector<CompiledShader> compiled_;
+
+	std::thread worker_;
+};
@@ -1,66 +1,279 @@
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <map>
 #include <memory>
-#include <unordered_set>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glslang/build_info.h>
+#include <glslang/Public/resource_limits_c.h>
+#include <lvk/vulkan/VulkanClasses.h>
+#include <lvk/vulkan/VulkanUtils.h>
+
+#include "mesh_cache.h"
 
 namespace fs = std::filesystem;
 
-inline std::string readTextFile(const fs::path& file, std::unordered_set<fs::path>& includeGuard)
+/*
+	Shader preprocessor, handles #include <file> / #include "file" relative to the including file and #pragma once.
+	Every file is split once into text chunks ending in an #include and cached by path and write time, so a shared
+	include like common.sp is read and scanned once for all shader modules. Directives inside comments are ignored.
+	The output carries #line <line> <source string> markers, source string i is dependencies[i] of the result.
+*/
+
+/// Text of a source file up to an #include, the directive line itself is dropped
+struct ShaderSourceChunk
+{
+	std::string text;
+	// Line number of the first line of text
+	uint32_t firstLine = 1;
+	// Empty for the last chunk of a file
+	fs::path include;
+};
+
+struct ShaderSourceFile
+{
+	fs::file_time_type writeTime;
+	bool pragmaOnce = false;
+	std::vector<ShaderSourceChunk> chunks;
+};
+
+struct PreprocessedShader
 {
-	if (!includeGuard.insert(fs::absolute(file)).second)
+	std::string code;
+	// Every file that went into code, the root file first. #line source string numbers index into this.
+	std::vector<fs::path> dependencies;
+	bool isValid = false;
+};
+
+namespace shader_preprocessor
+{
+	inline bool isIdentifierChar(char c)
 	{
-		LLOGW("Circular include detected: %s\n", file.string().c_str());
-		return {};
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
 	}
 
-	std::ifstream in(file, std::ios::binary);
-	if (!in)
+	/// Splits code at its #include directives and strips #pragma once. Both only count at the start of a line
+	/// outside of block comments.
+	inline void parseSource(const std::string& code, const fs::path& file, ShaderSourceFile& out)
 	{
-		LLOGW("Failed to open text file %s\n", file.string().c_str());
-		return {};
+		out.pragmaOnce = false;
+		out.chunks.assign(1, {});
+
+		bool inBlockComment = false;
+		uint32_t line = 1;
+		size_t pos = 0;
+
+		while (pos < code.size())
+		{
+			const size_t lineEnd = std::min(code.find('\n', pos), code.size());
+			const size_t next = lineEnd == code.size() ? lineEnd : lineEnd + 1;
+
+			// Directive: optional whitespace, '#', optional whitespace, name
+			size_t i = pos;
+			if (!inBlockComment)
+			{
+				while (i != lineEnd && (code[i] == ' ' || code[i] == '\t'))
+					i++;
+			}
+
+			if (!inBlockComment && i != lineEnd && code[i] == '#')
+			{
+				i++;
+				while (i != lineEnd && (code[i] == ' ' || code[i] == '\t'))
+					i++;
+				const size_t nameStart = i;
+				while (i != lineEnd && isIdentifierChar(code[i]))
+					i++;
+				const std::string_view name(code.data() + nameStart, i - nameStart);
+
+				if (name == "include")
+				{
+					while (i != lineEnd && (code[i] == ' ' || code[i] == '\t'))
+						i++;
+					const char close = i != lineEnd && code[i] == '<' ? '>' : i != lineEnd && code[i] == '"' ? '"' : 0;
+					const size_t pathEnd = close ? code.find(close, i + 1) : std::string::npos;
+
+					if (pathEnd < lineEnd)
+					{
+						out.chunks.back().include = file.parent_path() / code.substr(i + 1, pathEnd - i - 1);
+						out.chunks.push_back({ .firstLine = line + 1 });
+						pos = next;
+						line++;
+						continue;
+					}
+					LLOGW("%s(%u): malformed #include\n", file.string().c_str(), line);
+				}
+				else if (name == "pragma")
+				{
+					while (i != lineEnd && (code[i] == ' ' || code[i] == '\t'))
+						i++;
+					if (code.compare(i, 4, "once") == 0 && (i + 4 == lineEnd || !isIdentifierChar(code[i + 4])))
+					{
+						// Keep the line so the numbering stays the same
+						out.pragmaOnce = true;
+						out.chunks.back().text += '\n';
+						pos = next;
+						line++;
+						continue;
+					}
+				}
+			}
+
+			// Track comments to the end of the line, GLSL has no string literals
+			for (i = pos; i != lineEnd; i++)
+			{
+				if (inBlockComment)
+				{
+					if (code[i] == '*' && i + 1 != lineEnd && code[i + 1] == '/')
+					{
+						inBlockComment = false;
+						i++;
+					}
+				}
+				else if (code[i] == '/' && i + 1 != lineEnd)
+				{
+					if (code[i + 1] == '/')
+						break;
+					if (code[i + 1] == '*')
+					{
+						inBlockComment = true;
+						i++;
+					}
+				}
+			}
+
+			out.chunks.back().text.append(code, pos, next - pos);
+			if (next == code.size() && lineEnd == code.size())
+				out.chunks.back().text += '\n';
+			pos = next;
+			line++;
+		}
 	}
+} // namespace shader_preprocessor
 
-	std::string code;
-	in.seekg(0, std::ios::end);
-	code.reserve(in.tellg());
-	in.seekg(0, std::ios::beg);
-	code.assign((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
-
-	// Remove UTF-8 BOM
-	if (code.size() >= 3 &&
-		static_cast<unsigned char>(code[0]) == 0xEF &&
-		static_cast<unsigned char>(code[1]) == 0xBB &&
-		static_cast<unsigned char>(code[2]) == 0xBF)
+class ShaderPreprocessor
+{
+public:
+	/// Expands the includes of file, prefix goes in front of the first #line marker
+	PreprocessedShader preprocess(const fs::path& file, const std::string& prefix = {})
 	{
-		code.erase(0, 3);
+		PreprocessedShader result;
+		result.code = prefix;
+		std::vector<size_t> includeStack;
+		result.isValid = expand(fs::absolute(file).lexically_normal(), result, includeStack);
+		return result;
 	}
 
-	// Handle #include <file>
-	size_t pos = 0;
-	while ((pos = code.find("#include", pos)) != std::string::npos)
+	/// Cached file contents, re-read when the write time changed. nullptr when the file can't be read.
+	const ShaderSourceFile* getSourceFile(const fs::path& file)
 	{
-		const auto start = code.find('<', pos);
-		const auto end = code.find('>', start);
+		std::error_code ec;
+		const fs::file_time_type writeTime = fs::last_write_time(file, ec);
+		if (ec)
+		{
+			LLOGW("Failed to open text file %s\n", file.string().c_str());
+			return nullptr;
+		}
 
-		if (start == std::string::npos || end == std::string::npos)
-			break;
+		auto it = files_.find(file);
+		if (it != files_.end() && it->second.writeTime == writeTime)
+			return &it->second;
 
-		const fs::path includePath = file.parent_path() / code.substr(start + 1, end - start - 1);
+		std::string code;
+		if (!readFile(file, code))
+			return nullptr;
 
-		const std::string includeCode = readTextFile(includePath, includeGuard);
+		ShaderSourceFile& source = files_[file];
+		source.writeTime = writeTime;
+		shader_preprocessor::parseSource(code, file, source);
+		return &source;
+	}
+
+	void clear() { files_.clear(); }
 
-		code.replace(pos, end - pos + 1, includeCode);
+private:
+	static bool readFile(const fs::path& file, std::string& code)
+	{
+		std::ifstream in(file, std::ios::binary);
+		if (!in)
+		{
+			LLOGW("Failed to open text file %s\n", file.string().c_str());
+			return false;
+		}
+
+		in.seekg(0, std::ios::end);
+		code.reserve(in.tellg());
+		in.seekg(0, std::ios::beg);
+		code.assign((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+		// Remove UTF-8 BOM
+		if (code.size() >= 3 &&
+			static_cast<unsigned char>(code[0]) == 0xEF &&
+			static_cast<unsigned char>(code[1]) == 0xBB &&
+			static_cast<unsigned char>(code[2]) == 0xBF)
+		{
+			code.erase(0, 3);
+		}
+		return true;
 	}
 
-	return code;
-}
+	bool expand(const fs::path& file, PreprocessedShader& result, std::vector<size_t>& includeStack)
+	{
+		const ShaderSourceFile* source = getSourceFile(file);
+		if (!source)
+			return false;
+
+		const auto it = std::find(result.dependencies.begin(), result.dependencies.end(), file);
+		const size_t index = it - result.dependencies.begin();
+
+		if (it != result.dependencies.end())
+		{
+			if (std::find(includeStack.begin(), includeStack.end(), index) != includeStack.end())
+			{
+				LLOGW("Circular include detected: %s\n", file.string().c_str());
+				return true;
+			}
+			if (source->pragmaOnce)
+				return true;
+		}
+		else
+		{
+			result.dependencies.push_back(file);
+		}
 
-inline std::string readShaderFile(const fs::path& file)
+		includeStack.push_back(index);
+		bool isValid = true;
+		for (const ShaderSourceChunk& chunk : source->chunks)
+		{
+			result.code += "#line " + std::to_string(chunk.firstLine) + " " + std::to_string(index) + "\n";
+			result.code += chunk.text;
+
+			if (!chunk.include.empty())
+				isValid &= expand(chunk.include.lexically_normal(), result, includeStack);
+		}
+		includeStack.pop_back();
+
+		return isValid;
+	}
+
+	std::map<fs::path, ShaderSourceFile> files_;
+};
+
+/// Preprocessor shared by every shader module, keeps the include cache between them
+inline ShaderPreprocessor& getShaderPreprocessor()
 {
-	std::unordered_set<fs::path> guard;
-	return readTextFile(file, guard);
+	static ShaderPreprocessor preprocessor;
+	return preprocessor;
 }
 
 inline lvk::ShaderStage shaderStageFromPath(const fs::path& file)
@@ -78,25 +291,241 @@ inline lvk::ShaderStage shaderStageFromPath(const fs::path& file)
 	return lvk::Stage_Vert;
 }
 
+/// Defines prepended to every shader, they mirror the build options of the C++ side
+inline std::string getShaderDefines()
+{
+	std::string defines;
+#if defined(PACKED_VERTICES)
+	defines += "#define PACKED_VERTICES 1\n";
+#endif
+	return defines;
+}
+
+/// Preamble LVK puts in front of GLSL without a #version, built per stage the way
+/// VulkanContext::createShaderModuleFromGLSL does. The SPIR-V cache compiles the shaders itself and LVK leaves
+/// sources that already have a #version alone. The preamble is part of the preprocessed source, so the cache key
+/// covers the exact text every shader was compiled with.
+inline std::string getShaderPreamble(lvk::ShaderStage stage)
+{
+	std::string preamble =
+		"#version 460\n"
+		"#extension GL_EXT_buffer_reference : require\n"
+		"#extension GL_EXT_buffer_reference_uvec2 : require\n"
+		"#extension GL_EXT_debug_printf : enable\n"
+		"#extension GL_EXT_nonuniform_qualifier : require\n"
+		"#extension GL_EXT_shader_explicit_arithmetic_types_float16 : require\n";
+
+	if (stage == lvk::Stage_Task || stage == lvk::Stage_Mesh)
+		preamble += "#extension GL_EXT_mesh_shader : require\n";
+
+	if (stage == lvk::Stage_Frag)
+	{
+		preamble +=
+			"#extension GL_EXT_samplerless_texture_functions : require\n"
+			"layout (set = 0, binding = 0) uniform texture2D kTextures2D[];\n"
+			"layout (set = 1, binding = 0) uniform texture3D kTextures3D[];\n"
+			"layout (set = 2, binding = 0) uniform textureCube kTexturesCube[];\n"
+			"layout (set = 3, binding = 0) uniform texture2D kTextures2DShadow[];\n"
+			"layout (set = 0, binding = 1) uniform sampler kSamplers[];\n"
+			"layout (set = 3, binding = 1) uniform samplerShadow kSamplersShadow[];\n"
+			"vec4 textureBindless2D(uint textureid, uint samplerid, vec2 uv) {\n"
+			"  return texture(nonuniformEXT(sampler2D(kTextures2D[textureid], kSamplers[samplerid])), uv);\n"
+			"}\n"
+			"vec4 textureBindless2DLod(uint textureid, uint samplerid, vec2 uv, float lod) {\n"
+			"  return textureLod(nonuniformEXT(sampler2D(kTextures2D[textureid], kSamplers[samplerid])), uv, lod);\n"
+			"}\n"
+			"float textureBindless2DShadow(uint textureid, uint samplerid, vec3 uvw) {\n"
+			"  return texture(nonuniformEXT(sampler2DShadow(kTextures2DShadow[textureid], kSamplersShadow[samplerid])), uvw);\n"
+			"}\n"
+			"ivec2 textureBindlessSize2D(uint textureid) {\n"
+			"  return textureSize(nonuniformEXT(kTextures2D[textureid]), 0);\n"
+			"}\n"
+			"vec4 textureBindlessCube(uint textureid, uint samplerid, vec3 uvw) {\n"
+			"  return texture(nonuniformEXT(samplerCube(kTexturesCube[textureid], kSamplers[samplerid])), uvw);\n"
+			"}\n"
+			"vec4 textureBindlessCubeLod(uint textureid, uint samplerid, vec3 uvw, float lod) {\n"
+			"  return textureLod(nonuniformEXT(samplerCube(kTexturesCube[textureid], kSamplers[samplerid])), uvw, lod);\n"
+			"}\n";
+	}
+
+	return preamble;
+}
+
+/*
+	Content addressed SPIR-V cache: <shader dir>/.spirv_cache/<key>.spv where the key hashes the fully preprocessed
+	source (preamble and defines included), the stage and the compiler setup. Nothing is ever invalidated, an edited
+	shader simply gets a new key. Binaries are written under a temporary name and renamed into place, so a crash or a
+	second writer never leaves a partial file behind.
+*/
+
+// Bump when the glslang setup changes
+static constexpr uint32_t kSpirvCacheVersion = 1;
+
+#if !defined(LVK_REVISION)
+#define LVK_REVISION "unknown"
+#endif
+
+/// Limits LVK compiles GLSL with, the glslang defaults narrowed to the limits of the device
+inline glslang_resource_t getShaderResource(const lvk::IContext& ctx)
+{
+	return lvk::getGlslangResource(static_cast<const lvk::VulkanContext&>(ctx).getVkPhysicalDeviceProperties().limits);
+}
+
+/// Hash of everything the SPIR-V depends on: the source with its preamble, the stage, the glslang version, the
+/// resource limits it is compiled with and the LVK revision that runs glslang
+inline uint64_t getSpirvCacheKey(const std::string& code, lvk::ShaderStage stage, const glslang_resource_t& resource)
+{
+	const uint32_t options[] = { kSpirvCacheVersion, (uint32_t)stage, GLSLANG_VERSION_MAJOR, GLSLANG_VERSION_MINOR, GLSLANG_VERSION_PATCH };
+	const std::string_view lvkRevision = LVK_REVISION;
+	uint64_t hash = hashBytes(reinterpret_cast<const uint8_t*>(code.data()), code.size());
+	hash = hashBytes(reinterpret_cast<const uint8_t*>(options), sizeof(options), hash);
+	hash = hashBytes(reinterpret_cast<const uint8_t*>(lvkRevision.data()), lvkRevision.size(), hash);
+
+	// Hashed around the padding after the bool limits, its bytes are undefined
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&resource);
+	const size_t limitsEnd = offsetof(glslang_resource_t, limits) + sizeof(glslang_limits_t);
+	const size_t tailBegin = (limitsEnd + alignof(int) - 1) / alignof(int) * alignof(int);
+	hash = hashBytes(bytes, limitsEnd, hash);
+	return hashBytes(bytes + tailBegin, sizeof(glslang_resource_t) - tailBegin, hash);
+}
+
+inline fs::path getSpirvCachePath(const fs::path& shaderFile, uint64_t key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.spv", (unsigned long long)key);
+	return fs::absolute(shaderFile).parent_path() / ".spirv_cache" / name;
+}
+
+// First word of every SPIR-V module
+static constexpr uint32_t kSpirvMagic = 0x07230203;
+
+/// Cheap check of a cached binary before it goes to the driver, the header alone is five words
+inline bool isSpirvHeaderValid(const uint8_t* data, size_t size)
+{
+	if (size < 5 * sizeof(uint32_t) || size % sizeof(uint32_t) != 0)
+		return false;
+
+	uint32_t magic = 0;
+	memcpy(&magic, data, sizeof(magic));
+	return magic == kSpirvMagic;
+}
+
+/// Writes data next to path under a name no other writer uses and renames it over path
+inline bool writeFileAtomic(const fs::path& path, const std::vector<uint8_t>& data)
+{
+	std::random_device random;
+	char suffix[32];
+	snprintf(suffix, sizeof(suffix), ".%08x%08x.tmp", random(), random());
+	const fs::path tempPath = fs::path(path.string() + suffix);
+
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(data.data()), (std::streamsize)data.size());
+		out.close();
+		if (!out)
+		{
+			std::error_code ec;
+			fs::remove(tempPath, ec);
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	fs::rename(tempPath, path, ec);
+	if (ec)
+		fs::remove(tempPath, ec);
+	return !ec;
+}
+
+inline VkShaderStageFlagBits getVkShaderStage(lvk::ShaderStage stage)
+{
+	switch (stage)
+	{
+	case lvk::Stage_Vert: return VK_SHADER_STAGE_VERTEX_BIT;
+	case lvk::Stage_Tesc: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+	case lvk::Stage_Tese: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+	case lvk::Stage_Geom: return VK_SHADER_STAGE_GEOMETRY_BIT;
+	case lvk::Stage_Frag: return VK_SHADER_STAGE_FRAGMENT_BIT;
+	case lvk::Stage_Comp: return VK_SHADER_STAGE_COMPUTE_BIT;
+	default: return VK_SHADER_STAGE_VERTEX_BIT;
+	}
+}
+
+/// SPIR-V of a preprocessed shader, read from the cache or compiled with glslang and written to it.
+/// glslang has to be initialized, creating the LVK context does that.
+inline bool getShaderSpirv(const fs::path& file, const std::string& code, lvk::ShaderStage stage, const glslang_resource_t& resource,
+	std::vector<uint8_t>& outSpirv, bool& outCacheHit)
+{
+	const fs::path cachePath = getSpirvCachePath(file, getSpirvCacheKey(code, stage, resource));
+
+	MappedFile mapped;
+	outCacheHit = mapped.open(cachePath) && isSpirvHeaderValid(mapped.data(), mapped.size());
+	if (outCacheHit)
+	{
+		outSpirv.assign(mapped.data(), mapped.data() + mapped.size());
+		return true;
+	}
+
+	const lvk::Result result = lvk::compileShader(getVkShaderStage(stage), code.c_str(), &outSpirv, &resource);
+	if (!result.isOk())
+	{
+		LLOGW("Failed to compile shader %s\n", file.string().c_str());
+		return false;
+	}
+
+	// A missing cache only costs the next launch a compile
+	std::error_code ec;
+	fs::create_directories(cachePath.parent_path(), ec);
+	if (!writeFileAtomic(cachePath, outSpirv))
+		LLOGW("Failed to write SPIR-V cache %s\n", cachePath.string().c_str());
+
+	return true;
+}
+
 inline lvk::Holder<lvk::ShaderModuleHandle> loadShaderModule(const std::unique_ptr<lvk::IContext>& ctx, const std::filesystem::path& file)
 {
-	const std::string code = readShaderFile(file);
+	const auto start = std::chrono::steady_clock::now();
+
 	const lvk::ShaderStage stage = shaderStageFromPath(file);
+	const PreprocessedShader shader = getShaderPreprocessor().preprocess(file, getShaderPreamble(stage) + getShaderDefines());
 
-	if (code.empty())
+	if (!shader.isValid)
 	{
-		LLOGW("Shader file empty: %s\n", file.string().c_str());
+		LLOGW("Failed to preprocess shader %s\n", file.string().c_str());
 		return {};
 	}
 
+	const glslang_resource_t resource = getShaderResource(*ctx);
+	std::vector<uint8_t> spirv;
+	bool cacheHit = false;
+	if (!getShaderSpirv(file, shader.code, stage, resource, spirv, cacheHit))
+	{
+		// Errors are reported as <source string>:<line>
+		for (size_t i = 0; i != shader.dependencies.size(); i++)
+			LLOGW("  source string %zu: %s\n", i, shader.dependencies[i].string().c_str());
+		return {};
+	}
 
 	lvk::Result result;
 
-	lvk::Holder<lvk::ShaderModuleHandle> handle = ctx->createShaderModule({ code.c_str(), stage, (std::string("Shader module : ") + file.string()).c_str() }, &result);
+	const std::string debugName = std::string("Shader module : ") + file.string();
+	lvk::Holder<lvk::ShaderModuleHandle> handle = ctx->createShaderModule({ spirv.data(), spirv.size(), stage, debugName.c_str() }, &result);
+
+	// A cached binary the driver rejects is a miss, compiled again and written over
+	if (!result.isOk() && cacheHit)
+	{
+		LLOGW("Cached SPIR-V of %s was rejected, compiling it again\n", file.string().c_str());
+		std::error_code ec;
+		fs::remove(getSpirvCachePath(file, getSpirvCacheKey(shader.code, stage, resource)), ec);
+		if (!getShaderSpirv(file, shader.code, stage, resource, spirv, cacheHit))
+			return {};
+		handle = ctx->createShaderModule({ spirv.data(), spirv.size(), stage, debugName.c_str() }, &result);
+	}
 
 	if (!result.isOk())
 		return {};
 
-	LLOGL("Loaded shader module from file: %s\n", file.string().c_str());
+	const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	LLOGL("Loaded shader module from file: %s in %.2f ms (SPIR-V cache %s)\n", file.string().c_str(), ms, cacheHit ? "hit" : "miss");
 	return handle;
-}
\ No newline at end of file
+}
@@ -0,0 +1,1455 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <lvk/LVK.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include <lvk/HelpersImGui.h>
+
+#include "bvh.h"
+#include "camera_path.h"
+#include "depth_pyramid.h"
+#include "frame_benchmark.h"
+#include "frame_profiler.h"
+#include "frame_ring_allocator.h"
+#include "headless.h"
+#include "instance_culling.h"
+#include "light_clusters.h"
+#include "shader_hot_reload.h"
+#include "shader_processor.h"
+#include "shadow_maps.h"
+#include "sphere_data.h"
+#include "model_loader.h"
+
+/// Per-frame data of every shading model, matches UniformData in common.sp
+struct UniformData
+{
+	glm::mat4 model;
+	glm::mat4 view;
+	glm::mat4 proj;
+	glm::vec4 color;
+	glm::vec4 ambientColor;
+	glm::vec4 lightPosition;
+	glm::vec4 cameraPosition;
+	glm::vec4 lightingParams;
+	// x is the near plane of the cluster slices, y the slices per unit of log depth, see getClusterSlice()
+	glm::vec4 clusterParams = glm::vec4(0.0f);
+	uint32_t textureId = 0;
+	uint32_t samplerId = 0;
+	// Point lights besides lightPosition and the cluster slots listing them, see light_clusters.h
+	uint32_t numLights = 0;
+	uint64_t lights = 0;
+	uint64_t clusters = 0;
+	// Depth atlas of the shadow cascades and its ShadowData, see shadow_maps.h
+	uint32_t shadowTextureId = 0;
+	uint32_t shadowSamplerId = 0;
+	uint32_t numShadowCascades = 0;
+	uint64_t shadows = 0;
+};
+
+// Every view drawn in a frame has its own UniformData, buffer references need 16 byte alignment
+static constexpr size_t kUniformDataStride = (sizeof(UniformData) + 15) & ~size_t(15);
+
+// Largest instance count of the stress test, the frame ring has room for this many instances every frame
+static constexpr int kMaxInstances = 16384;
+
+// Distance between neighbours in the grid of the stress test
+static constexpr float kInstanceSpacing = 0.3f;
+
+// A sweep measures every instance count for this many frames, after as many frames to settle
+static constexpr int kSweepFrames = 120;
+
+// Near and far plane of the camera, the depth slices of the light clusters span them. The FreeCamera of derived apps
+// uses the same planes.
+static constexpr float kCameraNear = 0.1f;
+static constexpr float kCameraFar = 1000.0f;
+
+// The shadow cascades cover the view up to this far from the camera by default
+static constexpr float kShadowDistance = 20.0f;
+
+// Scripted runs without a camera path file circle the mesh once in this many seconds
+static constexpr float kCameraOrbitSeconds = 8.0f;
+
+// Meshes of the app in the order of their index
+static const char* kMeshNames[] =
+{
+	"UV-Sphere",
+	"Bunny",
+	"Teapot"
+};
+
+/// Frustum culling of the instances of the stress test
+enum InstanceCulling : int
+{
+	InstanceCulling_Off,
+	InstanceCulling_Cpu, // cullInstances(), the reference
+	InstanceCulling_Gpu, // InstanceCuller and an indirect draw
+	InstanceCulling_Bvh, // Bvh::cullFrustum() over the instance boxes, refit every frame
+	InstanceCulling_Occlusion, // InstanceCuller tests against the depth pyramid of the last frame, then of this one
+};
+
+/// What the views record into a render pass of the frame
+enum ViewPass : int
+{
+	ViewPass_Depth, // Depth of the mesh only, before the color pass
+	ViewPass_Color, // Background, mesh, wireframe and overlay
+	ViewPass_Late, // Instances occlusion culling found after the color pass, over what is there already
+};
+
+/// Level and instances of the mesh drawn this frame
+struct MeshDraw
+{
+	const MeshLod* lod = nullptr;
+	uint32_t numInstances = 1;
+	// Written by GPU culling, only the GPU knows the instance count then
+	lvk::BufferHandle indirectCommand;
+
+	/// Every instance of the whole level
+	void drawLevel(lvk::ICommandBuffer& buff) const
+	{
+		if (indirectCommand.valid())
+			buff.cmdDrawIndexedIndirect(indirectCommand, 0, 1);
+		else
+			buff.cmdDrawIndexed(lod->indexCount, numInstances, lod->firstIndex);
+	}
+};
+
+// Weight of the newest frame in the smoothed frame times
+static constexpr float kFrameTimeSmoothing = 0.05f;
+
+/// Tweakable lighting of a shading model, each model starts from its own defaults
+struct ShadingSettings
+{
+	glm::vec3 baseColor = glm::vec3(0.3f, 0.5f, 0.1f);
+	float diffuseIntensity = 1.0f;
+	glm::vec3 ambientColor = glm::vec3(1.0f);
+	float ambientStrength = 0.1f;
+	glm::vec3 lightPosition = glm::vec3(14.0f, 7.0f, 7.0f);
+	float specularStrength = 0.5f;
+	glm::vec3 clearColor = glm::vec3(0.0f);
+};
+
+class ShadingApp;
+
+/*
+	A shading model is a solid and a wireframe pipeline built from one pair of shaders, a depth only pipeline for the
+	prepass built from the same vertex shader, its settings and whatever it adds to the frame. Models are created by
+	ShadingApp::addModel and draw the meshes and textures the app owns.
+*/
+class ShadingModel
+{
+public:
+	ShadingModel(const char* name, const char* vertShader, const char* fragShader, const ShadingSettings& settings = {})
+		: name_(name), vertShader_(vertShader), fragShader_(fragShader), settings_(settings)
+	{
+	}
+
+	virtual ~ShadingModel() = default;
+
+	/// Creates the solid, wireframe and depth pipelines, a model with resources of its own creates them here as well
+	virtual void init(ShadingApp& app);
+
+	/// The common fields are filled in, lightingParams.x is the specular strength
+	virtual void updateUniforms(UniformData& uniformData) {}
+
+	/// Recorded before the mesh in the view of the model, uniformData is the address of its UniformData
+	virtual void drawBackground(lvk::ICommandBuffer& buff, uint64_t uniformData) {}
+
+	/// Recorded after the mesh and its wireframe with the mesh buffers and push constants still bound
+	virtual void drawOverlay(lvk::ICommandBuffer& buff, const MeshDraw& draw) {}
+
+	/// Extra widgets at the end of the Render Options window
+	virtual void showOptions() {}
+
+	const char* getName() const { return name_; }
+	ShadingSettings& getSettings() { return settings_; }
+	lvk::RenderPipelineHandle getSolidPipeline() const { return solidPipeline_; }
+	lvk::RenderPipelineHandle getWireframePipeline() const { return wireframePipeline_; }
+	lvk::RenderPipelineHandle getDepthPipeline() const { return depthPipeline_; }
+
+protected:
+	const char* name_ = nullptr;
+	const char* vertShader_ = nullptr;
+	const char* fragShader_ = nullptr;
+	ShadingSettings settings_;
+	lvk::Holder<lvk::RenderPipelineHandle> solidPipeline_;
+	lvk::Holder<lvk::RenderPipelineHandle> wireframePipeline_;
+	lvk::Holder<lvk::RenderPipelineHandle> depthPipeline_;
+};
+
+/*
+	Window, context, swapchain sized depth buffer, the sphere, bunny and teapot meshes, textures and the frame loop every
+	shading model shares. A project adds one or more shading models and calls run(). With several models the UI
+	switches between them, and the split view draws a number of them side by side in one render pass.
+	A headless run (headless.h) replaces the window and the swapchain with an offscreen color texture.
+
+	Command line options:
+		--depth-prepass    Start with the depth prepass on
+		--headless         Render into an offscreen texture without a window, see headless.h
+		--frames N         Frames of a headless run, 60 by default
+		--size WxH         Size of the headless frames, 1280x720 by default
+		--output FILE      Write the last headless frame to a .png or .hdr file
+		--software         Run on a software Vulkan device such as lavapipe
+		--trace FILE       Write a Chrome trace of the first frames, see frame_profiler.h
+		--benchmark        Run every model on every mesh and write frame time statistics, see frame_benchmark.h
+		--benchmark-frames N     Measured frames of each benchmark run, 240 by default
+		--benchmark-output FILE  .csv or .json file of the benchmark results, benchmark_results.csv by default
+		--camera-path FILE       Camera path of headless and benchmark runs, they circle the mesh otherwise
+		--record-camera FILE     Record the camera as a path while the app runs
+		--lights N         Start with N point lights of clustered shading, see light_clusters.h
+		--shadows          Start with the shadow maps on
+
+	The shadows are cascaded shadow maps (shadow_maps.h) of the light of the selected model, cast along its
+	lightPosition as if it were a directional light. They are drawn for the camera of the first view.
+*/
+class ShadingApp
+{
+public:
+	ShadingApp(int argc = 0, char** argv = nullptr)
+	{
+		minilog::LogConfig configInfo{};
+		configInfo.threadNames = false;
+		minilog::initialize(nullptr, configInfo);
+		parseCommandLine(argc, argv);
+
+		const lvk::HWDeviceType deviceType = headless_.softwareDevice ? lvk::HWDeviceType_Software : lvk::HWDeviceType_Discrete;
+		if (headless_.enabled)
+		{
+			// Without a window LVK creates no surface and no swapchain, GLFW is never initialized
+			width_ = (int)headless_.width;
+			height_ = (int)headless_.height;
+			ctx_ = lvk::createVulkanContextWithSwapchain(nullptr, 0, 0, {}, deviceType);
+			colorTexture_ = ctx_->createTexture(
+				{ .type = lvk::TextureType_2D,
+				  .format = getHeadlessColorFormat(headless_),
+				  .dimensions = { headless_.width, headless_.height },
+				  .usage = lvk::TextureUsageBits_Attachment | lvk::TextureUsageBits_Sampled,
+				  .debugName = "Texture: headless color" });
+		}
+		else
+		{
+			// Negative sizes are a percentage of the screen
+			width_ = -95;
+			height_ = -90;
+			window_ = lvk::initWindow("Shading", width_, height_, false);
+
+			// Context
+			ctx_ = lvk::createVulkanContextWithSwapchain(window_, width_, height_, {}, deviceType);
+
+			// UI context
+			imgui_ = std::make_unique<lvk::ImGuiRenderer>(*ctx_, window_, RESOURCE_DIR"/fonts/Terminal.ttf", 13.0f);
+
+			setMouseCallbacks();
+		}
+		createDepthTexture();
+
+		// Load up data in buffers
+		md.resize(3);
+		generateSphereBuffers(ctx_, md[0]);
+		loadMesh(ctx_, md[1], std::filesystem::absolute(RESOURCE_DIR"/models/bunny.obj"));
+		loadMesh(ctx_, md[2], std::filesystem::absolute(RESOURCE_DIR"/models/teapot.obj"));
+
+		shaderHotReload_ = std::make_unique<ShaderHotReload>(ctx_);
+	}
+
+	// Members of a derived app are gone by now, everything else has to be released before the context
+	virtual ~ShadingApp()
+	{
+		// Clear up mesh data vector
+		md.clear();
+		models_.clear();
+		instanceCuller_.reset();
+		depthPyramid_.reset();
+		lightClusters_.reset();
+		shadowMaps_.reset();
+		shadowPipeline_.reset();
+		shaderHotReload_.reset();
+		shaderModules_.clear();
+		textures_.clear();
+		profiler_.reset();
+		frameRing_.reset();
+		uniformBuffer_.reset();
+		depthTexture_.reset();
+		colorTexture_.reset();
+		imgui_.reset();
+		ctx_.reset();
+
+		if (window_)
+		{
+			glfwDestroyWindow(window_);
+			glfwTerminate();
+		}
+	}
+
+	ShadingApp(const ShadingApp&) = delete;
+	ShadingApp& operator=(const ShadingApp&) = delete;
+
+	/// Creates the pipelines and resources of model, the first model added is the one shown at startup
+	template<typename Model, typename... Args>
+	Model& addModel(Args&&... args)
+	{
+		std::unique_ptr<Model> model = std::make_unique<Model>(std::forward<Args>(args)...);
+		model->init(*this);
+
+		Model& result = *model;
+		models_.push_back(std::move(model));
+		return result;
+	}
+
+	/// 0 is the sphere, 1 the bunny and 2 the teapot
+	void selectMesh(int meshIndex) { meshDataIndex_ = meshIndex; }
+
+	/// Renders until the window is closed, or the frames of a headless run
+	int run()
+	{
+		LVK_ASSERT(!models_.empty());
+
+		// One UniformData per view, written into the frame ring or copied into a device buffer with cmdUpdateBuffer.
+		// The instances always go into the ring, there are too many of them for cmdUpdateBuffer, and so do the cull
+		// data of both occlusion culling passes, the point lights and their cluster data, and the UniformData of every
+		// shadow cascade with the ShadowData the views read. CPU and BVH culling leave only the visible instances in the
+		// ring, the shadow casters get a second copy of all of them then.
+		const size_t frameSize = kUniformDataStride * models_.size() + 2 * sizeof(Instance) * kMaxInstances + 2 * ((sizeof(InstanceCullData) + 15) & ~size_t(15)) +
+			sizeof(PointLight) * kMaxPointLights + ((sizeof(LightClusterData) + 15) & ~size_t(15)) + kUniformDataStride * kNumShadowCascades +
+			((sizeof(ShadowData) + 15) & ~size_t(15));
+		const uint32_t numFramesInFlight = headless_.enabled ? kHeadlessFramesInFlight : ctx_->getNumSwapchainImages();
+		frameRing_ = std::make_unique<FrameRingAllocator>(ctx_, frameSize, numFramesInFlight, "Buffer: per-frame ring");
+		profiler_ = std::make_unique<FrameProfiler>(ctx_, numFramesInFlight);
+		if (!traceFile_.empty())
+			profiler_->startTrace(traceFile_, headless_.enabled ? headless_.numFrames : kProfilerTraceFrames);
+		instanceCuller_ = std::make_unique<InstanceCuller>(ctx_, getShaderModule(fs::absolute(fs::path(SHADER_DIR) / "cull_instances.comp")), kMaxInstances);
+		depthPyramid_ = std::make_unique<DepthPyramid>(ctx_, getShaderModule(fs::absolute(fs::path(SHADER_DIR) / "depth_pyramid.comp")));
+		lightClusters_ = std::make_unique<LightClusters>(ctx_, getShaderModule(fs::absolute(fs::path(SHADER_DIR) / "cluster_lights.comp")));
+		shadowMaps_ = std::make_unique<ShadowMaps>(ctx_);
+		lvk::RenderPipelineDesc shadowPipelineDesc{};
+		shadowPipelineDesc.vertexInput = getVertexInput();
+		createDepthPipeline(shadowPipeline_, shadowPipelineDesc, "shadow.vert");
+		uniformBuffer_ = ctx_->createBuffer(
+			{ .usage = lvk::BufferUsageBits_Uniform,
+			  .storage = lvk::StorageType_Device,
+			  .size = kUniformDataStride * models_.size(),
+			  .debugName = "Buffer: per-frame" },
+			nullptr);
+		std::vector<uint64_t> uniformAddresses(models_.size());
+
+		// Index ranges drawn this frame
+		std::vector<DrawRange> drawRanges;
+
+		// Scripted runs follow the camera path from a file or circle the mesh at the distance of the default camera
+		cameraPath_ = CameraPath::makeOrbit(cameraTarget_, 0.35f, 0.15f, kCameraOrbitSeconds);
+		if (!cameraPathFile_.empty() && !cameraPath_.load(cameraPathFile_))
+			LLOGW("Could not load the camera path %s, circling the mesh instead\n", cameraPathFile_.c_str());
+		const bool scripted = headless_.enabled || benchmark_.enabled;
+		if (benchmark_.enabled)
+			startBenchmark();
+		float nextCameraKey = 0.0f;
+
+		double timeStamp = getSeconds();
+		bool lastFrameRing = useUniformRing_;
+		float animationSeconds = 0.0f;
+
+		// Headless runs average the CPU and GPU times of the frames after the first frames in flight, the GPU times of
+		// those are not read back yet
+		uint32_t headlessFrame = 0;
+		double headlessCpuMs = 0.0;
+		double headlessGpuMs = 0.0;
+		lvk::SubmitHandle lastSubmit;
+
+		// Render Loop
+		while (isRunning(headlessFrame))
+		{
+			if (!headless_.enabled)
+				glfwPollEvents();
+			shaderHotReload_->update();
+
+			const double newTimeStamp = getSeconds();
+			const float intervalSeconds = static_cast<float>(newTimeStamp - timeStamp);
+			const float deltaSeconds = scripted ? kFixedFrameSeconds : intervalSeconds;
+			timeStamp = newTimeStamp;
+			animationSeconds += deltaSeconds;
+
+			// Every benchmark run starts over with its model and mesh
+			if (benchmark_.enabled)
+			{
+				const BenchmarkRun& run = benchmarkRuns_[benchmarkRun_];
+				modelIndex_ = run.model;
+				meshDataIndex_ = run.mesh;
+				numViews_ = 1;
+				animationSeconds = (float)benchmarkFrame_ * kFixedFrameSeconds;
+			}
+
+			// Wall clock frame time of the path used for the last frame, scripted runs animate with a fixed step
+			frameMs_[lastFrameRing] += (intervalSeconds * 1000.0f - frameMs_[lastFrameRing]) * kFrameTimeSmoothing;
+			const bool useRing = useUniformRing_;
+			lastFrameRing = useRing;
+
+			if (!headless_.enabled)
+			{
+				glfwGetFramebufferSize(window_, &width_, &height_);
+
+				if (!width_ || !height_)
+					continue;
+
+				resizeSwapchain();
+			}
+
+			// The views split the width of the window evenly, the first one shows the selected model
+			const int numViews = std::clamp(numViews_, 1, (int)models_.size());
+			const float viewWidth = width_ / static_cast<float>(numViews);
+			if (scripted)
+			{
+				// The camera of a derived app reads the window
+				cameraPath_.evaluate(animationSeconds, cameraPosition_, cameraTarget_);
+				ShadingApp::updateCamera(deltaSeconds, viewWidth / static_cast<float>(height_));
+			}
+			else
+			{
+				updateCamera(deltaSeconds, viewWidth / static_cast<float>(height_));
+				if (!cameraRecordFile_.empty() && animationSeconds >= nextCameraKey)
+				{
+					const glm::mat4 cameraToWorld = glm::inverse(view_);
+					const glm::vec3 position(cameraToWorld[3]);
+					cameraRecording_.addKey({ .time = animationSeconds, .position = position, .target = position - glm::vec3(cameraToWorld[2]) });
+					nextCameraKey = animationSeconds + kCameraRecordInterval;
+				}
+			}
+
+			// CPU time of filling the per-frame data, recording and submitting
+			const double recordStart = getSeconds();
+			profiler_->pushCpuScope("Record");
+
+			// Command buffer
+			lvk::ICommandBuffer& buff = ctx_->acquireCommandBuffer();
+			frameRing_->beginFrame();
+			profiler_->begin(buff);
+
+			glm::vec3 meshPosition{ 0.0f, 0.0f, 0.0f };
+			// Adjust translation offset for sphere
+			if (meshDataIndex_ == 0)
+			{
+				meshPosition = glm::vec3(0.0f, 0.1f, 0.0f);
+			}
+			if (meshDataIndex_ == 2) // Move teapot behind
+			{
+				meshPosition = glm::vec3(0.0f, 0.0f, -0.075f);
+			}
+
+			model_ = glm::translate(glm::mat4(1.0f), meshPosition);
+			const float rotationSpeed = autoRotateMesh_ ? 15.0f : 0.0f;
+			const float angle = glm::radians(animationSeconds * rotationSpeed);
+			model_ = glm::rotate(model_, angle, glm::vec3(0.0f, 1.0f, 0.0f));
+
+			// Every instance of every view is drawn by one instanced draw per index range
+			const MeshData& mesh = getMesh();
+			numInstances_ = sweepCount_ ? sweepCount_ : (stressTest_ ? (uint32_t)stressInstances_ : 1);
+			uint32_t numDrawInstances = numInstances_;
+			uint64_t instanceData = 0;
+			if (numInstances_ == 1)
+			{
+				instanceData = frameRing_->push(Instance{ .model = model_ });
+			}
+			else
+			{
+				ProfilerCpuScope scope(*profiler_, "Instances");
+				fillStressInstances(instances_, numInstances_, meshPosition, angle);
+				if (instanceCulling_ == InstanceCulling_Bvh || pickRequested_)
+					updateInstanceBvh(mesh.bounds);
+				if (pickRequested_)
+					pickInstance(numViews);
+				if (pickedInstance_ < numInstances_)
+					instances_[pickedInstance_].color = glm::vec4(2.0f, 2.0f, 2.0f, 1.0f);
+
+				const FrameAllocation allocation = frameRing_->allocate(sizeof(Instance) * numInstances_);
+				instanceData = allocation.gpuAddress;
+				if (instanceCulling_ == InstanceCulling_Cpu)
+				{
+					numDrawInstances = cullInstances(instances_.data(), numInstances_, mesh.bounds, proj_ * view_, reinterpret_cast<Instance*>(allocation.ptr));
+					numVisibleInstances_ = numDrawInstances;
+				}
+				else if (instanceCulling_ == InstanceCulling_Bvh)
+				{
+					instanceBvh_.cullFrustum(proj_ * view_, visibleInstanceIndices_);
+					Instance* visible = reinterpret_cast<Instance*>(allocation.ptr);
+					for (uint32_t i : visibleInstanceIndices_)
+						*visible++ = instances_[i];
+					numDrawInstances = (uint32_t)visibleInstanceIndices_.size();
+					numVisibleInstances_ = numDrawInstances;
+				}
+				else
+				{
+					memcpy(allocation.ptr, instances_.data(), sizeof(Instance) * numInstances_);
+				}
+			}
+			const bool occlusionCulling = numInstances_ > 1 && instanceCulling_ == InstanceCulling_Occlusion;
+			const bool gpuCulling = occlusionCulling || (numInstances_ > 1 && instanceCulling_ == InstanceCulling_Gpu);
+			const uint64_t allInstances = instanceData;
+			const bool depthPrepass = depthPrepass_;
+
+			// Every view shares the camera, so the level and the culled meshlets are the same for all of them. Instances
+			// share the level of the first one, the closest row of the grid, and meshlets are only culled for one instance.
+			currentLod_ = selectLod(mesh, numInstances_ == 1 ? model_ : instances_[0].model, view_, proj_, (float)height_);
+			visibleMeshlets_ = getMeshDrawRanges(mesh, currentLod_, model_, view_, proj_, meshletCulling_ && numInstances_ == 1, drawRanges);
+			const MeshLod& lod = mesh.lods[currentLod_];
+
+			// Every view has the same image, the occlusion test looks at the first one
+			const glm::vec2 uvScale(viewWidth / (float)width_, 1.0f);
+			if (!occlusionCulling || uvScale != pyramidUvScale_)
+				pyramidValid_ = false;
+			const OcclusionPyramid lastPyramid{ .pyramid = depthPyramid_.get(), .viewProj = pyramidViewProj_, .uvScale = pyramidUvScale_ };
+
+			// The culling pass replaces the instances with the visible ones and writes the instance count of the draw. LVK
+			// stops at the first empty dependency slot, so the buffers the passes wait for are added one after another.
+			lvk::Dependencies dependencies;
+			uint32_t numBufferDependencies = 0;
+			if (gpuCulling)
+			{
+				profiler_->pushGpuScope(buff, "Cull instances");
+				instanceCuller_->cull(buff, *frameRing_, instanceData, numInstances_, mesh.bounds, drawRanges[0], proj_ * view_, pyramidValid_ ? &lastPyramid : nullptr);
+				profiler_->popGpuScope(buff);
+				instanceData = instanceCuller_->getVisibleInstances();
+				dependencies.buffers[numBufferDependencies++] = instanceCuller_->getDrawCommand();
+				dependencies.buffers[numBufferDependencies++] = instanceCuller_->getVisibleInstanceBuffer();
+			}
+
+			// Point lights move with the animation, the clusters they reach are assigned for the camera of this frame
+			const uint32_t numPointLights = (uint32_t)numPointLights_;
+			uint64_t pointLights = 0;
+			if (numPointLights)
+			{
+				fillPointLights(pointLights_, numPointLights, getPointLightArea(meshPosition), animationSeconds);
+				const FrameAllocation allocation = frameRing_->allocate(sizeof(PointLight) * numPointLights);
+				memcpy(allocation.ptr, pointLights_.data(), sizeof(PointLight) * numPointLights);
+				pointLights = allocation.gpuAddress;
+
+				profiler_->pushGpuScope(buff, "Light clusters");
+				lightClusters_->build(buff, *frameRing_, pointLights, numPointLights, view_, proj_, kCameraNear, kCameraFar);
+				profiler_->popGpuScope(buff);
+				dependencies.buffers[numBufferDependencies++] = lightClusters_->getClusterBuffer();
+			}
+
+			// Casters of every cascade from the light of the selected model, before the passes that sample them. Every
+			// instance casts, instances outside of the view still throw shadows into it.
+			uint64_t shadowData = 0;
+			if (shadows_)
+			{
+				ShadowCascade cascades[kNumShadowCascades];
+				computeShadowCascades(view_, proj_, getModel(0).getSettings().lightPosition, kCameraNear, shadowDistance_, cascades);
+				shadowData = frameRing_->push(getShadowData(cascades));
+
+				// The ring only holds the visible instances after CPU and BVH culling
+				uint64_t casters = allInstances;
+				if (numInstances_ > 1 && (instanceCulling_ == InstanceCulling_Cpu || instanceCulling_ == InstanceCulling_Bvh))
+				{
+					const FrameAllocation allocation = frameRing_->allocate(sizeof(Instance) * numInstances_);
+					memcpy(allocation.ptr, instances_.data(), sizeof(Instance) * numInstances_);
+					casters = allocation.gpuAddress;
+				}
+
+				lvk::RenderPass shadowPass;
+				shadowPass.depth.loadOp = lvk::LoadOp_Clear;
+				shadowPass.depth.clearDepth = 1.0f;
+				lvk::Framebuffer shadowFramebuffer;
+				shadowFramebuffer.depthStencil.texture = shadowMaps_->getTexture();
+
+				buff.cmdBeginRendering(shadowPass, shadowFramebuffer);
+				profiler_->pushGpuScope(buff, "Shadow cascades");
+				buff.cmdBindRenderPipeline(shadowPipeline_);
+				buff.cmdBindVertexBuffer(0, mesh.vertexBuffer);
+				buff.cmdBindIndexBuffer(mesh.indexBuffer, lvk::IndexFormat_UI32);
+				buff.cmdBindDepthState({ .compareOp = lvk::CompareOp_Less, .isDepthWriteEnabled = true });
+				// Slope scaled, the normal offset in shadow.sp takes care of the rest
+				buff.cmdSetDepthBiasEnable(true);
+				buff.cmdSetDepthBias(1.0f, 2.0f, 0.0f);
+				for (uint32_t c = 0; c != kNumShadowCascades; c++)
+				{
+					const UniformData cascadeData{ .model = model_, .view = cascades[c].view, .proj = cascades[c].proj };
+					const lvk::Viewport viewport = getShadowCascadeViewport(c);
+					buff.cmdBindViewport(viewport);
+					buff.cmdBindScissorRect({ .x = (uint32_t)viewport.x, .y = (uint32_t)viewport.y, .width = kShadowCascadeSize, .height = kShadowCascadeSize });
+					buff.cmdPushConstants(getDrawPushConstants(frameRing_->push(cascadeData), casters, mesh));
+					buff.cmdDrawIndexed(lod.indexCount, numInstances_, lod.firstIndex);
+				}
+				profiler_->popGpuScope(buff);
+				buff.cmdEndRendering();
+				dependencies.textures[0] = shadowMaps_->getTexture();
+			}
+
+			const MeshDraw meshDraw{ .lod = &lod, .numInstances = numDrawInstances, .indirectCommand = gpuCulling ? instanceCuller_->getDrawCommand() : lvk::BufferHandle{} };
+			auto drawMesh = [&](const MeshDraw& draw)
+			{
+				if (draw.indirectCommand.valid())
+				{
+					buff.cmdDrawIndexedIndirect(draw.indirectCommand, 0, 1);
+					return;
+				}
+				for (const DrawRange& range : drawRanges)
+					buff.cmdDrawIndexed(range.indexCount, draw.numInstances, range.firstIndex);
+			};
+
+			lvk::RenderPass renderPass;
+			renderPass.color[0].loadOp = lvk::LoadOp_Clear;
+			renderPass.color[0].clearColor.float32[0] = getModel(0).getSettings().clearColor.r;
+			renderPass.color[0].clearColor.float32[1] = getModel(0).getSettings().clearColor.g;
+			renderPass.color[0].clearColor.float32[2] = getModel(0).getSettings().clearColor.b;
+			renderPass.color[0].clearColor.float32[3] = 1.0f;
+			renderPass.depth.loadOp = lvk::LoadOp_Clear; // Depth
+			renderPass.depth.clearDepth = 1.0f;
+
+			// Frame buffer
+			lvk::Framebuffer framebuffer;
+			framebuffer.color[0].texture = headless_.enabled ? lvk::TextureHandle(colorTexture_) : ctx_->getCurrentSwapchainTexture();
+			framebuffer.depthStencil.texture = depthTexture_;
+
+			// Uniform version of per-frame data, the shading model fills in what is its own
+			for (int i = 0; i != numViews; i++)
+			{
+				ShadingModel& model = getModel(i);
+				const ShadingSettings& settings = model.getSettings();
+
+				UniformData uniformData{};
+				uniformData.color = glm::vec4(settings.baseColor, settings.diffuseIntensity);
+				uniformData.model = model_;
+				uniformData.proj = proj_;
+				uniformData.view = view_;
+				uniformData.ambientColor = glm::vec4(settings.ambientColor, settings.ambientStrength);
+				uniformData.lightPosition = glm::vec4(settings.lightPosition, 1.0f);
+				uniformData.cameraPosition = glm::vec4(cameraPosition_, 1.0f);
+				uniformData.lightingParams = glm::vec4(settings.specularStrength, 0.0f, 0.0f, 0.0f);
+				uniformData.clusterParams = glm::vec4(kCameraNear, getClusterSliceScale(kCameraNear, kCameraFar), 0.0f, 0.0f);
+				uniformData.numLights = numPointLights;
+				uniformData.lights = pointLights;
+				uniformData.clusters = lightClusters_->getClusters();
+				uniformData.shadowTextureId = shadowMaps_->getTexture().index();
+				uniformData.shadowSamplerId = shadowMaps_->getSampler().index();
+				uniformData.numShadowCascades = shadows_ ? kNumShadowCascades : 0;
+				uniformData.shadows = shadowData;
+				model.updateUniforms(uniformData);
+
+				if (useRing)
+				{
+					uniformAddresses[i] = frameRing_->push(uniformData);
+				}
+				else
+				{
+					buff.cmdUpdateBuffer(uniformBuffer_, i * kUniformDataStride, sizeof(uniformData), &uniformData);
+					uniformAddresses[i] = ctx_->gpuAddress(uniformBuffer_, i * kUniformDataStride);
+				}
+			}
+
+			// The mesh of every view in one of the passes of the frame
+			auto drawViews = [&](uint64_t instances, const MeshDraw& draw, ViewPass pass)
+			{
+				for (int i = 0; i != numViews; i++)
+				{
+					ShadingModel& model = getModel(i);
+					const uint64_t uniformData = uniformAddresses[i];
+
+					profiler_->pushGpuScope(buff, model.getName());
+					if (numViews > 1)
+					{
+						const int x = (int)(i * viewWidth);
+						const int nextX = (int)((i + 1) * viewWidth);
+						buff.cmdBindViewport({ .x = (float)x, .y = 0.0f, .width = (float)(nextX - x), .height = (float)height_ });
+						buff.cmdBindScissorRect({ .x = (uint32_t)x, .y = 0, .width = (uint32_t)(nextX - x), .height = (uint32_t)height_ });
+					}
+
+					// The depth state of the view before is still bound
+					if (pass == ViewPass_Color)
+					{
+						buff.cmdBindDepthState({});
+						model.drawBackground(buff, uniformData);
+					}
+
+					// Bindings
+					buff.cmdBindVertexBuffer(0, mesh.vertexBuffer);
+					buff.cmdBindIndexBuffer(mesh.indexBuffer, lvk::IndexFormat_UI32);
+					if (pass == ViewPass_Depth)
+					{
+						buff.cmdBindRenderPipeline(model.getDepthPipeline());
+						buff.cmdSetDepthBiasEnable(false);
+						buff.cmdBindDepthState({ .compareOp = lvk::CompareOp_Less, .isDepthWriteEnabled = true });
+						buff.cmdPushConstants(getDrawPushConstants(uniformData, instances, mesh));
+						drawMesh(draw);
+						profiler_->popGpuScope(buff);
+						continue;
+					}
+
+					// Bind solid pipeline. After the prepass only the nearest fragment of each pixel is shaded.
+					buff.cmdBindRenderPipeline(model.getSolidPipeline());
+					buff.cmdSetDepthBiasEnable(false);
+					if (depthPrepass && pass == ViewPass_Color)
+						buff.cmdBindDepthState({ .compareOp = lvk::CompareOp_Equal, .isDepthWriteEnabled = false });
+					else
+						buff.cmdBindDepthState({ .compareOp = lvk::CompareOp_Less, .isDepthWriteEnabled = true });
+					buff.cmdPushConstants(getDrawPushConstants(uniformData, instances, mesh));
+					drawMesh(draw);
+
+					// Bind Wireframe Pipeline
+					if (showWireframe_)
+					{
+						buff.cmdBindRenderPipeline(model.getWireframePipeline());
+						buff.cmdSetDepthBiasEnable(true);
+						buff.cmdSetDepthBias(0.0f, -1.0f, 0.0f);
+						buff.cmdBindDepthState({ .compareOp = lvk::CompareOp_Less, .isDepthWriteEnabled = true });
+						drawMesh(draw);
+					}
+
+					model.drawOverlay(buff, draw);
+					profiler_->popGpuScope(buff);
+				}
+
+				if (numViews > 1)
+				{
+					buff.cmdBindViewport({ .x = 0.0f, .y = 0.0f, .width = (float)width_, .height = (float)height_ });
+					buff.cmdBindScissorRect({ .x = 0, .y = 0, .width = (uint32_t)width_, .height = (uint32_t)height_ });
+				}
+			};
+
+			// With the depth buffer filled by the prepass, the color pass shades each pixel once
+			if (depthPrepass)
+			{
+				lvk::RenderPass prepass;
+				prepass.depth.loadOp = lvk::LoadOp_Clear;
+				prepass.depth.clearDepth = 1.0f;
+				lvk::Framebuffer prepassFramebuffer;
+				prepassFramebuffer.depthStencil.texture = depthTexture_;
+
+				buff.cmdBeginRendering(prepass, prepassFramebuffer, dependencies);
+				profiler_->pushGpuScope(buff, "Depth prepass");
+				drawViews(instanceData, meshDraw, ViewPass_Depth);
+				profiler_->popGpuScope(buff);
+				buff.cmdEndRendering();
+				renderPass.depth.loadOp = lvk::LoadOp_Load;
+			}
+
+			// Begin Rendering
+			buff.cmdBeginRendering(renderPass, framebuffer, dependencies);
+			profiler_->pushGpuScope(buff, "Render Triangle");
+			drawViews(instanceData, meshDraw, ViewPass_Color);
+			if (!occlusionCulling && !headless_.enabled)
+				showUI(framebuffer, buff);
+			profiler_->popGpuScope(buff);
+			buff.cmdEndRendering();
+
+			// The pyramid of what was just drawn decides which of the occluded instances came into view. It is also the
+			// last pyramid of the next frame, the instances drawn after it are only missing from it as occluders. They
+			// are few, so they skip the prepass and are drawn with a plain depth test.
+			if (occlusionCulling)
+			{
+				profiler_->pushGpuScope(buff, "Depth pyramid");
+				depthPyramid_->build(buff, depthTexture_);
+				profiler_->popGpuScope(buff);
+				const OcclusionPyramid pyramid{ .pyramid = depthPyramid_.get(), .viewProj = proj_ * view_, .uvScale = uvScale };
+				profiler_->pushGpuScope(buff, "Cull occluded instances");
+				instanceCuller_->cullOccluded(buff, *frameRing_, allInstances, numInstances_, mesh.bounds, drawRanges[0], pyramid);
+				profiler_->popGpuScope(buff);
+				pyramidViewProj_ = pyramid.viewProj;
+				pyramidUvScale_ = uvScale;
+				pyramidValid_ = true;
+
+				lvk::RenderPass latePass = renderPass;
+				latePass.color[0].loadOp = lvk::LoadOp_Load;
+				latePass.depth.loadOp = lvk::LoadOp_Load;
+				const lvk::Dependencies lateDependencies{ .textures = { dependencies.textures[0] },
+					.buffers = { instanceCuller_->getLateDrawCommand(), instanceCuller_->getLateVisibleInstanceBuffer() } };
+				const MeshDraw lateDraw{ .lod = &lod, .indirectCommand = instanceCuller_->getLateDrawCommand() };
+
+				buff.cmdBeginRendering(latePass, framebuffer, lateDependencies);
+				profiler_->pushGpuScope(buff, "Disoccluded instances");
+				drawViews(instanceCuller_->getLateVisibleInstances(), lateDraw, ViewPass_Late);
+				if (!headless_.enabled)
+					showUI(framebuffer, buff);
+				profiler_->popGpuScope(buff);
+				buff.cmdEndRendering();
+			}
+			profiler_->end(buff);
+
+			// Submission
+			profiler_->pushCpuScope("Submit");
+			frameRing_->flush();
+			const lvk::SubmitHandle submit = ctx_->submit(buff, headless_.enabled ? lvk::TextureHandle{} : ctx_->getCurrentSwapchainTexture());
+			frameRing_->endFrame(submit);
+			profiler_->endFrame(submit);
+			profiler_->popCpuScope();
+
+			// Waits for the frame, the GPU visibility is compared with the CPU reference
+			if (gpuCulling && validateCulling_)
+			{
+				ProfilerCpuScope scope(*profiler_, "Validate culling");
+				if (!submit.empty())
+					ctx_->wait(submit);
+				validateInstanceCulling(mesh.bounds, proj_ * view_);
+			}
+
+			profiler_->popCpuScope();
+			const float recordMs = static_cast<float>(getSeconds() - recordStart) * 1000.0f;
+			cpuMs_[useRing] += (recordMs - cpuMs_[useRing]) * kFrameTimeSmoothing;
+			// The GPU time read back is a few frames old, the first frames after a switch count towards the other mode
+			const float gpuMs = profiler_->getFrameGpuMs();
+			gpuMs_[depthPrepass] += (gpuMs - gpuMs_[depthPrepass]) * kFrameTimeSmoothing;
+			updateSweep(recordMs, gpuMs);
+			if (benchmark_.enabled)
+				addBenchmarkFrame(recordMs, gpuMs, intervalSeconds * 1000.0f);
+
+			if (headless_.enabled)
+			{
+				if (headlessFrame >= numFramesInFlight)
+				{
+					headlessCpuMs += recordMs;
+					headlessGpuMs += gpuMs;
+				}
+				headlessFrame++;
+				lastSubmit = submit;
+			}
+		}
+
+		if (benchmark_.enabled)
+			finishBenchmark();
+		if (!cameraRecordFile_.empty())
+		{
+			if (cameraRecording_.save(cameraRecordFile_))
+				LLOGL("Recorded %zu camera keys to %s\n", cameraRecording_.getKeys().size(), cameraRecordFile_.c_str());
+			else
+				LLOGW("Could not write %s\n", cameraRecordFile_.c_str());
+		}
+
+		if (headless_.enabled)
+			return finishHeadlessRun(lastSubmit, headlessFrame, headlessCpuMs, headlessGpuMs, numFramesInFlight);
+
+		profiler_->finish();
+		return EXIT_SUCCESS;
+	}
+
+	/// Fills in the shaders and the color (swapchain or headless) and depth formats of desc and creates the pipeline, the
+	/// shaders are looked up in SHADER_DIR. pipeline is rebuilt whenever one of them is edited, so it has to live as long
+	/// as the app.
+	void createPipeline(lvk::Holder<lvk::RenderPipelineHandle>& pipeline, lvk::RenderPipelineDesc desc, const char* vertShader, const char* fragShader)
+	{
+		desc.color[0].format = headless_.enabled ? ctx_->getFormat(colorTexture_) : ctx_->getSwapchainFormat();
+		createPipeline(pipeline, desc, fs::absolute(fs::path(SHADER_DIR) / vertShader), fs::absolute(fs::path(SHADER_DIR) / fragShader));
+	}
+
+	/// createPipeline() without a color attachment, for the depth prepass. vertShader has to declare gl_Position
+	/// invariant like vertex.sp does, so the color pass computes the same depth.
+	void createDepthPipeline(lvk::Holder<lvk::RenderPipelineHandle>& pipeline, lvk::RenderPipelineDesc desc, const char* vertShader)
+	{
+		createPipeline(pipeline, desc, fs::absolute(fs::path(SHADER_DIR) / vertShader), fs::absolute(fs::path(SHADER_DIR) / "depth_only.frag"));
+	}
+
+	/// Texture from RESOURCE_DIR, loaded once no matter how many models use it
+	lvk::TextureHandle getTexture(const char* name)
+	{
+		lvk::Holder<lvk::TextureHandle>& texture = textures_[name];
+		if (!texture.valid())
+			texture = loadTexture(std::filesystem::absolute(fs::path(RESOURCE_DIR) / name), ctx_);
+		return texture;
+	}
+
+	std::unique_ptr<lvk::IContext>& getContext() { return ctx_; }
+
+	/// Specialization constant 0 of the wireframe pipelines, set to 1
+	const uint32_t* getWireframeConstant() const { return &isWireframe_; }
+
+protected:
+	/// Sets view_, proj_ and cameraPosition_, by default the camera stays at cameraPosition_ looking at cameraTarget_.
+	/// Headless and benchmark runs move both along the camera path and call this one.
+	virtual void updateCamera(float deltaSeconds, float aspectRatio)
+	{
+		view_ = glm::lookAt(
+			cameraPosition_,               // camera position
+			cameraTarget_,                 // look at model
+			glm::vec3(0.0f, 1.0f, 0.0f)    // up direction
+		);
+		proj_ = glm::perspective(45.0f, aspectRatio, kCameraNear, kCameraFar);
+	}
+
+	/// Windows of their own, after the Render Options window
+	virtual void showWindows() {}
+
+	const MeshData& getMesh() const { return md[meshDataIndex_]; }
+
+	/// Model shown in view i, view 0 shows the selected one and the others follow it in the order they were added
+	ShadingModel& getModel(int i) { return *models_[(modelIndex_ + i) % models_.size()]; }
+
+	GLFWwindow* window_ = nullptr;
+	int width_ = 0;
+	int height_ = 0;
+	std::unique_ptr<lvk::IContext> ctx_;
+
+	// Matrices of the current frame
+	glm::mat4 model_ = glm::mat4(1.0f);
+	glm::mat4 view_ = glm::mat4(1.0f);
+	glm::mat4 proj_ = glm::mat4(1.0f);
+	glm::vec3 cameraPosition_ = glm::vec3(0.0f, 0.15f, 0.35f);
+	glm::vec3 cameraTarget_ = glm::vec3(0.0f, 0.1f, 0.0f);
+
+private:
+	void parseCommandLine(int argc, char** argv)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string_view arg = argv[i];
+			// Options with a value take the next argument
+			const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+			if (arg == "--depth-prepass")
+			{
+				depthPrepass_ = true;
+			}
+			else if (arg == "--headless")
+			{
+				headless_.enabled = true;
+			}
+			else if (arg == "--software")
+			{
+				headless_.softwareDevice = true;
+			}
+			else if (arg == "--frames" && value && sscanf(value, "%u", &headless_.numFrames) == 1)
+			{
+				i++;
+			}
+			else if (arg == "--size" && value && sscanf(value, "%ux%u", &headless_.width, &headless_.height) == 2 && headless_.width && headless_.height)
+			{
+				i++;
+			}
+			else if (arg == "--output" && value)
+			{
+				headless_.outputFile = value;
+				i++;
+			}
+			else if (arg == "--trace" && value)
+			{
+				traceFile_ = value;
+				i++;
+			}
+			else if (arg == "--benchmark")
+			{
+				benchmark_.enabled = true;
+			}
+			else if (arg == "--benchmark-frames" && value && sscanf(value, "%u", &benchmark_.numFrames) == 1)
+			{
+				i++;
+			}
+			else if (arg == "--benchmark-output" && value)
+			{
+				benchmark_.outputFile = value;
+				i++;
+			}
+			else if (arg == "--camera-path" && value)
+			{
+				cameraPathFile_ = value;
+				i++;
+			}
+			else if (arg == "--record-camera" && value)
+			{
+				cameraRecordFile_ = value;
+				i++;
+			}
+			else if (arg == "--lights" && value && sscanf(value, "%d", &numPointLights_) == 1)
+			{
+				numPointLights_ = std::clamp(numPointLights_, 0, (int)kMaxPointLights);
+				i++;
+			}
+			else if (arg == "--shadows")
+			{
+				shadows_ = true;
+			}
+			else
+			{
+				LLOGW("Unknown or incomplete command line option %s\n", argv[i]);
+			}
+		}
+	}
+
+	bool isRunning(uint32_t headlessFrame) const
+	{
+		if (benchmark_.enabled)
+			return benchmarkRun_ != benchmarkRuns_.size() && (headless_.enabled || !glfwWindowShouldClose(window_));
+		return headless_.enabled ? headlessFrame != headless_.numFrames : !glfwWindowShouldClose(window_);
+	}
+
+	/// One run for every model on every mesh
+	void startBenchmark()
+	{
+		for (int model = 0; model != (int)models_.size(); model++)
+			for (int mesh = 0; mesh != (int)md.size(); mesh++)
+				benchmarkRuns_.push_back({ .model = model, .mesh = mesh, .modelName = models_[model]->getName(), .meshName = kMeshNames[mesh] });
+		LLOGL("Benchmark: %zu runs of %u frames\n", benchmarkRuns_.size(), benchmark_.numFrames);
+	}
+
+	/// Times of the frame that was just submitted, the GPU time is the one of a frame in flight before it
+	void addBenchmarkFrame(float cpuMs, float gpuMs, float frameMs)
+	{
+		BenchmarkRun& run = benchmarkRuns_[benchmarkRun_];
+		if (benchmarkFrame_ >= kBenchmarkWarmupFrames)
+		{
+			run.cpuMs.push_back(cpuMs);
+			run.gpuMs.push_back(gpuMs);
+			run.frameMs.push_back(frameMs);
+		}
+		if (++benchmarkFrame_ != kBenchmarkWarmupFrames + benchmark_.numFrames)
+			return;
+
+		const FrameTimeSummary cpu = summarizeFrameTimes(run.cpuMs);
+		const FrameTimeSummary gpu = summarizeFrameTimes(run.gpuMs);
+		LLOGL("%-12s %-10s CPU %.3f ms (p99 %.3f), GPU %.3f ms (p99 %.3f)\n", run.modelName.c_str(), run.meshName.c_str(), cpu.mean, cpu.p99, gpu.mean, gpu.p99);
+		benchmarkRun_++;
+		benchmarkFrame_ = 0;
+	}
+
+	/// Writes the runs that finished
+	void finishBenchmark()
+	{
+		if (benchmarkRun_ != benchmarkRuns_.size())
+		{
+			LLOGW("Benchmark stopped after %u of %zu runs\n", benchmarkRun_, benchmarkRuns_.size());
+			benchmarkRuns_.resize(benchmarkRun_);
+		}
+		if (writeBenchmarkResults(benchmark_.outputFile, benchmarkRuns_))
+			LLOGL("Wrote benchmark results to %s\n", benchmark_.outputFile.c_str());
+		else
+			LLOGW("Could not write %s\n", benchmark_.outputFile.c_str());
+	}
+
+	static double getSeconds()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	/// Logs the average frame times of a headless run and writes its last frame
+	int finishHeadlessRun(lvk::SubmitHandle lastSubmit, uint32_t numFrames, double cpuMs, double gpuMs, uint32_t numFramesInFlight)
+	{
+		if (numFrames > numFramesInFlight)
+		{
+			const double numMeasured = double(numFrames - numFramesInFlight);
+			LLOGL("Headless %ux%u, %u frames: CPU %.3f ms, GPU %.3f ms per frame\n", headless_.width, headless_.height, numFrames,
+				cpuMs / numMeasured, gpuMs / numMeasured);
+		}
+
+		if (headless_.outputFile.empty() || !numFrames)
+		{
+			profiler_->finish();
+			return EXIT_SUCCESS;
+		}
+
+		// An empty handle would wait for the whole device
+		if (!lastSubmit.empty())
+			ctx_->wait(lastSubmit);
+		profiler_->finish();
+		return saveTextureImage(*ctx_, colorTexture_, headless_.outputFile) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	void createPipeline(lvk::Holder<lvk::RenderPipelineHandle>& pipeline, lvk::RenderPipelineDesc& desc, const fs::path& vertFile, const fs::path& fragFile)
+	{
+		desc.smVert = getShaderModule(vertFile);
+		desc.smFrag = getShaderModule(fragFile);
+		desc.depthFormat = ctx_->getFormat(depthTexture_);
+
+		pipeline = ctx_->createRenderPipeline(desc);
+		LVK_ASSERT(pipeline.valid());
+
+		shaderHotReload_->watch(pipeline, desc, vertFile, fragFile);
+	}
+
+	void setMouseCallbacks()
+	{
+		glfwSetCursorPosCallback(window_, [](auto* window, double x, double y) { ImGui::GetIO().MousePos = ImVec2((float)x, (float)y); });
+		glfwSetMouseButtonCallback(window_, [](auto* window, int button, int action, int mods) {
+			double xpos, ypos;
+			glfwGetCursorPos(window, &xpos, &ypos);
+			const ImGuiMouseButton_ imguiButton = (button == GLFW_MOUSE_BUTTON_LEFT)
+				? ImGuiMouseButton_Left
+				: (button == GLFW_MOUSE_BUTTON_RIGHT ? ImGuiMouseButton_Right : ImGuiMouseButton_Middle);
+			ImGuiIO& io = ImGui::GetIO();
+			io.MousePos = ImVec2((float)xpos, (float)ypos);
+			io.MouseDown[imguiButton] = action == GLFW_PRESS;
+			});
+	}
+
+	void createDepthTexture()
+	{
+		lvk::TextureDesc depthTextureDesc{};
+		depthTextureDesc.type = lvk::TextureType_2D;
+		depthTextureDesc.format = lvk::Format_Z_F32;
+		depthTextureDesc.dimensions = { (uint32_t)width_, (uint32_t)height_ };
+		// Sampled by the depth pyramid build
+		depthTextureDesc.usage = lvk::TextureUsageBits_Attachment | lvk::TextureUsageBits_Sampled;
+		depthTextureDesc.debugName = "Depth Buffer";
+		depthTexture_ = ctx_->createTexture(depthTextureDesc);
+
+		depthWidth_ = width_;
+		depthHeight_ = height_;
+	}
+
+	// The swapchain and the depth buffer follow the framebuffer size of the window
+	void resizeSwapchain()
+	{
+		if (width_ == depthWidth_ && height_ == depthHeight_)
+			return;
+
+		ctx_->recreateSwapchain(width_, height_);
+		createDepthTexture();
+		pyramidValid_ = false;
+	}
+
+	/// Square grid of instances that runs away from the camera, every instance spins and has a tint of its own
+	static void fillStressInstances(std::vector<Instance>& instances, uint32_t numInstances, const glm::vec3& meshPosition, float angle)
+	{
+		instances.resize(numInstances);
+		const uint32_t side = (uint32_t)std::ceil(std::sqrt((float)numInstances));
+		for (uint32_t i = 0; i != numInstances; i++)
+		{
+			const float x = ((float)(i % side) - 0.5f * (float)(side - 1)) * kInstanceSpacing;
+			const float z = -(float)(i / side) * kInstanceSpacing;
+			const glm::mat4 model = glm::translate(glm::mat4(1.0f), meshPosition + glm::vec3(x, 0.0f, z));
+			instances[i].model = glm::rotate(model, angle + (float)i, glm::vec3(0.0f, 1.0f, 0.0f));
+
+			// Golden ratio steps keep neighbouring tints apart
+			const float hue = 6.2831853f * (float)i * 0.618034f;
+			instances[i].color = glm::vec4(0.7f + 0.3f * std::cos(hue), 0.7f + 0.3f * std::cos(hue + 2.0944f), 0.7f + 0.3f * std::cos(hue + 4.1888f), 1.0f);
+		}
+	}
+
+	/// Box the point lights are scattered over, around the mesh or the grid of the stress test
+	BoundingBox getPointLightArea(const glm::vec3& meshPosition) const
+	{
+		if (numInstances_ == 1)
+			return BoundingBox(meshPosition + glm::vec3(-0.25f, -0.1f, -0.25f), meshPosition + glm::vec3(0.25f, 0.25f, 0.25f));
+
+		const float side = std::ceil(std::sqrt((float)numInstances_)) * kInstanceSpacing;
+		return BoundingBox(meshPosition + glm::vec3(-0.5f * side, -0.1f, -side), meshPosition + glm::vec3(0.5f * side, 0.25f, kInstanceSpacing));
+	}
+
+	/// Lights spread evenly over area that bob up and down, each with a tint of its own. The radius shrinks as the
+	/// count grows, so a few lights reach every point whatever the count.
+	static void fillPointLights(std::vector<PointLight>& lights, uint32_t numLights, const BoundingBox& area, float seconds)
+	{
+		lights.resize(numLights);
+		const glm::vec3 size = area.getSize();
+		const float radius = std::cbrt(size.x * size.y * size.z / (float)numLights) * 1.5f;
+		for (uint32_t i = 0; i != numLights; i++)
+		{
+			// Additive recurrence of the plastic number, a low discrepancy sequence in 3D
+			const glm::vec3 u = glm::fract(glm::vec3(0.5f) + (float)i * glm::vec3(0.8191725f, 0.6710436f, 0.5497005f));
+			lights[i].position = area.min_ + u * size;
+			lights[i].position.y += 0.1f * size.y * std::sin(2.0f * seconds + (float)i);
+			lights[i].radius = radius;
+
+			const float hue = 6.2831853f * (float)i * 0.618034f;
+			lights[i].color = glm::vec3(0.6f + 0.4f * std::cos(hue), 0.6f + 0.4f * std::cos(hue + 2.0944f), 0.6f + 0.4f * std::cos(hue + 4.1888f));
+			lights[i].intensity = 0.5f;
+		}
+	}
+
+	/// World boxes of the stress test instances into instanceBvh_, rebuilt when the count changes and refit otherwise
+	void updateInstanceBvh(const BoundingBox& bounds)
+	{
+		instanceBoxes_.resize(numInstances_);
+		for (uint32_t i = 0; i != numInstances_; i++)
+			instanceBoxes_[i] = bounds.getTransformed(instances_[i].model);
+
+		if (instanceBvh_.getNumItems() != numInstances_)
+			instanceBvh_.build(instanceBoxes_.data(), numInstances_);
+		else
+			instanceBvh_.refit(instanceBoxes_.data());
+	}
+
+	/// Picks the instance whose box the ray through pickPosition_ enters first, every view shows the same camera
+	void pickInstance(int numViews)
+	{
+		pickRequested_ = false;
+
+		const ImVec2 displaySize = ImGui::GetIO().DisplaySize;
+		const float viewWidth = displaySize.x / (float)numViews;
+		const float x = std::fmod(pickPosition_.x, viewWidth) / viewWidth;
+		// LVK flips the viewport, so NDC y points up as in OpenGL
+		const glm::vec2 ndc(2.0f * x - 1.0f, 1.0f - 2.0f * pickPosition_.y / displaySize.y);
+
+		// From the camera towards the far plane point under the cursor
+		const glm::vec3 origin = glm::vec3(glm::inverse(view_) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+		const glm::vec4 farPoint = glm::inverse(proj_ * view_) * glm::vec4(ndc, 1.0f, 1.0f);
+		const glm::vec3 dir = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+
+		const BvhRayHit hit = instanceBvh_.raycast(origin, dir);
+		pickedInstance_ = hit.item;
+		if (hit.item != ~0u)
+			LLOGL("Picked instance %u at distance %.3f\n", hit.item, hit.t);
+	}
+
+	/// Counts the instances GPU culling and cullInstances() disagree on
+	void validateInstanceCulling(const BoundingBox& bounds, const glm::mat4& viewProj)
+	{
+		std::vector<Instance> visible(numInstances_);
+		std::vector<uint32_t> visibility(numInstances_);
+		numVisibleInstances_ = cullInstances(instances_.data(), numInstances_, bounds, viewProj, visible.data(), visibility.data());
+
+		const uint32_t* gpuVisibility = instanceCuller_->getVisibility();
+		cullMismatches_ = 0;
+		for (uint32_t i = 0; i != numInstances_; i++)
+			cullMismatches_ += gpuVisibility[i] != visibility[i];
+		if (cullMismatches_)
+			LLOGW("GPU culling disagrees with the CPU on %u of %u instances\n", cullMismatches_, numInstances_);
+	}
+
+	/// Steps the instance count sweep after each frame and logs the average times of every count
+	void updateSweep(float cpuMs, float gpuMs)
+	{
+		if (!sweepCount_)
+			return;
+
+		// The GPU time of a frame is read a few frames later, the settling frames cover that too
+		if (++sweepFrame_ > kSweepFrames)
+		{
+			sweepCpuMs_ += cpuMs;
+			sweepGpuMs_ += gpuMs;
+		}
+		if (sweepFrame_ < 2 * kSweepFrames)
+			return;
+
+		LLOGL("%6u instances: CPU %.3f ms, GPU %.3f ms\n", sweepCount_, sweepCpuMs_ / kSweepFrames, sweepGpuMs_ / kSweepFrames);
+		sweepCount_ = sweepCount_ < (uint32_t)kMaxInstances ? std::min(sweepCount_ * 2, (uint32_t)kMaxInstances) : 0;
+		sweepFrame_ = 0;
+		sweepCpuMs_ = 0.0f;
+		sweepGpuMs_ = 0.0f;
+	}
+
+	lvk::ShaderModuleHandle getShaderModule(const fs::path& file)
+	{
+		lvk::Holder<lvk::ShaderModuleHandle>& module = shaderModules_[file.string()];
+		if (!module.valid())
+			module = loadShaderModule(ctx_, file);
+		return module;
+	}
+
+	/// Percentiles of every profiler scope, GPU scopes first
+	void showProfilerWindow()
+	{
+		if (ImGui::Begin("Profiler", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
+		{
+			ImGui::Text("%-34s %7s %7s %7s %7s", "ms", "last", "p50", "p95", "p99");
+			for (bool gpu : { true, false })
+			{
+				for (const ProfilerStat& stat : profiler_->getStats())
+				{
+					if (stat.gpu != gpu)
+						continue;
+					const ProfilerPercentiles percentiles = stat.getPercentiles();
+					const int indent = 2 * (int)stat.depth;
+					ImGui::Text("%s %*s%-*s %7.3f %7.3f %7.3f %7.3f", gpu ? "GPU" : "CPU", indent, "", std::max(30 - indent, 1), stat.name.c_str(), stat.lastMs,
+						percentiles.p50, percentiles.p95, percentiles.p99);
+				}
+			}
+
+			// Frame pacing
+			const ProfilerStat& interval = profiler_->getFrameIntervalStat();
+			ImGui::PlotLines("Frame interval", interval.samples, (int)interval.getNumSamples(), (int)interval.getOldestSample(), nullptr, 0.0f,
+				2.0f * interval.getPercentiles().p99, ImVec2(0.0f, 60.0f));
+
+			if (profiler_->isTracing())
+				ImGui::Text("Tracing...");
+			else if (ImGui::Button("Write Chrome Trace"))
+				profiler_->startTrace("frame_trace.json", kProfilerTraceFrames);
+		}
+		ImGui::End();
+	}
+
+	void showUI(lvk::Framebuffer& framebuff, lvk::ICommandBuffer& cmdBuff)
+	{
+		imgui_->beginFrame(framebuff);
+		ImGui::Begin("Render Options", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+		if (benchmark_.enabled && benchmarkRun_ != benchmarkRuns_.size())
+			ImGui::Text("Benchmark run %u of %zu", benchmarkRun_ + 1, benchmarkRuns_.size());
+		if (models_.size() > 1)
+		{
+			std::vector<const char*> modelNames;
+			for (const std::unique_ptr<ShadingModel>& model : models_)
+				modelNames.push_back(model->getName());
+			ImGui::Combo("Shading Model", &modelIndex_, modelNames.data(), (int)modelNames.size());
+			ImGui::SliderInt("Side by Side", &numViews_, 1, (int)models_.size());
+		}
+		ImGui::Combo("Mesh", &meshDataIndex_, kMeshNames, 3);
+		ImGui::Text("LOD %u of %u", currentLod_, (uint32_t)getMesh().lods.size() - 1);
+		ImGui::Text("Meshlets %u of %u", visibleMeshlets_, (uint32_t)getMesh().meshlets.size());
+		ImGui::Checkbox("Meshlet Culling", &meshletCulling_);
+		ImGui::Checkbox("Show Wireframe", &showWireframe_);
+		ImGui::Checkbox("Auto Rotate Mesh", &autoRotateMesh_);
+		ImGui::Checkbox("Uniform Frame Ring", &useUniformRing_);
+		ImGui::Text("cmdUpdateBuffer: frame %.2f ms, CPU %.3f ms", frameMs_[0], cpuMs_[0]);
+		ImGui::Text("Frame ring:      frame %.2f ms, CPU %.3f ms", frameMs_[1], cpuMs_[1]);
+		ImGui::Checkbox("Depth Prepass", &depthPrepass_);
+		ImGui::Text("GPU %.3f ms, with depth prepass %.3f ms", gpuMs_[0], gpuMs_[1]);
+		ImGui::SliderInt("Point Lights", &numPointLights_, 0, (int)kMaxPointLights, "%d", ImGuiSliderFlags_Logarithmic);
+		ImGui::Checkbox("Shadows", &shadows_);
+		if (shadows_)
+			ImGui::SliderFloat("Shadow Distance", &shadowDistance_, 1.0f, 100.0f, "%.1f", ImGuiSliderFlags_Logarithmic);
+		ImGui::Checkbox("Instance Stress Test", &stressTest_);
+		if (stressTest_)
+		{
+			static const char* cullingNames[] =
+			{
+				"Off",
+				"CPU",
+				"GPU",
+				"BVH",
+				"GPU + HiZ"
+			};
+
+			ImGui::SliderInt("Instances", &stressInstances_, 1, kMaxInstances, "%d", ImGuiSliderFlags_Logarithmic);
+			ImGui::Combo("Instance Culling", &instanceCulling_, cullingNames, 5);
+			// Occlusion does not change the frustum visibility the GPU reports
+			const bool gpuCulling = instanceCulling_ == InstanceCulling_Gpu || instanceCulling_ == InstanceCulling_Occlusion;
+			if (gpuCulling)
+				ImGui::Checkbox("Validate GPU Culling", &validateCulling_);
+			if (instanceCulling_ == InstanceCulling_Cpu || instanceCulling_ == InstanceCulling_Bvh || (gpuCulling && validateCulling_))
+				ImGui::Text("Visible instances %u of %u", numVisibleInstances_, numInstances_);
+			if (gpuCulling && validateCulling_)
+				ImGui::Text("GPU/CPU mismatches %u", cullMismatches_);
+			if (pickedInstance_ < numInstances_)
+				ImGui::Text("Picked instance %u", pickedInstance_);
+			else
+				ImGui::Text("Right click picks an instance");
+
+			// Picked at the start of the next frame, with the matrices and instances of that frame
+			const ImGuiIO& io = ImGui::GetIO();
+			if (numInstances_ > 1 && !io.WantCaptureMouse && ImGui::IsMouseClicked(ImGuiMouseButton_Right))
+			{
+				pickRequested_ = true;
+				pickPosition_ = glm::vec2(io.MousePos.x, io.MousePos.y);
+			}
+
+			if (sweepCount_)
+				ImGui::Text("Sweeping %u instances", sweepCount_);
+			else if (ImGui::Button("Sweep Instance Counts"))
+				sweepCount_ = 1;
+		}
+
+		// Settings of the selected model
+		ShadingModel& model = getModel(0);
+		ShadingSettings& settings = model.getSettings();
+		ImGui::ColorEdit3("Base Color", glm::value_ptr(settings.baseColor));
+		ImGui::SliderFloat("Diffuse/Base Color Intensity", &settings.diffuseIntensity, 0.0f, 10.0f);
+		ImGui::ColorEdit3("Light Color", glm::value_ptr(settings.ambientColor));
+		ImGui::SliderFloat("Ambient Strength", &settings.ambientStrength, 0.0f, 1.0f);
+		ImGui::DragFloat3("Light Position", glm::value_ptr(settings.lightPosition));
+		ImGui::SliderFloat("Specular Strength", &settings.specularStrength, 0.0f, 1.0f);
+		model.showOptions();
+		ImGui::End();
+		showProfilerWindow();
+		showWindows();
+		profiler_->pushGpuScope(cmdBuff, "UI");
+		imgui_->endFrame(cmdBuff);
+		profiler_->popGpuScope(cmdBuff);
+	}
+
+	std::unique_ptr<lvk::ImGuiRenderer> imgui_;
+	std::unique_ptr<ShaderHotReload> shaderHotReload_;
+	std::unordered_map<std::string, lvk::Holder<lvk::ShaderModuleHandle>> shaderModules_;
+	std::unordered_map<std::string, lvk::Holder<lvk::TextureHandle>> textures_;
+	std::vector<std::unique_ptr<ShadingModel>> models_;
+	lvk::Holder<lvk::TextureHandle> depthTexture_;
+	// Color target of headless runs, in place of the swapchain
+	HeadlessOptions headless_;
+	lvk::Holder<lvk::TextureHandle> colorTexture_;
+	int depthWidth_ = 0;
+	int depthHeight_ = 0;
+	std::unique_ptr<FrameRingAllocator> frameRing_;
+	std::unique_ptr<FrameProfiler> profiler_;
+	std::string traceFile_;
+	// Camera of headless and benchmark runs, and the recording of the live camera
+	CameraPath cameraPath_;
+	std::string cameraPathFile_;
+	CameraPath cameraRecording_;
+	std::string cameraRecordFile_;
+	BenchmarkOptions benchmark_;
+	std::vector<BenchmarkRun> benchmarkRuns_;
+	uint32_t benchmarkRun_ = 0;
+	uint32_t benchmarkFrame_ = 0;
+	std::unique_ptr<InstanceCuller> instanceCuller_;
+	// Built after the first pass of occlusion culling, the next frame tests against it with the matrix it was drawn with
+	std::unique_ptr<DepthPyramid> depthPyramid_;
+	glm::mat4 pyramidViewProj_ = glm::mat4(1.0f);
+	glm::vec2 pyramidUvScale_ = glm::vec2(0.0f);
+	bool pyramidValid_ = false;
+	// Point lights of clustered shading and their assignment to the clusters
+	std::unique_ptr<LightClusters> lightClusters_;
+	std::vector<PointLight> pointLights_;
+	// Cascaded shadow maps of the light of the selected model
+	std::unique_ptr<ShadowMaps> shadowMaps_;
+	lvk::Holder<lvk::RenderPipelineHandle> shadowPipeline_;
+	// Instances of the stress test, copied or culled into the frame ring
+	std::vector<Instance> instances_;
+	// World boxes of the instances and their hierarchy, for BVH culling and picking
+	std::vector<BoundingBox> instanceBoxes_;
+	std::vector<uint32_t> visibleInstanceIndices_;
+	Bvh instanceBvh_;
+	lvk::Holder<lvk::BufferHandle> uniformBuffer_;
+	uint32_t isWireframe_ = 1;
+
+	// Render options
+	int modelIndex_ = 0;
+	int numViews_ = 1;
+	int meshDataIndex_ = 0;
+	bool meshletCulling_ = true;
+	bool showWireframe_ = false;
+	bool autoRotateMesh_ = true;
+	bool useUniformRing_ = true;
+	bool depthPrepass_ = false;
+	int numPointLights_ = 0;
+	bool shadows_ = false;
+	float shadowDistance_ = kShadowDistance;
+	bool stressTest_ = false;
+	int stressInstances_ = 1024;
+	int instanceCulling_ = InstanceCulling_Gpu;
+	bool validateCulling_ = false;
+	uint32_t numInstances_ = 1;
+	uint32_t numVisibleInstances_ = 0;
+	uint32_t cullMismatches_ = 0;
+	uint32_t pickedInstance_ = ~0u;
+	bool pickRequested_ = false;
+	glm::vec2 pickPosition_ = glm::vec2(0.0f);
+	uint32_t currentLod_ = 0;
+	uint32_t visibleMeshlets_ = 0;
+
+	// Instance count being measured by the sweep, 0 when there is none
+	uint32_t sweepCount_ = 0;
+	int sweepFrame_ = 0;
+	float sweepCpuMs_ = 0.0f;
+	float sweepGpuMs_ = 0.0f;
+
+	// Smoothed frame and CPU recording times, [0] with cmdUpdateBuffer and [1] with the frame ring
+	float frameMs_[2] = {};
+	float cpuMs_[2] = {};
+	// Smoothed GPU time of the frame, [0] without the depth prepass and [1] with it
+	float gpuMs_[2] = {};
+};
+
+inline void ShadingModel::init(ShadingApp& app)
+{
+	// Solid pipeline
+	lvk::RenderPipelineDesc pipelineDesc{};
+	pipelineDesc.vertexInput = getVertexInput();
+	app.createPipeline(solidPipeline_, pipelineDesc, vertShader_, fragShader_);
+
+	// Wireframe pipeline
+	lvk::RenderPipelineDesc wireframePipelineDesc{};
+	wireframePipelineDesc.vertexInput = getVertexInput();
+	wireframePipelineDesc.polygonMode = lvk::PolygonMode_Line;
+	wireframePipelineDesc.specInfo.entries[0] = { .constantId = 0, .size = sizeof(uint32_t) };
+	wireframePipelineDesc.specInfo.data = app.getWireframeConstant();
+	wireframePipelineDesc.specInfo.dataSize = sizeof(uint32_t);
+	app.createPipeline(wireframePipeline_, wireframePipelineDesc, vertShader_, fragShader_);
+
+	// Depth prepass pipeline
+	lvk::RenderPipelineDesc depthPipelineDesc{};
+	depthPipelineDesc.vertexInput = getVertexInput();
+	app.createDepthPipeline(depthPipeline_, depthPipelineDesc, vertShader_);
+}
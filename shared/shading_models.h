@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+
+#include "shading_app.h"
+#include "ibl_baker.h"
+
+/*
+	Shading models with more than a pair of shaders. Phong, Gouraud and Flat-Phong are a plain ShadingModel.
+*/
+
+/// PS1 style vertex snapping to a low resolution grid
+class PsxModel : public ShadingModel
+{
+public:
+	PsxModel() : ShadingModel("PSX", "psx.vert", "psx.frag",
+		{ .baseColor = glm::vec3(0.5f, 0.5f, 0.3f), .diffuseIntensity = 1.5f, .ambientStrength = 0.35f, .specularStrength = 0.0f })
+	{
+	}
+
+	void init(ShadingApp& app) override
+	{
+		ShadingModel::init(app);
+		gridTexture_ = app.getTexture("textures/grid.png");
+	}
+
+	void updateUniforms(UniformData& uniformData) override
+	{
+		uniformData.lightingParams = glm::vec4(settings_.specularStrength, resolutionGrid_[0], resolutionGrid_[1], 0.0f);
+		uniformData.textureId = gridTexture_.index();
+	}
+
+	void showOptions() override
+	{
+		if (ImGui::InputFloat2("PSX-Snap Resolution", resolutionGrid_))
+		{
+			resolutionGrid_[0] = std::max(resolutionGrid_[0], 0.1f);
+			resolutionGrid_[1] = std::max(resolutionGrid_[1], 0.1f);
+		}
+	}
+
+private:
+	lvk::TextureHandle gridTexture_;
+	float resolutionGrid_[2] = { 320.0f, 240.0f };
+};
+
+/// Banded diffuse with rim light and an inverted hull outline
+class ToonModel : public ShadingModel
+{
+public:
+	ToonModel() : ShadingModel("Toon", "toon.vert", "toon.frag",
+		{ .baseColor = glm::vec3(0.8f, 0.5f, 0.0f), .ambientStrength = 0.35f, .specularStrength = 0.0f, .clearColor = glm::vec3(0.8f) })
+	{
+	}
+
+	void init(ShadingApp& app) override
+	{
+		ShadingModel::init(app);
+		patternTexture_ = app.getTexture("textures/grid.png");
+
+		// Outline pipeline
+		lvk::RenderPipelineDesc outlinePipelineDesc{};
+		outlinePipelineDesc.vertexInput = getVertexInput();
+		outlinePipelineDesc.cullMode = lvk::CullMode_Front; // Cull mode front so we only see back faces of our duplicate outline mesh
+		app.createPipeline(outlinePipeline_, outlinePipelineDesc, "outline.vert", "outline.frag");
+	}
+
+	void updateUniforms(UniformData& uniformData) override
+	{
+		uniformData.lightingParams = glm::vec4(settings_.specularStrength, (float)toonColorLevels_, rimLightPower_, outlineThickness_);
+		uniformData.textureId = patternTexture_.index();
+	}
+
+	void drawOverlay(lvk::ICommandBuffer& buff, const MeshDraw& draw) override
+	{
+		// Bind outline pipeline
+		if (showOutline_)
+		{
+			buff.cmdBindRenderPipeline(outlinePipeline_);
+			buff.cmdSetDepthBiasEnable(false);
+			buff.cmdBindDepthState({ .compareOp = lvk::CompareOp_LessEqual, .isDepthWriteEnabled = false });
+			// Back facing meshlets are what the outline shows, so it draws the whole level
+			draw.drawLevel(buff);
+		}
+	}
+
+	void showOptions() override
+	{
+		ImGui::Checkbox("Show Outline", &showOutline_);
+		ImGui::SliderFloat("Outline Thickness", &outlineThickness_, 0.001f, 0.015f);
+		ImGui::SliderInt("Toon Color Levels", &toonColorLevels_, 1, 10);
+		ImGui::SliderFloat("Rim Light Power", &rimLightPower_, 0.0f, 10.0f);
+	}
+
+private:
+	lvk::TextureHandle patternTexture_;
+	lvk::Holder<lvk::RenderPipelineHandle> outlinePipeline_;
+	bool showOutline_ = true;
+	float outlineThickness_ = 0.002f;
+	int toonColorLevels_ = 3;
+	float rimLightPower_ = 4.0f;
+};
+
+/// Phong shaded mesh in front of an HDR environment, the background can show the baked irradiance and specular maps
+class SkyboxModel : public ShadingModel
+{
+public:
+	SkyboxModel() : ShadingModel("Skybox", "phong.vert", "phong.frag")
+	{
+	}
+
+	void init(ShadingApp& app) override
+	{
+		ShadingModel::init(app);
+
+		cubemapTexture_ = loadCubemap(std::filesystem::absolute(RESOURCE_DIR"/textures/dusk.hdr"), app.getContext());
+		ibl_ = loadIBL(std::filesystem::absolute(RESOURCE_DIR"/textures/dusk.hdr"), app.getContext());
+
+		// The default sampler has mip-mapping disabled
+		cubemapSampler_ = app.getContext()->createSampler({
+			.mipMap = lvk::SamplerMip_Linear,
+			.wrapU = lvk::SamplerWrap_Clamp,
+			.wrapV = lvk::SamplerWrap_Clamp,
+			.wrapW = lvk::SamplerWrap_Clamp,
+			.debugName = "Sampler: cubemap" });
+
+		// Skybox pipeline
+		app.createPipeline(skyboxPipeline_, {}, "skybox.vert", "skybox.frag");
+	}
+
+	void updateUniforms(UniformData& uniformData) override
+	{
+		uniformData.samplerId = cubemapSampler_.index();
+		// Skybox reads the background mip level from lightingParams.y
+		if (backgroundIndex_ == 1)
+		{
+			uniformData.textureId = ibl_.irradiance.index();
+		}
+		else if (backgroundIndex_ == 2)
+		{
+			uniformData.textureId = ibl_.prefilteredSpecular.index();
+			uniformData.lightingParams.y = backgroundRoughness_ * float(ibl_.numSpecularMips - 1);
+		}
+		else
+		{
+			uniformData.textureId = cubemapTexture_.index();
+		}
+	}
+
+	// First render skybox
+	void drawBackground(lvk::ICommandBuffer& buff, uint64_t uniformData) override
+	{
+		buff.cmdBindRenderPipeline(skyboxPipeline_);
+		buff.cmdPushConstants(uniformData);
+		buff.cmdDraw(36);
+	}
+
+	void showOptions() override
+	{
+		static const char* backgroundNames[] =
+		{
+			"Environment",
+			"Irradiance",
+			"Prefiltered Specular"
+		};
+
+		ImGui::Combo("Background", &backgroundIndex_, backgroundNames, 3);
+		if (backgroundIndex_ == 2)
+		{
+			ImGui::SliderFloat("Background Roughness", &backgroundRoughness_, 0.0f, 1.0f);
+		}
+	}
+
+private:
+	lvk::Holder<lvk::TextureHandle> cubemapTexture_;
+	IBLTextures ibl_;
+	lvk::Holder<lvk::SamplerHandle> cubemapSampler_;
+	lvk::Holder<lvk::RenderPipelineHandle> skyboxPipeline_;
+	int backgroundIndex_ = 0;
+	float backgroundRoughness_ = 0.5f;
+};
+
+/// Every shading model, the order of the Shading Model combo of the gallery
+inline void addAllShadingModels(ShadingApp& app)
+{
+	app.addModel<ShadingModel>("Phong", "phong.vert", "phong.frag");
+	app.addModel<ShadingModel>("Gouraud", "gouraud.vert", "gouraud.frag", ShadingSettings{ .baseColor = glm::vec3(0.8f, 0.6f, 0.3f) });
+	app.addModel<ShadingModel>("Flat-Phong", "flat_phong.vert", "flat_phong.frag", ShadingSettings{ .baseColor = glm::vec3(0.8f, 0.5f, 0.5f) });
+	app.addModel<ToonModel>();
+	app.addModel<PsxModel>();
+	app.addModel<SkyboxModel>();
+}
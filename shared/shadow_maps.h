@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+
+#include <lvk/LVK.h>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#include "utils_math.h"
+
+/*
+	Cascaded shadow maps of the main light. The light is far away compared to the meshes, so its shadows are cast
+	along lightPosition like those of a directional light. The view frustum up to the shadow distance is split into
+	cascades, a near one covers a short slice in detail and far ones long slices coarsely. Each cascade is an
+	orthographic projection from the light around the bounding sphere of its slice, rendered side by side into a
+	depth atlas. Fragments pick the first cascade whose slice reaches past their view depth and filter a few compare
+	taps (PCF).
+
+	The sphere of a slice only depends on the projection and the split depths, so the size of a texel stays the same
+	while the camera turns, and the projection only moves in whole texels. Shadow edges stay put instead of shimmering
+	as the camera moves. computeShadowCascades() is cheap enough to run every frame, shadow.sp reads what it computes.
+*/
+
+// Cascades of the atlas, matches kNumShadowCascades in shadow.sp
+static constexpr uint32_t kNumShadowCascades = 4;
+
+// Texels along each side of a cascade. The atlas is a row of cascades, LVK flips viewports vertically around their
+// height so they are only ever offset in x.
+static constexpr uint32_t kShadowCascadeSize = 1024;
+static constexpr uint32_t kShadowAtlasWidth = kNumShadowCascades * kShadowCascadeSize;
+static constexpr uint32_t kShadowAtlasHeight = kShadowCascadeSize;
+
+// Casters this far beyond a cascade sphere towards the light still cast into it
+static constexpr float kShadowCasterDistance = 4.0f;
+
+// Blend between uniform (0) and logarithmic (1) split depths
+static constexpr float kShadowSplitLambda = 0.95f;
+
+/// One cascade, view looks from the light and proj covers the slice
+struct ShadowCascade
+{
+	glm::mat4 view = glm::mat4(1.0f);
+	glm::mat4 proj = glm::mat4(1.0f);
+	float splitDepth = 0.0f; // View space depth where the slice of the cascade ends
+	float texelSize = 0.0f; // World size of a texel
+	glm::vec3 center = glm::vec3(0.0f); // World bounding sphere of the slice
+	float radius = 0.0f;
+};
+
+/// Matches ShadowData in shadow.sp
+struct ShadowData
+{
+	glm::mat4 viewProj[kNumShadowCascades];
+	glm::vec4 splitDepths = glm::vec4(0.0f);
+	glm::vec4 texelSizes = glm::vec4(0.0f);
+};
+
+/// Depths where the slices end, between the uniform and the logarithmic split of zNear to shadowDistance
+inline void getShadowSplitDepths(float zNear, float shadowDistance, float lambda, float* outSplits)
+{
+	for (uint32_t i = 0; i != kNumShadowCascades; i++)
+	{
+		const float p = (float)(i + 1) / (float)kNumShadowCascades;
+		const float logSplit = zNear * std::pow(shadowDistance / zNear, p);
+		const float uniformSplit = zNear + (shadowDistance - zNear) * p;
+		outSplits[i] = uniformSplit + (logSplit - uniformSplit) * lambda;
+	}
+}
+
+/// Rotation of the light, looking against lightDirection which points towards the light
+inline glm::mat4 getShadowLightView(const glm::vec3& lightDirection)
+{
+	const glm::vec3 up = std::abs(lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	return glm::lookAt(glm::vec3(0.0f), -lightDirection, up);
+}
+
+/// Fits every cascade to its slice of the frustum of view and the perspective proj, from zNear to shadowDistance
+inline void computeShadowCascades(const glm::mat4& view, const glm::mat4& proj, const glm::vec3& lightDirection, float zNear, float shadowDistance,
+	ShadowCascade* outCascades)
+{
+	// View space corners of the far plane, the corners of every slice lie on the rays from the eye through them. The far
+	// plane is at NDC z = 1 with either depth range.
+	glm::vec4 corners[8];
+	getFrustumCorners(proj, corners);
+	const float farDepth = -corners[4].z;
+
+	float splits[kNumShadowCascades];
+	getShadowSplitDepths(zNear, shadowDistance, kShadowSplitLambda, splits);
+
+	const glm::mat4 invView = glm::inverse(view);
+	const glm::mat4 lightView = getShadowLightView(glm::normalize(lightDirection));
+	float sliceBegin = zNear;
+	for (uint32_t c = 0; c != kNumShadowCascades; c++)
+	{
+		glm::vec3 sliceCorners[8];
+		glm::vec3 center(0.0f);
+		for (uint32_t k = 0; k != 4; k++)
+		{
+			const glm::vec3 dir = glm::vec3(corners[4 + k]) / farDepth;
+			sliceCorners[2 * k] = dir * sliceBegin;
+			sliceCorners[2 * k + 1] = dir * splits[c];
+			center += sliceCorners[2 * k] + sliceCorners[2 * k + 1];
+		}
+		center /= 8.0f;
+		float radius = 0.0f;
+		for (const glm::vec3& corner : sliceCorners)
+			radius = std::max(radius, glm::length(corner - center));
+
+		// Whole texel steps of the projection across the light view
+		const float texelSize = 2.0f * radius / (float)kShadowCascadeSize;
+		const glm::vec3 worldCenter = glm::vec3(invView * glm::vec4(center, 1.0f));
+		glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(worldCenter, 1.0f));
+		lightCenter.x = std::floor(lightCenter.x / texelSize) * texelSize;
+		lightCenter.y = std::floor(lightCenter.y / texelSize) * texelSize;
+
+		ShadowCascade& cascade = outCascades[c];
+		cascade.view = lightView;
+		// Depth from 0 to 1 whatever the depth range of the camera is, shadow.sp compares against it as it is
+		cascade.proj = glm::orthoRH_ZO(lightCenter.x - radius, lightCenter.x + radius, lightCenter.y - radius, lightCenter.y + radius,
+			-lightCenter.z - radius - kShadowCasterDistance, -lightCenter.z + radius);
+		cascade.splitDepth = splits[c];
+		cascade.texelSize = texelSize;
+		cascade.center = worldCenter;
+		cascade.radius = radius;
+		sliceBegin = splits[c];
+	}
+}
+
+inline ShadowData getShadowData(const ShadowCascade* cascades)
+{
+	ShadowData data;
+	for (uint32_t c = 0; c != kNumShadowCascades; c++)
+	{
+		data.viewProj[c] = cascades[c].proj * cascades[c].view;
+		data.splitDepths[c] = cascades[c].splitDepth;
+		data.texelSizes[c] = cascades[c].texelSize;
+	}
+	return data;
+}
+
+/// Viewport of a cascade, its square of the atlas
+inline lvk::Viewport getShadowCascadeViewport(uint32_t cascade)
+{
+	return { .x = (float)(cascade * kShadowCascadeSize), .y = 0.0f, .width = (float)kShadowCascadeSize, .height = (float)kShadowCascadeSize };
+}
+
+/*
+	Depth atlas of the cascades and the compare sampler the shaders filter it with. The app renders the casters into it
+	before the color pass, which lists the atlas as a dependency.
+*/
+class ShadowMaps
+{
+public:
+	explicit ShadowMaps(std::unique_ptr<lvk::IContext>& ctx)
+	{
+		atlas_ = ctx->createTexture(
+			{ .type = lvk::TextureType_2D,
+			  .format = lvk::Format_Z_F32,
+			  .dimensions = { kShadowAtlasWidth, kShadowAtlasHeight },
+			  .usage = lvk::TextureUsageBits_Attachment | lvk::TextureUsageBits_Sampled,
+			  .debugName = "Texture: shadow atlas" });
+		// Lit where the fragment is no farther from the light than the nearest caster
+		sampler_ = ctx->createSampler(
+			{ .wrapU = lvk::SamplerWrap_Clamp,
+			  .wrapV = lvk::SamplerWrap_Clamp,
+			  .depthCompareOp = lvk::CompareOp_LessEqual,
+			  .depthCompareEnabled = true,
+			  .debugName = "Sampler: shadow" });
+	}
+
+	ShadowMaps(const ShadowMaps&) = delete;
+	ShadowMaps& operator=(const ShadowMaps&) = delete;
+
+	lvk::TextureHandle getTexture() const { return atlas_; }
+	lvk::SamplerHandle getSampler() const { return sampler_; }
+
+private:
+	lvk::Holder<lvk::TextureHandle> atlas_;
+	lvk::Holder<lvk::SamplerHandle> sampler_;
+};
@@ -1,13 +1,14 @@
 #pragma once
 
+#include <cassert>
 #include <cstdio>
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 
-#include "Bitmap.h"
+#include "bitmap.h"
 #include "utils_math.h"
-
-#include "stb_image_resize2.h"
+#include "utils_parallel.h"
+#include "utils_simd.h"
 
 namespace cubemap
 {
@@ -17,7 +18,7 @@ namespace cubemap
 	using glm::ivec2;
 
 	/// From Henry J. Warren's "Hacker's Delight"
-	float radicalInverse_VdC(uint32_t bits)
+	inline float radicalInverse_VdC(uint32_t bits)
 	{
 		bits = (bits << 16u) | (bits >> 16u);
 		bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
@@ -31,106 +32,12 @@ namespace cubemap
 
 	/// From http://holger.dammertz.org/stuff/notes_HammersleyOnHemisphere.html
 
-	vec2 hammersley2d(uint32_t i, uint32_t N)
+	inline vec2 hammersley2d(uint32_t i, uint32_t N)
 	{
 		return vec2(float(i) / float(N), radicalInverse_VdC(i));
 	}
 
-	void convolveLambertian(const vec3* data, int srcW, int srcH, int dstW, int dstH, vec3* output, int numMonteCarloSamples)
-	{
-		// only equirectangular maps are supported
-		assert(srcW == 2 * srcH);
-
-		if (srcW != 2 * srcH) return;
-
-		std::vector<vec3> tmp(dstW * dstH);
-
-		stbir_resize(
-			reinterpret_cast<const float*>(data), srcW, srcH, 0, reinterpret_cast<float*>(tmp.data()), dstW, dstH, 0, STBIR_RGB, STBIR_TYPE_FLOAT,
-			STBIR_EDGE_WRAP, STBIR_FILTER_CUBICBSPLINE);
-
-		const vec3* scratch = tmp.data();
-		srcW = dstW;
-		srcH = dstH;
-
-		for (int y = 0; y != dstH; y++)
-		{
-			printf("Line %i...\n", y);
-			const float theta1 = float(y) / float(dstH) * Math::PI;
-			for (int x = 0; x != dstW; x++)
-			{
-				const float phi1 = float(x) / float(dstW) * Math::TWOPI;
-				const vec3 V1 = vec3(sin(theta1) * cos(phi1), sin(theta1) * sin(phi1), cos(theta1));
-				vec3 color = vec3(0.0f);
-				float weight = 0.0f;
-				for (int i = 0; i != numMonteCarloSamples; i++)
-				{
-					const vec2 h = hammersley2d(i, numMonteCarloSamples);
-					const int x1 = int(floor(h.x * srcW));
-					const int y1 = int(floor(h.y * srcH));
-					const float theta2 = float(y1) / float(srcH) * Math::PI;
-					const float phi2 = float(x1) / float(srcW) * Math::TWOPI;
-					const vec3 V2 = vec3(sin(theta2) * cos(phi2), sin(theta2) * sin(phi2), cos(theta2));
-					const float D = std::max(0.0f, glm::dot(V1, V2));
-					if (D > 0.01f)
-					{
-						color += scratch[y1 * srcW + x1] * D;
-						weight += D;
-					}
-				}
-				output[y * dstW + x] = color / weight;
-			}
-		}
-	}
-
-	void convolveGGX(const vec3* data, int srcW, int srcH, int dstW, int dstH, vec3* output, int numMonteCarloSamples)
-	{
-		// only equirectangular maps are supported
-		assert(srcW == 2 * srcH);
-
-		if (srcW != 2 * srcH)
-			return;
-
-		std::vector<vec3> tmp(dstW * dstH);
-
-		stbir_resize(
-			reinterpret_cast<const float*>(data), srcW, srcH, 0, reinterpret_cast<float*>(tmp.data()), dstW, dstH, 0, STBIR_RGB, STBIR_TYPE_FLOAT,
-			STBIR_EDGE_WRAP, STBIR_FILTER_CUBICBSPLINE);
-
-		const vec3* scratch = tmp.data();
-		srcW = dstW;
-		srcH = dstH;
-
-		for (int y = 0; y != dstH; y++) {
-			printf("Line %i...\n", y);
-			const float theta1 = float(y) / float(dstH) * Math::PI;
-			for (int x = 0; x != dstW; x++) {
-				const float phi1 = float(x) / float(dstW) * Math::TWOPI;
-				const vec3 V1 = vec3(sin(theta1) * cos(phi1), sin(theta1) * sin(phi1), cos(theta1));
-				vec3 color = vec3(0.0f);
-				float weight = 0.0f;
-				for (int i = 0; i != numMonteCarloSamples; i++) {
-					const vec2 h = hammersley2d(i, numMonteCarloSamples);
-					const int x1 = int(floor(h.x * srcW));
-					const int y1 = int(floor(h.y * srcH));
-
-
-					const float theta2 = float(y1) / float(srcH) * Math::PI;
-					const float phi2 = float(x1) / float(srcW) * Math::TWOPI;
-					const vec3 V2 = vec3(sin(theta2) * cos(phi2), sin(theta2) * sin(phi2), cos(theta2));
-					const float D = std::max(0.0f, glm::dot(V1, V2));
-					if (D > 0.01f) {
-						color += scratch[y1 * srcW + x1] * D;
-						weight += D;
-					}
-				}
-				output[y * dstW + x] = color / weight;
-			}
-		}
-	}
-
-
-	vec3 faceCoordsToXYZ(int i, int j, int faceID, int faceSize)
+	inline vec3 faceCoordsToXYZ(int i, int j, int faceID, int faceSize)
 	{
 		const float A = 2.0f * float(i) / faceSize;
 		const float B = 2.0f * float(j) / faceSize;
@@ -145,7 +52,7 @@ namespace cubemap
 		return vec3();
 	}
 
-	Bitmap convertEquirectangularMapToVerticalCross(const Bitmap& b)
+	inline Bitmap convertEquirectangularMapToVerticalCross(const Bitmap& b)
 	{
 		if (b.type_ != eBitmapType_2D) return Bitmap();
 
@@ -205,7 +112,7 @@ namespace cubemap
 		return result;
 	}
 
-	Bitmap convertVerticalCrossToCubeMapFaces(const Bitmap& b)
+	inline Bitmap convertVerticalCrossToCubeMapFaces(const Bitmap& b)
 	{
 		const int faceWidth = b.w_ / 3;
 		const int faceHeight = b.h_ / 4;
@@ -284,7 +191,362 @@ namespace cubemap
 		return cubemap;
 	}
 
-	Bitmap convertEquirectangularMapToCubeMapFaces(const Bitmap& b) {
-		return convertVerticalCrossToCubeMapFaces(convertEquirectangularMapToVerticalCross(b));
+	/// Face stored by convertEquirectangularMapToCubeMapFaces() (+X, -X, +Y, -Y, +Z, -Z) -> faceID of faceCoordsToXYZ().
+	/// Same layout as going through the vertical cross, -Z is rotated by 180 degrees.
+	static constexpr int kCubeFaceToCrossFace[6] = { 3, 1, 4, 5, 2, 0 };
+
+	/// Direction of texel (x, y) of a face stored by convertEquirectangularMapToCubeMapFaces()
+	inline vec3 cubeFaceTexelToDirection(int face, int x, int y, int faceSize)
+	{
+		// -Z is rotated by 180 degrees
+		if (face == 5) return faceCoordsToXYZ(faceSize - 1 - x, faceSize - 1 - y, kCubeFaceToCrossFace[face], faceSize);
+
+		return faceCoordsToXYZ(x, y, kCubeFaceToCrossFace[face], faceSize);
+	}
+
+#if defined(SIMD_SSE2)
+	/// 8 lane part of directionsToEquirectangular(), returns how many directions it converted. Only call it when
+	/// simd::getLevel() has AVX.
+	SIMD_TARGET("avx")
+	inline int directionsToEquirectangularAVX(const float* px, const float* py, const float* pz, float* outU, float* outV, int count, float scale)
+	{
+		const __m256 scale8 = _mm256_set1_ps(scale);
+		const __m256 pi8 = _mm256_set1_ps(Math::PI);
+		const __m256 halfPi8 = _mm256_set1_ps(0.5f * Math::PI);
+		int i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256 x = _mm256_loadu_ps(px + i);
+			const __m256 y = _mm256_loadu_ps(py + i);
+			const __m256 z = _mm256_loadu_ps(pz + i);
+			const __m256 R = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)));
+			const __m256 theta = simd::atan2_ps(y, x);
+			const __m256 phi = simd::atan2_ps(z, R);
+			_mm256_storeu_ps(outU + i, _mm256_mul_ps(_mm256_add_ps(theta, pi8), scale8));
+			_mm256_storeu_ps(outV + i, _mm256_mul_ps(_mm256_sub_ps(halfPi8, phi), scale8));
+		}
+		return i;
+	}
+#endif
+
+	/// Equirectangular pixel coordinates for a row of (not normalized) directions, 8 lanes at a time when the CPU
+	/// has AVX, else 4
+	inline void directionsToEquirectangular(const float* px, const float* py, const float* pz, float* outU, float* outV, int count, int faceSize)
+	{
+		const float scale = 2.0f * float(faceSize) / Math::PI;
+
+		int i = 0;
+#if defined(SIMD_SSE2)
+		if (simd::getLevel() >= simd::Level_AVX2)
+			i = directionsToEquirectangularAVX(px, py, pz, outU, outV, count, scale);
+
+		{
+			const __m128 scale4 = _mm_set1_ps(scale);
+			const __m128 pi4 = _mm_set1_ps(Math::PI);
+			const __m128 halfPi4 = _mm_set1_ps(0.5f * Math::PI);
+			for (; i + 4 <= count; i += 4)
+			{
+				const __m128 x = _mm_loadu_ps(px + i);
+				const __m128 y = _mm_loadu_ps(py + i);
+				const __m128 z = _mm_loadu_ps(pz + i);
+				const __m128 R = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)));
+				const __m128 theta = simd::atan2_ps(y, x);
+				const __m128 phi = simd::atan2_ps(z, R);
+				_mm_storeu_ps(outU + i, _mm_mul_ps(_mm_add_ps(theta, pi4), scale4));
+				_mm_storeu_ps(outV + i, _mm_mul_ps(_mm_sub_ps(halfPi4, phi), scale4));
+			}
+		}
+#endif
+		for (; i < count; i++)
+		{
+			const float R = std::hypot(px[i], py[i]);
+			const float theta = std::atan2(py[i], px[i]);
+			const float phi = std::atan2(pz[i], R);
+			outU[i] = (theta + Math::PI) * scale;
+			outV[i] = (0.5f * Math::PI - phi) * scale;
+		}
+	}
+
+	/// Bilinear fetch of a row of texels, T is the component type of both bitmaps
+	template <typename T>
+	inline void sampleEquirectangularRow(const Bitmap& b, const float* uf, const float* vf, int count, T* dst)
+	{
+		const T* src = reinterpret_cast<const T*>(b.data_.data());
+		const int comp = b.comp_;
+		const int clampW = b.w_ - 1;
+		const int clampH = b.h_ - 1;
+
+		for (int x = 0; x != count; x++)
+		{
+			const int U1 = clamp(int(floor(uf[x])), 0, clampW);
+			const int V1 = clamp(int(floor(vf[x])), 0, clampH);
+			const int U2 = clamp(U1 + 1, 0, clampW);
+			const int V2 = clamp(V1 + 1, 0, clampH);
+			const float s = uf[x] - U1;
+			const float t = vf[x] - V1;
+			const T* A = src + comp * (V1 * b.w_ + U1);
+			const T* B = src + comp * (V1 * b.w_ + U2);
+			const T* C = src + comp * (V2 * b.w_ + U1);
+			const T* D = src + comp * (V2 * b.w_ + U2);
+			for (int c = 0; c != comp; c++)
+			{
+				dst[x * comp + c] = T(A[c] * (1 - s) * (1 - t) + B[c] * s * (1 - t) + C[c] * (1 - s) * t + D[c] * s * t);
+			}
+		}
+	}
+
+	/// Float RGBA version, one texel fits in a single SSE register
+	inline void sampleEquirectangularRowRGBA32F(const Bitmap& b, const float* uf, const float* vf, int count, float* dst)
+	{
+#if defined(SIMD_SSE2)
+		const float* src = reinterpret_cast<const float*>(b.data_.data());
+		const int clampW = b.w_ - 1;
+		const int clampH = b.h_ - 1;
+
+		for (int x = 0; x != count; x++)
+		{
+			const int U1 = clamp(int(floor(uf[x])), 0, clampW);
+			const int V1 = clamp(int(floor(vf[x])), 0, clampH);
+			const int U2 = clamp(U1 + 1, 0, clampW);
+			const int V2 = clamp(V1 + 1, 0, clampH);
+			const float s = uf[x] - U1;
+			const float t = vf[x] - V1;
+			__m128 color = _mm_mul_ps(_mm_loadu_ps(src + 4 * (V1 * b.w_ + U1)), _mm_set1_ps((1 - s) * (1 - t)));
+			color = _mm_add_ps(color, _mm_mul_ps(_mm_loadu_ps(src + 4 * (V1 * b.w_ + U2)), _mm_set1_ps(s * (1 - t))));
+			color = _mm_add_ps(color, _mm_mul_ps(_mm_loadu_ps(src + 4 * (V2 * b.w_ + U1)), _mm_set1_ps((1 - s) * t)));
+			color = _mm_add_ps(color, _mm_mul_ps(_mm_loadu_ps(src + 4 * (V2 * b.w_ + U2)), _mm_set1_ps(s * t)));
+			_mm_storeu_ps(dst + 4 * x, color);
+		}
+#else
+		sampleEquirectangularRow<float>(b, uf, vf, count, dst);
+#endif
+	}
+
+	/// Writes the 6 faces directly, no vertical cross in between. Rows of all faces are spread over the thread pool.
+	inline Bitmap convertEquirectangularMapToCubeMapFaces(const Bitmap& b)
+	{
+		if (b.type_ != eBitmapType_2D) return Bitmap();
+
+		const int faceSize = b.w_ / 4;
+
+		Bitmap cubemap(faceSize, faceSize, 6, b.comp_, b.fmt_);
+		cubemap.type_ = eBitmapType_Cube;
+
+		const size_t rowSize = size_t(faceSize) * b.comp_ * Bitmap::getBytesPerComponent(b.fmt_);
+
+		getThreadPool().parallelFor(0, 6 * faceSize, [&](uint32_t row)
+			{
+				const int face = int(row) / faceSize;
+				const int y = int(row) % faceSize;
+
+				thread_local std::vector<float> scratch;
+				scratch.resize(5 * size_t(faceSize));
+				float* px = scratch.data();
+				float* py = px + faceSize;
+				float* pz = py + faceSize;
+				float* uf = pz + faceSize;
+				float* vf = uf + faceSize;
+
+				for (int x = 0; x != faceSize; x++)
+				{
+					const vec3 P = cubeFaceTexelToDirection(face, x, y, faceSize);
+					px[x] = P.x;
+					py[x] = P.y;
+					pz[x] = P.z;
+				}
+
+				directionsToEquirectangular(px, py, pz, uf, vf, faceSize, faceSize);
+
+				uint8_t* dst = cubemap.data_.data() + row * rowSize;
+
+				if (b.fmt_ == eBitmapFormat_Float && b.comp_ == 4)
+					sampleEquirectangularRowRGBA32F(b, uf, vf, faceSize, reinterpret_cast<float*>(dst));
+				else if (b.fmt_ == eBitmapFormat_Float)
+					sampleEquirectangularRow(b, uf, vf, faceSize, reinterpret_cast<float*>(dst));
+				else
+					sampleEquirectangularRow(b, uf, vf, faceSize, dst);
+			}, 4);
+
+		return cubemap;
+	}
+
+	/// Box filtered mip chain of an equirectangular float RGBA map, level 0 is the map itself
+	inline std::vector<Bitmap> buildEquirectangularMips(const Bitmap& b)
+	{
+		std::vector<Bitmap> mips;
+		mips.push_back(b);
+
+		while (mips.back().h_ > 1)
+		{
+			const Bitmap& src = mips.back();
+			Bitmap dst(std::max(src.w_ / 2, 1), std::max(src.h_ / 2, 1), 4, eBitmapFormat_Float);
+
+			const vec4* s = reinterpret_cast<const vec4*>(src.data_.data());
+			vec4* d = reinterpret_cast<vec4*>(dst.data_.data());
+
+			for (int y = 0; y != dst.h_; y++)
+			{
+				const int y0 = std::min(2 * y, src.h_ - 1);
+				const int y1 = std::min(2 * y + 1, src.h_ - 1);
+				for (int x = 0; x != dst.w_; x++)
+				{
+					const int x0 = std::min(2 * x, src.w_ - 1);
+					const int x1 = std::min(2 * x + 1, src.w_ - 1);
+					d[y * dst.w_ + x] = 0.25f * (s[y0 * src.w_ + x0] + s[y0 * src.w_ + x1] + s[y1 * src.w_ + x0] + s[y1 * src.w_ + x1]);
+				}
+			}
+
+			mips.push_back(std::move(dst));
+		}
+
+		return mips;
+	}
+
+	/// Bilinear fetch, u wraps around and v is clamped
+	inline vec4 sampleEquirectangularBilinear(const Bitmap& b, const vec2& uv)
+	{
+		const vec4* data = reinterpret_cast<const vec4*>(b.data_.data());
+
+		const float x = uv.x * b.w_ - 0.5f;
+		const float y = uv.y * b.h_ - 0.5f;
+		const float fx = std::floor(x);
+		const float fy = std::floor(y);
+		const float s = x - fx;
+		const float t = y - fy;
+
+		const int x0 = ((int(fx) % b.w_) + b.w_) % b.w_;
+		const int x1 = (x0 + 1) % b.w_;
+		const int y0 = clamp(int(fy), 0, b.h_ - 1);
+		const int y1 = clamp(int(fy) + 1, 0, b.h_ - 1);
+
+		return data[y0 * b.w_ + x0] * (1 - s) * (1 - t) + data[y0 * b.w_ + x1] * s * (1 - t) +
+			data[y1 * b.w_ + x0] * (1 - s) * t + data[y1 * b.w_ + x1] * s * t;
+	}
+
+	/// Trilinear fetch of a direction given in faceCoordsToXYZ() space
+	inline vec4 sampleEquirectangular(const std::vector<Bitmap>& mips, const vec3& dir, float lod)
+	{
+		lod = clamp(lod, 0.0f, float(mips.size() - 1));
+
+		const int level0 = int(lod);
+		const int level1 = std::min(level0 + 1, (int)mips.size() - 1);
+		const float f = lod - float(level0);
+
+		const float theta = std::atan2(dir.y, dir.x);
+		const float phi = std::atan2(dir.z, std::hypot(dir.x, dir.y));
+		const vec2 uv((theta + Math::PI) / Math::TWOPI, (0.5f * Math::PI - phi) / Math::PI);
+
+		const vec4 c0 = sampleEquirectangularBilinear(mips[level0], uv);
+
+		return (f > 0.0f && level1 != level0) ? glm::mix(c0, sampleEquirectangularBilinear(mips[level1], uv), f) : c0;
+	}
+
+	/// Source mip level whose texels cover the solid angle of one sample, from GPU Gems 3 chapter 20
+	inline float importanceSampleLod(float pdf, int numSamples, float texelSolidAngle)
+	{
+		const float sampleSolidAngle = 1.0f / (float(numSamples) * pdf + 0.0001f);
+
+		return std::max(0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f, 0.0f);
+	}
+
+	/// Diffuse irradiance cube map with cosine weighted importance sampling of the environment mips
+	inline Bitmap convolveLambertian(const std::vector<Bitmap>& envMips, int faceSize, int numSamples)
+	{
+		Bitmap result(faceSize, faceSize, 6, 4, eBitmapFormat_Float);
+		result.type_ = eBitmapType_Cube;
+
+		vec4* dst = reinterpret_cast<vec4*>(result.data_.data());
+		const float texelSolidAngle = 4.0f * Math::PI / float(envMips[0].w_ * envMips[0].h_);
+
+		getThreadPool().parallelFor(0, 6 * faceSize, [&](uint32_t row)
+			{
+				const int face = int(row) / faceSize;
+				const int y = int(row) % faceSize;
+
+				for (int x = 0; x != faceSize; x++)
+				{
+					const vec3 N = glm::normalize(cubeFaceTexelToDirection(face, x, y, faceSize));
+					const vec3 up = std::abs(N.z) < 0.999f ? vec3(0.0f, 0.0f, 1.0f) : vec3(1.0f, 0.0f, 0.0f);
+					const vec3 T = glm::normalize(glm::cross(up, N));
+					const vec3 B = glm::cross(N, T);
+
+					vec3 color = vec3(0.0f);
+					for (int i = 0; i != numSamples; i++)
+					{
+						const vec2 h = hammersley2d(i, numSamples);
+						const float phi = Math::TWOPI * h.x;
+						const float cosTheta = std::sqrt(1.0f - h.y);
+						const float sinTheta = std::sqrt(h.y);
+						const vec3 L = T * (sinTheta * std::cos(phi)) + B * (sinTheta * std::sin(phi)) + N * cosTheta;
+						const float pdf = cosTheta / Math::PI;
+						color += vec3(sampleEquirectangular(envMips, L, importanceSampleLod(pdf, numSamples, texelSolidAngle)));
+					}
+
+					dst[row * faceSize + x] = vec4(color / float(numSamples), 1.0f);
+				}
+			});
+
+		return result;
+	}
+
+	/// Specular cube map prefiltered with the GGX distribution for one roughness value, N = V = R as in the split sum approximation
+	inline Bitmap convolveGGX(const std::vector<Bitmap>& envMips, int faceSize, float roughness, int numSamples)
+	{
+		Bitmap result(faceSize, faceSize, 6, 4, eBitmapFormat_Float);
+		result.type_ = eBitmapType_Cube;
+
+		vec4* dst = reinterpret_cast<vec4*>(result.data_.data());
+		const float texelSolidAngle = 4.0f * Math::PI / float(envMips[0].w_ * envMips[0].h_);
+		const float alpha = roughness * roughness;
+		const float alpha2 = alpha * alpha;
+
+		getThreadPool().parallelFor(0, 6 * faceSize, [&](uint32_t row)
+			{
+				const int face = int(row) / faceSize;
+				const int y = int(row) % faceSize;
+
+				for (int x = 0; x != faceSize; x++)
+				{
+					const vec3 N = glm::normalize(cubeFaceTexelToDirection(face, x, y, faceSize));
+
+					// Mirror reflection, the lobe is a single direction
+					if (roughness <= 0.0f)
+					{
+						dst[row * faceSize + x] = sampleEquirectangular(envMips, N, 0.0f);
+						continue;
+					}
+
+					const vec3 up = std::abs(N.z) < 0.999f ? vec3(0.0f, 0.0f, 1.0f) : vec3(1.0f, 0.0f, 0.0f);
+					const vec3 T = glm::normalize(glm::cross(up, N));
+					const vec3 B = glm::cross(N, T);
+
+					vec3 color = vec3(0.0f);
+					float weight = 0.0f;
+					for (int i = 0; i != numSamples; i++)
+					{
+						const vec2 h = hammersley2d(i, numSamples);
+						const float phi = Math::TWOPI * h.x;
+						const float cosTheta = std::sqrt((1.0f - h.y) / (1.0f + (alpha2 - 1.0f) * h.y));
+						const float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+						const vec3 H = T * (sinTheta * std::cos(phi)) + B * (sinTheta * std::sin(phi)) + N * cosTheta;
+						const vec3 L = 2.0f * glm::dot(N, H) * H - N;
+						const float NdotL = glm::dot(N, L);
+						if (NdotL <= 0.0f)
+							continue;
+
+						// With V = N the pdf D * NdotH / (4 * VdotH) reduces to D / 4
+						const float d = cosTheta * cosTheta * (alpha2 - 1.0f) + 1.0f;
+						const float D = alpha2 / (Math::PI * d * d);
+						const float pdf = 0.25f * D;
+
+						color += vec3(sampleEquirectangular(envMips, L, importanceSampleLod(pdf, numSamples, texelSolidAngle))) * NdotL;
+						weight += NdotL;
+					}
+
+					dst[row * faceSize + x] = vec4(color / std::max(weight, 0.0001f), 1.0f);
+				}
+			});
+
+		return result;
 	}
 }
\ No newline at end of file
@@ -69,6 +69,11 @@ struct BoundingBox {
         min_ = glm::min(min_, p);
         max_ = glm::max(max_, p);
     }
+    void combineBox(const BoundingBox& b)
+    {
+        min_ = glm::min(min_, b.min_);
+        max_ = glm::max(max_, b.max_);
+    }
 };
 
 template <typename T> T clamp(T v, T a, T b)
@@ -180,20 +185,12 @@ inline bool isBoxInFrustum(glm::vec4* frustumPlanes, glm::vec4* frustumCorners,
 
 inline BoundingBox combineBoxes(const std::vector<BoundingBox>& boxes)
 {
-    std::vector<vec3> allPoints;
-    allPoints.reserve(boxes.size() * 8);
-
-    for (const auto& b : boxes) {
-        allPoints.emplace_back(b.min_.x, b.min_.y, b.min_.z);
-        allPoints.emplace_back(b.min_.x, b.min_.y, b.max_.z);
-        allPoints.emplace_back(b.min_.x, b.max_.y, b.min_.z);
-        allPoints.emplace_back(b.min_.x, b.max_.y, b.max_.z);
-
-        allPoints.emplace_back(b.max_.x, b.min_.y, b.min_.z);
-        allPoints.emplace_back(b.max_.x, b.min_.y, b.max_.z);
-        allPoints.emplace_back(b.max_.x, b.max_.y, b.min_.z);
-        allPoints.emplace_back(b.max_.x, b.max_.y, b.max_.z);
-    }
+    if (boxes.empty())
+        return BoundingBox(nullptr, 0);
+
+    BoundingBox result = boxes.front();
+    for (size_t i = 1; i != boxes.size(); i++)
+        result.combineBox(boxes[i]);
 
-    return BoundingBox(allPoints.data(), allPoints.size());
+    return result;
 }
\ No newline at end of file
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Fixed set of worker threads shared by the CPU heavy loaders (cubemap conversion, mesh processing, culling)
+class ThreadPool
+{
+public:
+	explicit ThreadPool(uint32_t numThreads = std::max(1u, std::thread::hardware_concurrency()))
+	{
+		// The calling thread always takes part in parallelFor() so spawn one worker less
+		for (uint32_t i = 1; i < numThreads; i++)
+		{
+			workers_.emplace_back([this]() { workerLoop(); });
+		}
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		cv_.notify_all();
+		for (std::thread& t : workers_)
+			t.join();
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	uint32_t getNumThreads() const { return (uint32_t)workers_.size() + 1; }
+
+	/// Calls func(i) for every i in [begin, end) in chunks of grainSize items.
+	/// The calling thread works on chunks as well and the call returns once every item is done.
+	void parallelFor(uint32_t begin, uint32_t end, const std::function<void(uint32_t)>& func, uint32_t grainSize = 1)
+	{
+		if (end <= begin)
+			return;
+
+		grainSize = std::max(grainSize, 1u);
+		const uint32_t numChunks = (end - begin + grainSize - 1) / grainSize;
+
+		if (numChunks == 1 || workers_.empty())
+		{
+			for (uint32_t i = begin; i != end; i++)
+				func(i);
+			return;
+		}
+
+		// Shared with the queued tasks, a task that starts after the loop is finished just finds no work left
+		auto job = std::make_shared<Job>();
+		job->func = func;
+		job->begin = begin;
+		job->end = end;
+		job->grainSize = grainSize;
+		job->numChunks = numChunks;
+
+		const uint32_t numTasks = std::min(numChunks - 1, (uint32_t)workers_.size());
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			for (uint32_t i = 0; i != numTasks; i++)
+				tasks_.emplace_back([job]() { runChunks(*job); });
+		}
+		cv_.notify_all();
+
+		runChunks(*job);
+
+		std::unique_lock<std::mutex> lock(job->mutex);
+		job->cv.wait(lock, [&job]() { return job->doneChunks.load() == job->numChunks; });
+	}
+
+private:
+	struct Job
+	{
+		std::function<void(uint32_t)> func;
+		uint32_t begin = 0;
+		uint32_t end = 0;
+		uint32_t grainSize = 1;
+		uint32_t numChunks = 0;
+		std::atomic<uint32_t> nextChunk = 0;
+		std::atomic<uint32_t> doneChunks = 0;
+		std::mutex mutex;
+		std::condition_variable cv;
+	};
+
+	static void runChunks(Job& job)
+	{
+		uint32_t chunk;
+		while ((chunk = job.nextChunk.fetch_add(1)) < job.numChunks)
+		{
+			const uint32_t first = job.begin + chunk * job.grainSize;
+			const uint32_t last = std::min(first + job.grainSize, job.end);
+			for (uint32_t i = first; i != last; i++)
+				job.func(i);
+
+			if (job.doneChunks.fetch_add(1) + 1 == job.numChunks)
+			{
+				std::lock_guard<std::mutex> lock(job.mutex);
+				job.cv.notify_all();
+			}
+		}
+	}
+
+	void workerLoop()
+	{
+		for (;;)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				cv_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+				if (stop_ && tasks_.empty())
+					return;
+				task = std::move(tasks_.front());
+				tasks_.pop_front();
+			}
+			task();
+		}
+	}
+
+	std::vector<std::thread> workers_;
+	std::deque<std::function<void()>> tasks_;
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	bool stop_ = false;
+};
+
+/// Process wide pool, created on first use
+inline ThreadPool& getThreadPool()
+{
+	static ThreadPool pool;
+	return pool;
+}
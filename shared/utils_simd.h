@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstdint>
+
+// SIMD instruction sets enabled for the current compile target
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2 1
+#include <immintrin.h>
+#endif
+
+#if defined(SIMD_SSE2) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Compiles a function for a higher instruction set than the target, only call it when getLevel() allows it.
+// MSVC accepts every intrinsic without it.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SIMD_TARGET(isa)
+#else
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace simd
+{
+	static constexpr float kPI = 3.14159265359f;
+	static constexpr float kHalfPI = 1.57079632679f;
+	static constexpr float kQuarterPI = 0.78539816339f;
+
+	/// Instruction sets picked at run time, see SIMD_TARGET
+	enum Level
+	{
+		Level_Scalar,
+		Level_SSE2,
+		Level_AVX2,
+		Level_AVX512,
+	};
+
+	inline const char* getLevelName(Level level)
+	{
+		static const char* names[] = { "scalar", "SSE2", "AVX2", "AVX-512" };
+		return names[level];
+	}
+
+	/// Highest level both the CPU and the OS (saved register state) support
+	inline Level detectLevel()
+	{
+#if defined(SIMD_SSE2) && defined(_MSC_VER) && !defined(__clang__)
+		int info[4];
+		__cpuid(info, 0);
+		const int maxLeaf = info[0];
+		__cpuid(info, 1);
+		const bool hasAVX = (info[2] & (1 << 28)) != 0;
+		const uint64_t xcr0 = (info[2] & (1 << 27)) ? _xgetbv(0) : 0; // OSXSAVE
+		bool hasAVX2 = false;
+		bool hasAVX512 = false;
+		if (maxLeaf >= 7)
+		{
+			__cpuidex(info, 7, 0);
+			hasAVX2 = (info[1] & (1 << 5)) != 0;
+			hasAVX512 = (info[1] & (1 << 16)) != 0; // AVX-512F
+		}
+		// XMM and YMM state, then opmask and ZMM state as well
+		if (hasAVX512 && (xcr0 & 0xe6) == 0xe6)
+			return Level_AVX512;
+		if (hasAVX && hasAVX2 && (xcr0 & 0x6) == 0x6)
+			return Level_AVX2;
+		return Level_SSE2;
+#elif defined(SIMD_SSE2)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f"))
+			return Level_AVX512;
+		if (__builtin_cpu_supports("avx2"))
+			return Level_AVX2;
+		return Level_SSE2;
+#else
+		return Level_Scalar;
+#endif
+	}
+
+	/// detectLevel() of the first call
+	inline Level getLevel()
+	{
+		static const Level level = detectLevel();
+		return level;
+	}
+
+#if defined(SIMD_SSE2)
+	inline __m128 select(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	/// Cephes atanf() on 4 lanes, range reduced to [-tan(pi/8), tan(pi/8)]
+	inline __m128 atan_ps(__m128 x)
+	{
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 sign = _mm_and_ps(x, signMask);
+		const __m128 ax = _mm_andnot_ps(signMask, x);
+
+		const __m128 isBig = _mm_cmpgt_ps(ax, _mm_set1_ps(2.414213562373095f)); // tan(3*pi/8)
+		const __m128 isMid = _mm_andnot_ps(isBig, _mm_cmpgt_ps(ax, _mm_set1_ps(0.4142135623730950f))); // tan(pi/8)
+
+		const __m128 xBig = _mm_div_ps(_mm_set1_ps(-1.0f), ax);
+		const __m128 xMid = _mm_div_ps(_mm_sub_ps(ax, one), _mm_add_ps(ax, one));
+		const __m128 xr = select(isBig, xBig, select(isMid, xMid, ax));
+		const __m128 y0 = _mm_or_ps(_mm_and_ps(isBig, _mm_set1_ps(kHalfPI)), _mm_and_ps(isMid, _mm_set1_ps(kQuarterPI)));
+
+		const __m128 z = _mm_mul_ps(xr, xr);
+		__m128 p = _mm_set1_ps(8.05374449538e-2f);
+		p = _mm_sub_ps(_mm_mul_ps(p, z), _mm_set1_ps(1.38776856032e-1f));
+		p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(1.99777106478e-1f));
+		p = _mm_sub_ps(_mm_mul_ps(p, z), _mm_set1_ps(3.33329491539e-1f));
+		p = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, z), xr), xr);
+
+		return _mm_xor_ps(_mm_add_ps(y0, p), sign);
+	}
+
+	/// atan2(y, x) on 4 lanes, atan2(0, 0) returns 0 like std::atan2()
+	inline __m128 atan2_ps(__m128 y, __m128 x)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 pi = _mm_set1_ps(kPI);
+
+		const __m128 angle = atan_ps(_mm_div_ps(y, x));
+		// Left half plane, rotate by +/- pi depending on the sign of y
+		const __m128 offset = _mm_and_ps(_mm_cmplt_ps(x, zero), select(_mm_cmplt_ps(y, zero), _mm_sub_ps(zero, pi), pi));
+		const __m128 isOrigin = _mm_and_ps(_mm_cmpeq_ps(x, zero), _mm_cmpeq_ps(y, zero));
+
+		return _mm_andnot_ps(isOrigin, _mm_add_ps(angle, offset));
+	}
+#endif // SIMD_SSE2
+
+#if defined(SIMD_SSE2)
+	/// Same as the 4 lane version above, AVX has to be available (Level_AVX2)
+	SIMD_TARGET("avx")
+	inline __m256 atan_ps(__m256 x)
+	{
+		const __m256 signMask = _mm256_set1_ps(-0.0f);
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 sign = _mm256_and_ps(x, signMask);
+		const __m256 ax = _mm256_andnot_ps(signMask, x);
+
+		const __m256 isBig = _mm256_cmp_ps(ax, _mm256_set1_ps(2.414213562373095f), _CMP_GT_OQ);
+		const __m256 isMid = _mm256_andnot_ps(isBig, _mm256_cmp_ps(ax, _mm256_set1_ps(0.4142135623730950f), _CMP_GT_OQ));
+
+		const __m256 xBig = _mm256_div_ps(_mm256_set1_ps(-1.0f), ax);
+		const __m256 xMid = _mm256_div_ps(_mm256_sub_ps(ax, one), _mm256_add_ps(ax, one));
+		const __m256 xr = _mm256_blendv_ps(_mm256_blendv_ps(ax, xMid, isMid), xBig, isBig);
+		const __m256 y0 = _mm256_or_ps(_mm256_and_ps(isBig, _mm256_set1_ps(kHalfPI)), _mm256_and_ps(isMid, _mm256_set1_ps(kQuarterPI)));
+
+		const __m256 z = _mm256_mul_ps(xr, xr);
+		__m256 p = _mm256_set1_ps(8.05374449538e-2f);
+		p = _mm256_sub_ps(_mm256_mul_ps(p, z), _mm256_set1_ps(1.38776856032e-1f));
+		p = _mm256_add_ps(_mm256_mul_ps(p, z), _mm256_set1_ps(1.99777106478e-1f));
+		p = _mm256_sub_ps(_mm256_mul_ps(p, z), _mm256_set1_ps(3.33329491539e-1f));
+		p = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(p, z), xr), xr);
+
+		return _mm256_xor_ps(_mm256_add_ps(y0, p), sign);
+	}
+
+	SIMD_TARGET("avx")
+	inline __m256 atan2_ps(__m256 y, __m256 x)
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 pi = _mm256_set1_ps(kPI);
+
+		const __m256 angle = atan_ps(_mm256_div_ps(y, x));
+		const __m256 offset = _mm256_and_ps(
+			_mm256_cmp_ps(x, zero, _CMP_LT_OQ),
+			_mm256_blendv_ps(pi, _mm256_sub_ps(zero, pi), _mm256_cmp_ps(y, zero, _CMP_LT_OQ)));
+		const __m256 isOrigin = _mm256_and_ps(_mm256_cmp_ps(x, zero, _CMP_EQ_OQ), _mm256_cmp_ps(y, zero, _CMP_EQ_OQ));
+
+		return _mm256_andnot_ps(isOrigin, _mm256_add_ps(angle, offset));
+	}
+#endif // SIMD_SSE2
+} // namespace simd
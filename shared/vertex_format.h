@@ -0,0 +1,228 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <lvk/LVK.h>
+
+#include "mesh_data.h"
+
+// Configure with -DSHADING_PACKED_VERTICES=ON to upload PackedVertex instead of Vertex, shaders get PACKED_VERTICES defined as well
+#if defined(PACKED_VERTICES)
+static constexpr bool kPackedVertices = true;
+#else
+static constexpr bool kPackedVertices = false;
+#endif
+
+/// 16 byte GPU vertex, decoded by vertex.sp
+struct PackedVertex
+{
+	// unorm16 inside the mesh bounds, w is padding
+	uint16_t position[4];
+	// Octahedral encoded snorm16
+	int16_t normal[2];
+	// Half floats
+	uint16_t uv[2];
+};
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex has to match the UShort4Norm/Short2Norm/HalfFloat2 vertex input");
+
+/// Maps unorm16 positions back into mesh space: position = offset + unorm * scale
+struct VertexQuantization
+{
+	glm::vec4 positionOffset = glm::vec4(0.0f);
+	glm::vec4 positionScale = glm::vec4(1.0f);
+};
+
+inline VertexQuantization getVertexQuantization(const BoundingBox& bounds)
+{
+	VertexQuantization q;
+	q.positionOffset = glm::vec4(bounds.min_, 0.0f);
+	q.positionScale = glm::vec4(bounds.max_ - bounds.min_, 0.0f);
+	return q;
+}
+
+namespace vertex_packing
+{
+	inline uint16_t floatToHalf(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+
+		const uint32_t sign = (bits >> 16) & 0x8000u;
+		const int32_t exponent = int32_t((bits >> 23) & 0xff) - 127 + 15;
+		uint32_t mantissa = bits & 0x7fffffu;
+
+		// NaN stays NaN, infinity and overflow become infinity
+		if (((bits >> 23) & 0xff) == 0xff)
+			return uint16_t(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+		if (exponent >= 31)
+			return uint16_t(sign | 0x7c00u);
+
+		// Denormals, round to nearest even
+		if (exponent <= 0)
+		{
+			if (exponent < -10)
+				return uint16_t(sign);
+			mantissa |= 0x800000u;
+			const uint32_t shift = uint32_t(14 - exponent);
+			const uint32_t halfMantissa = mantissa >> shift;
+			const uint32_t rest = mantissa & ((1u << shift) - 1);
+			const uint32_t halfway = 1u << (shift - 1);
+			return uint16_t(sign | (halfMantissa + (rest > halfway || (rest == halfway && (halfMantissa & 1)))));
+		}
+
+		// Rounding may carry into the exponent, which is still the correctly rounded result
+		const uint32_t half = sign | (uint32_t(exponent) << 10) | (mantissa >> 13);
+		const uint32_t rest = mantissa & 0x1fffu;
+		return uint16_t(half + (rest > 0x1000u || (rest == 0x1000u && (half & 1))));
+	}
+
+	inline float halfToFloat(uint16_t value)
+	{
+		const uint32_t sign = uint32_t(value & 0x8000u) << 16;
+		const uint32_t exponent = (value >> 10) & 0x1fu;
+		const uint32_t mantissa = value & 0x3ffu;
+
+		if (exponent == 0)
+		{
+			const float magnitude = std::ldexp(float(mantissa), -24);
+			return sign ? -magnitude : magnitude;
+		}
+
+		const uint32_t bits = exponent == 0x1f
+			? sign | 0x7f800000u | (mantissa << 13)
+			: sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+
+		float result;
+		memcpy(&result, &bits, sizeof(result));
+		return result;
+	}
+
+	inline uint16_t floatToUnorm16(float value)
+	{
+		return uint16_t(std::lround(glm::clamp(value, 0.0f, 1.0f) * 65535.0f));
+	}
+
+	inline float unorm16ToFloat(uint16_t value)
+	{
+		return float(value) / 65535.0f;
+	}
+
+	inline float snorm16ToFloat(int16_t value)
+	{
+		return glm::max(float(value) / 32767.0f, -1.0f);
+	}
+
+	/// Unit vector -> [-1, 1]^2 (Meyer et al. 2010, "On Floating-Point Normal Vectors")
+	inline glm::vec2 octahedralEncode(const glm::vec3& n)
+	{
+		const float invL1 = 1.0f / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+		glm::vec2 e(n.x * invL1, n.y * invL1);
+		if (n.z < 0.0f)
+		{
+			e = glm::vec2(
+				(1.0f - std::abs(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f),
+				(1.0f - std::abs(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f));
+		}
+		return e;
+	}
+
+	/// Same as decodeOctahedral() in vertex.sp
+	inline glm::vec3 octahedralDecode(const glm::vec2& e)
+	{
+		glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+		const float t = glm::max(-n.z, 0.0f);
+		n.x += n.x >= 0.0f ? -t : t;
+		n.y += n.y >= 0.0f ? -t : t;
+		return glm::normalize(n);
+	}
+
+	/// The snorm16 pair closest to n after decoding, out of the 4 around the rounded encoding
+	inline void encodeNormal(const glm::vec3& n, int16_t out[2])
+	{
+		const glm::vec2 e = octahedralEncode(n);
+		const glm::vec2 base(std::floor(glm::clamp(e.x, -1.0f, 1.0f) * 32767.0f), std::floor(glm::clamp(e.y, -1.0f, 1.0f) * 32767.0f));
+
+		float bestDot = -2.0f;
+		for (int i = 0; i != 4; i++)
+		{
+			const int16_t x = int16_t(glm::clamp(base.x + float(i & 1), -32767.0f, 32767.0f));
+			const int16_t y = int16_t(glm::clamp(base.y + float(i >> 1), -32767.0f, 32767.0f));
+			const float d = glm::dot(octahedralDecode(glm::vec2(snorm16ToFloat(x), snorm16ToFloat(y))), n);
+			if (d > bestDot)
+			{
+				bestDot = d;
+				out[0] = x;
+				out[1] = y;
+			}
+		}
+	}
+} // namespace vertex_packing
+
+inline PackedVertex packVertex(const Vertex& v, const VertexQuantization& q)
+{
+	using namespace vertex_packing;
+
+	PackedVertex p{};
+	for (int i = 0; i != 3; i++)
+	{
+		const float extent = q.positionScale[i];
+		p.position[i] = floatToUnorm16(extent > 0.0f ? (v.position[i] - q.positionOffset[i]) / extent : 0.0f);
+	}
+
+	const float normalLength = glm::length(v.normal);
+	encodeNormal(normalLength > 0.0f ? v.normal / normalLength : glm::vec3(0.0f, 0.0f, 1.0f), p.normal);
+
+	p.uv[0] = floatToHalf(v.uv.x);
+	p.uv[1] = floatToHalf(v.uv.y);
+	return p;
+}
+
+inline Vertex unpackVertex(const PackedVertex& p, const VertexQuantization& q)
+{
+	using namespace vertex_packing;
+
+	Vertex v{};
+	for (int i = 0; i != 3; i++)
+		v.position[i] = q.positionOffset[i] + unorm16ToFloat(p.position[i]) * q.positionScale[i];
+	v.normal = octahedralDecode(glm::vec2(snorm16ToFloat(p.normal[0]), snorm16ToFloat(p.normal[1])));
+	v.uv = glm::vec2(halfToFloat(p.uv[0]), halfToFloat(p.uv[1]));
+	return v;
+}
+
+inline std::vector<PackedVertex> packVertices(const Vertex* vertices, size_t numVertices, const VertexQuantization& q)
+{
+	std::vector<PackedVertex> packed(numVertices);
+	for (size_t i = 0; i != numVertices; i++)
+		packed[i] = packVertex(vertices[i], q);
+	return packed;
+}
+
+/// Vertex input matching the layout createMeshBuffers() uploads
+inline lvk::VertexInput getVertexInput(bool packed = kPackedVertices)
+{
+	if (packed)
+	{
+		return {
+			.attributes = {
+				{ .location = 0, .format = lvk::VertexFormat::UShort4Norm, .offset = offsetof(PackedVertex, position) },
+				{ .location = 1, .format = lvk::VertexFormat::Short2Norm, .offset = offsetof(PackedVertex, normal) },
+				{ .location = 2, .format = lvk::VertexFormat::HalfFloat2, .offset = offsetof(PackedVertex, uv) },
+			},
+			.inputBindings = { {.stride = sizeof(PackedVertex) } }
+		};
+	}
+
+	return {
+		.attributes = {
+			{ .location = 0, .format = lvk::VertexFormat::Float3, .offset = offsetof(Vertex, position) },
+			{ .location = 1, .format = lvk::VertexFormat::Float3, .offset = offsetof(Vertex, normal) },
+			{ .location = 2, .format = lvk::VertexFormat::Float2, .offset = offsetof(Vertex, uv) },
+		},
+		.inputBindings = { {.stride = sizeof(Vertex) } }
+	};
+}